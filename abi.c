@@ -0,0 +1,218 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "abi.h"
+#include "generate.h"
+
+#define ABI_BUCKETS 64
+#define ABI_BUCKET(type) ((((uintptr_t)(type)) >> 4) & (ABI_BUCKETS - 1))
+
+// Classes of each eightbyte of an aggregate
+#define CLASS_NONE 0
+#define CLASS_INTEGER 1
+#define CLASS_SSE 2
+
+// Store the state of the lowering
+LLVMTargetDataRef abi_target_data = NULL;
+abi_function_t *abi_functions[ABI_BUCKETS];
+
+void abi_initialize(LLVMTargetDataRef target_data, const char* triple){
+    // Windows uses a different x86-64 convention that isn't supported yet
+    if(strncmp(triple, "x86_64", 6) == 0 && !strstr(triple, "windows"))
+        abi_target_data = target_data;
+}
+
+// Find the class of each eightbyte of an aggregate, and count the floats in each one
+// Returns false if the aggregate has to be passed in memory
+static bool classify(LLVMTypeRef type, uint64_t offset, uint8_t *classes, uint8_t *floats){
+    LLVMTypeRef element;
+    uint64_t size;
+    agg_list_t *agg;
+    switch(LLVMGetTypeKind(type)){
+    case LLVMIntegerTypeKind:
+    case LLVMPointerTypeKind:
+        // INTEGER takes precedence over SSE
+        classes[offset / 8] = CLASS_INTEGER;
+        return true;
+    case LLVMFloatTypeKind:
+        floats[offset / 8]++;
+        // fall through - floats are SSE like doubles
+    case LLVMDoubleTypeKind:
+        if(classes[offset / 8] == CLASS_NONE) classes[offset / 8] = CLASS_SSE;
+        return true;
+    case LLVMArrayTypeKind:
+        element = LLVMGetElementType(type);
+        size = LLVMABISizeOfType(abi_target_data, element);
+        for(uint32_t i = 0; i<LLVMGetArrayLength(type); i++){
+            if(!classify(element, offset + i * size, classes, floats)) return false;
+        }
+        return true;
+    case LLVMStructTypeKind:
+        // Only the fields count, not the padding inserted for align(N)
+        // Fields that aren't aligned (packed structures) must be passed in memory
+        agg = get_struct(type);
+        for(uint32_t i = 0; i<(agg ? agg->components.type_list.length : LLVMCountStructElementTypes(type)); i++){
+            uint32_t index = agg ? agg->indices[i] : i;
+            element = LLVMStructGetTypeAtIndex(type, index);
+            uint64_t field_offset = offset + LLVMOffsetOfElement(abi_target_data, type, index);
+            if(field_offset % type_alignment(element) != 0) return false;
+            if(!classify(element, field_offset, classes, floats)) return false;
+        }
+        return true;
+    default:
+        return false;
+    }
+}
+
+void abi_classify(LLVMTypeRef type, uint32_t *int_regs, uint32_t *sse_regs, abi_arg_t *arg){
+    arg->type = type;
+    arg->coerced = NULL;
+    LLVMTypeKind kind = LLVMGetTypeKind(type);
+
+    // Scalars take the next register of their class, or go on the stack
+    if(!abi_target_data || (kind != LLVMStructTypeKind && kind != LLVMArrayTypeKind)){
+        arg->kind = ABI_DIRECT;
+        if(kind == LLVMFloatTypeKind || kind == LLVMDoubleTypeKind){
+            if(*sse_regs) (*sse_regs)--;
+        } else if(*int_regs){
+            (*int_regs)--;
+        }
+        return;
+    }
+
+    // Aggregates of up to two eightbytes are split into registers if there are enough left
+    uint64_t size = LLVMABISizeOfType(abi_target_data, type);
+    uint8_t classes[2] = {CLASS_NONE, CLASS_NONE};
+    uint8_t floats[2] = {0, 0};
+    arg->kind = ABI_MEMORY;
+    if(size == 0){
+        arg->kind = ABI_IGNORE;
+        return;
+    }
+    if(size > 16 || !classify(type, 0, classes, floats)) return;
+
+    // Eightbytes at the end that are only padding, such as what align(N) adds, aren't passed at all
+    uint32_t count = (size + 7) / 8;
+    while(count > 0 && classes[count - 1] == CLASS_NONE) count--;
+    if(count == 0){
+        arg->kind = ABI_IGNORE;
+        return;
+    }
+    uint32_t need_int = 0, need_sse = 0;
+    for(uint32_t i = 0; i<count; i++){
+        if(classes[i] == CLASS_SSE) need_sse++;
+        else need_int++;
+    }
+    if(need_int > *int_regs || need_sse > *sse_regs) return;
+    *int_regs -= need_int;
+    *sse_regs -= need_sse;
+
+    // Each eightbyte becomes an integer of its size, a float, two floats or a double
+    LLVMTypeRef pieces[2];
+    for(uint32_t i = 0; i<count; i++){
+        uint64_t bytes = size - i * 8 < 8 ? size - i * 8 : 8;
+        if(classes[i] != CLASS_SSE)
+            pieces[i] = LLVMIntType(bytes * 8);
+        else if(floats[i] == 2)
+            pieces[i] = LLVMVectorType(LLVMFloatType(), 2);
+        else if(bytes <= 4)
+            pieces[i] = LLVMFloatType();
+        else
+            pieces[i] = LLVMDoubleType();
+    }
+    arg->kind = ABI_COERCE;
+    arg->coerced = LLVMStructType(pieces, count, false);
+}
+
+abi_function_t *abi_function(LLVMTypeRef type){
+    // Every function type is only lowered once
+    for(abi_function_t *current = abi_functions[ABI_BUCKET(type)]; current; current = current->next){
+        if(current->type == type) return current;
+    }
+    abi_function_t *fn = malloc(sizeof(abi_function_t));
+    fn->type = type;
+    fn->next = abi_functions[ABI_BUCKET(type)];
+    abi_functions[ABI_BUCKET(type)] = fn;
+
+    // Values are returned in RAX/RDX and XMM0/XMM1, or in memory allocated by the caller
+    uint32_t num_params = LLVMCountParamTypes(type);
+    LLVMTypeRef *params = malloc(sizeof(LLVMTypeRef) * (num_params ? num_params : 1));
+    LLVMTypeRef *lowered = malloc(sizeof(LLVMTypeRef) * (2 * num_params + 1));
+    LLVMGetParamTypes(type, params);
+    uint32_t count = 0;
+    uint32_t int_regs = 2, sse_regs = 2;
+    LLVMTypeRef return_type = LLVMGetReturnType(type);
+    LLVMTypeRef lowered_return = return_type;
+    fn->ret.first = 0;
+    if(return_type == LLVMVoidType()){
+        fn->ret.kind = ABI_DIRECT;
+        fn->ret.type = return_type;
+        fn->ret.coerced = NULL;
+    } else{
+        abi_classify(return_type, &int_regs, &sse_regs, &fn->ret);
+    }
+    if(fn->ret.kind == ABI_MEMORY){
+        lowered[count++] = LLVMPointerType(return_type, 0);
+        lowered_return = LLVMVoidType();
+    } else if(fn->ret.kind == ABI_IGNORE){
+        lowered_return = LLVMVoidType();
+    } else if(fn->ret.kind == ABI_COERCE){
+        // A single piece is returned as itself
+        lowered_return = fn->ret.coerced;
+        if(LLVMCountStructElementTypes(fn->ret.coerced) == 1)
+            lowered_return = LLVMStructGetTypeAtIndex(fn->ret.coerced, 0);
+    }
+
+    // Arguments get the six integer and eight SSE registers in order, skipping the sret pointer
+    fn->args = malloc(sizeof(abi_arg_t) * (num_params ? num_params : 1));
+    int_regs = fn->ret.kind == ABI_MEMORY ? 5 : 6;
+    sse_regs = 8;
+    for(uint32_t i = 0; i<num_params; i++){
+        abi_arg_t *arg = &fn->args[i];
+        abi_classify(params[i], &int_regs, &sse_regs, arg);
+        arg->first = count;
+        if(arg->kind == ABI_DIRECT){
+            lowered[count++] = params[i];
+        } else if(arg->kind == ABI_MEMORY){
+            lowered[count++] = LLVMPointerType(params[i], 0);
+        } else if(arg->kind == ABI_COERCE){
+            for(uint32_t j = 0; j<LLVMCountStructElementTypes(arg->coerced); j++)
+                lowered[count++] = LLVMStructGetTypeAtIndex(arg->coerced, j);
+        }
+    }
+    fn->int_regs = int_regs;
+    fn->sse_regs = sse_regs;
+    fn->lowered = LLVMFunctionType(lowered_return, lowered, count, LLVMIsFunctionVarArg(type));
+    fn->is_lowered = fn->lowered != type;
+    free(params);
+    free(lowered);
+    return fn;
+}
+
+bool abi_uses_memory(abi_function_t *fn){
+    if(fn->ret.kind == ABI_MEMORY) return true;
+    for(uint32_t i = 0; i<LLVMCountParamTypes(fn->type); i++){
+        if(fn->args[i].kind == ABI_MEMORY) return true;
+    }
+    return false;
+}
+
+void abi_attributes(LLVMValueRef value, abi_arg_t *arg, bool is_return, bool is_call){
+    if(arg->kind != ABI_MEMORY) return;
+
+    // Returned values are written to memory of the caller, and arguments are copied to the stack
+    LLVMContextRef context = LLVMGetGlobalContext();
+    const char* name = is_return ? "sret" : "byval";
+    uint32_t align = type_alignment(arg->type);
+    if(!is_return && align < 8) align = 8;
+    LLVMAttributeRef attributes[2] = {
+        LLVMCreateTypeAttribute(context, LLVMGetEnumAttributeKindForName(name, strlen(name)), arg->type),
+        LLVMCreateEnumAttribute(context, LLVMGetEnumAttributeKindForName("align", 5), align)
+    };
+    for(uint32_t i = 0; i<2; i++){
+        if(is_call)
+            LLVMAddCallSiteAttribute(value, arg->first + 1, attributes[i]);
+        else
+            LLVMAddAttributeAtIndex(value, arg->first + 1, attributes[i]);
+    }
+}
@@ -0,0 +1,54 @@
+#ifndef ABI_H
+#define ABI_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <llvm-c/Core.h>
+#include <llvm-c/Target.h>
+
+// How a parameter or return value is passed by the x86-64 System V ABI
+typedef enum abi_kind {
+    ABI_DIRECT,     // As the value itself (scalars, and everything on other targets)
+    ABI_COERCE,     // In one or two registers, as the pieces of the coerced type
+    ABI_MEMORY,     // As a pointer to a byval copy, or returned through an sret pointer
+    ABI_IGNORE      // Not passed at all (empty structures, or only padding)
+} abi_kind_t;
+
+// Store how one parameter or return value is passed
+typedef struct abi_arg {
+    abi_kind_t kind;
+    LLVMTypeRef type;       // Type in the source program
+    LLVMTypeRef coerced;    // Struct of the register pieces for ABI_COERCE
+    uint32_t first;         // Parameter of the lowered function that holds it
+} abi_arg_t;
+
+// Store the lowering of a function type
+// Every function and call with the same source type shares it
+typedef struct abi_function {
+    struct abi_function *next;
+    LLVMTypeRef type;       // Function type in the source program
+    LLVMTypeRef lowered;    // Function type that LLVM sees
+    abi_arg_t ret;
+    abi_arg_t *args;
+    uint32_t int_regs;      // Registers left over for variadic arguments
+    uint32_t sse_regs;
+    bool is_lowered;        // Whether the lowered type differs from the source type
+} abi_function_t;
+
+// Lower aggregates for the target of the module
+// Without this, or on targets other than x86-64 System V, every value is passed directly
+void abi_initialize(LLVMTargetDataRef target_data, const char* triple);
+
+// Find how a source function type is lowered
+abi_function_t *abi_function(LLVMTypeRef type);
+
+// Classify an argument given the number of registers that are still free
+void abi_classify(LLVMTypeRef type, uint32_t *int_regs, uint32_t *sse_regs, abi_arg_t *arg);
+
+// Whether a function type passes or returns anything through memory
+bool abi_uses_memory(abi_function_t *fn);
+
+// Add sret/byval attributes to a function, or to a call of it
+void abi_attributes(LLVMValueRef value, abi_arg_t *arg, bool is_return, bool is_call);
+
+#endif
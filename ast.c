@@ -0,0 +1,119 @@
+#include "ast.h"
+#include <stdlib.h>
+#include <string.h>
+
+// Nodes are bump-allocated from large blocks and freed all at once
+#define ARENA_BLOCK_NODES 4096
+
+typedef struct arena_block {
+    struct arena_block *prev;
+    uint32_t used;
+    ast_node_t nodes[ARENA_BLOCK_NODES];
+} arena_block_t;
+
+arena_block_t *arena = NULL;
+ast_node_t *ast_program = NULL;
+
+ast_node_t *ast_create(ast_kind_t kind, uint32_t line, uint32_t column){
+    // Start a new block when the current one is full
+    if(!arena || arena->used == ARENA_BLOCK_NODES){
+        arena_block_t *block = malloc(sizeof(arena_block_t));
+        block->prev = arena;
+        block->used = 0;
+        arena = block;
+    }
+    ast_node_t *node = &arena->nodes[arena->used++];
+    memset(node, 0, sizeof(ast_node_t));
+    node->kind = kind;
+    node->line = line;
+    node->column = column;
+    return node;
+}
+
+ast_node_t *ast_unary(ast_kind_t kind, ast_node_t *left, uint32_t line, uint32_t column){
+    ast_node_t *node = ast_create(kind, line, column);
+    node->left = left;
+    return node;
+}
+
+ast_node_t *ast_binary(ast_kind_t kind, operation_t op, ast_node_t *left, ast_node_t *right, uint32_t line, uint32_t column){
+    ast_node_t *node = ast_create(kind, line, column);
+    node->op = op;
+    node->left = left;
+    node->right = right;
+    return node;
+}
+
+ast_node_t *ast_primitive(LLVMTypeRef type, uint32_t line, uint32_t column){
+    ast_node_t *node = ast_create(AST_TYPE_PRIMITIVE, line, column);
+    node->type = type;
+    return node;
+}
+
+static ast_node_t *ast_copy(ast_node_t *node, ast_node_t *params, LLVMTypeRef *types);
+
+static ast_node_t *ast_copy_list(ast_node_t *list, ast_node_t *params, LLVMTypeRef *types){
+    ast_list_t copy;
+    initialize_ast_list(&copy);
+    for(; list; list = list->next)
+        insert_ast_list(&copy, ast_copy(list, params, types));
+    return copy.head;
+}
+
+static ast_node_t *ast_copy(ast_node_t *node, ast_node_t *params, LLVMTypeRef *types){
+    if(!node) return NULL;
+
+    // Type parameters become the types they are bound to
+    if(node->kind == AST_TYPE_NAME && !node->list){
+        uint32_t i = 0;
+        for(ast_node_t *param = params; param; param = param->next, i++){
+            if(strcmp(param->name, node->name) == 0)
+                return ast_primitive(types[i], node->line, node->column);
+        }
+    }
+    ast_node_t *copy = ast_create(node->kind, node->line, node->column);
+    *copy = *node;
+    copy->next = NULL;
+    copy->left = ast_copy(node->left, params, types);
+    copy->right = ast_copy(node->right, params, types);
+    if(node->kind == AST_CASE) copy->body = ast_copy_list(node->body, params, types);
+    else copy->body = ast_copy(node->body, params, types);
+    copy->list = ast_copy_list(node->list, params, types);
+    return copy;
+}
+
+ast_node_t *ast_instantiate(ast_node_t *node, LLVMTypeRef *types){
+    ast_node_t *params = node->right;
+    node->right = NULL;
+    ast_node_t *copy = ast_copy(node, params, types);
+    node->right = params;
+    copy->flags &= ~AST_GENERIC;
+    return copy;
+}
+
+void initialize_ast_list(ast_list_t *list){
+    list->head = NULL;
+    list->tail = NULL;
+}
+
+void insert_ast_list(ast_list_t *list, ast_node_t *node){
+    // Keep a tail pointer so that appending is constant time
+    node->next = NULL;
+    if(list->tail) list->tail->next = node;
+    else list->head = node;
+    list->tail = node;
+}
+
+uint32_t ast_length(ast_node_t *list){
+    uint32_t length = 0;
+    for(; list; list = list->next) length++;
+    return length;
+}
+
+void ast_free_all(){
+    while(arena){
+        arena_block_t *prev = arena->prev;
+        free(arena);
+        arena = prev;
+    }
+}
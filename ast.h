@@ -0,0 +1,183 @@
+#ifndef AST_H
+#define AST_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <llvm-c/Core.h>
+
+// Different Types of Operations
+typedef enum operation{
+    OP_ADD,
+    OP_SUB,
+    OP_MUL,
+    OP_DIV,
+    OP_MOD,
+    OP_BIT_AND,
+    OP_BIT_OR,
+    OP_BIT_XOR,
+    OP_BIT_NOT,
+    OP_LSHIFT,
+    OP_RSHIFT,
+    OP_BOOL_AND,
+    OP_BOOL_OR,
+    OP_BOOL_NOT,
+    OP_LESS,
+    OP_LEQ,
+    OP_GREATER,
+    OP_GEQ,
+    OP_EQ,
+    OP_NEQ,
+    OP_MIN,     // Only used by reductions
+    OP_MAX
+} operation_t;
+
+// Different kinds of AST nodes
+// The comment after each kind says which fields of ast_node_t it uses
+typedef enum ast_kind {
+    // Types
+    AST_TYPE_PRIMITIVE,     // type
+    AST_TYPE_NAME,          // name, list = type arguments (or NULL)
+    AST_TYPE_POINTER,       // left = pointee
+    AST_TYPE_ARRAY,         // left = element, int_value = length
+    AST_TYPE_SLICE,         // left = element
+    AST_TYPE_FUNCTION,      // left = return type (NULL for void), list = parameter types, AST_VARG
+    AST_TYPE_REGION,
+    AST_TYPE_POOL,          // left = element
+
+    // Globals
+    AST_FUNCTION,           // name, left = return type, right = type parameters, list = AST_PARAMs, body (NULL for prototypes), AST_VARG/AST_ESCAPES/AST_GENERIC/AST_CONST
+    AST_PARAM,              // name, left = type (a pointer for references), AST_BYREF
+    AST_STRUCT,             // name, right = type parameters, list = AST_FIELDs (NULL for opaque), int_value = align, AST_PACKED/AST_REORDER/AST_OPAQUE/AST_GENERIC
+    AST_FIELD,              // name, left = type, int_value = align
+    AST_TYPEDEF,            // name, left = type
+
+    // Statements
+    AST_DECLARATION,        // left = type, list = AST_DECLARATORs, AST_LOCAL/AST_THREADLOCAL/AST_CONST
+    AST_DECLARATOR,         // name, right = initializer (or NULL)
+    AST_INITIALIZER,        // list = values of the elements or fields, in order (missing ones are zero)
+    AST_BLOCK,              // list = statements
+    AST_IF,                 // left = condition, body = then, right = else (or NULL)
+    AST_WHILE,              // name = label (or NULL), left = condition, body
+    AST_FOR,                // name = label (or NULL), list = AST_DECLARATOR of the element, left = array or slice, body
+    AST_PARALLEL,           // name = index, left = start, right = end (exclusive), body, list = AST_CAPTUREs
+    AST_CAPTURE,            // name, op (reductions), type (set by sema), AST_REDUCE/AST_BYREF
+    AST_SWITCH,             // name = label (or NULL), left = value, list = AST_CASEs
+    AST_CASE,               // list = case values and AST_RANGEs, body = list of statements, AST_DEFAULT
+    AST_RANGE,              // left = low, right = high (inclusive)
+    AST_BREAK,              // name = label (or NULL)
+    AST_CONTINUE,           // name = label (or NULL)
+    AST_RETURN,             // left = value (or NULL), AST_TAIL
+    AST_DELETE,             // left = pointer, body = pool (or NULL for the heap)
+
+    // Expressions
+    AST_ASSIGN,             // left, right
+    AST_MATH,               // op, left, right
+    AST_BITWISE,            // op, left, right
+    AST_BOOLEAN,            // op, left, right
+    AST_COMPARISON,         // op, left, right
+    AST_NEGATE,             // left
+    AST_BIT_NOT,            // left
+    AST_BOOL_NOT,           // left
+    AST_REF,                // left
+    AST_DEREF,              // left
+    AST_CALL,               // left = function, list = arguments (AST_PASS_ADDRESS if passed by reference)
+    AST_BUILTIN,            // name, list = arguments, int_value = builtin_t (set by sema)
+    AST_CAST,               // left = value, right = type
+    AST_DOT,                // left, name
+    AST_INDEX,              // left, right = index
+    AST_SLICE,              // left = array, pointer or slice, right = low (or NULL for 0), body = high (or NULL for the length)
+    AST_SIZEOF,             // left = type
+    AST_NEW,                // left = type, right = count (or NULL), body = region or pool (or NULL for the heap)
+    AST_COMPTIME,           // left = value, which is computed while compiling
+    AST_IDENTIFIER,         // name, AST_BYREF
+    AST_INT,                // int_value, type = suffix (AST_SUFFIX)
+    AST_FP,                 // fp_value
+    AST_STRING              // name = contents
+} ast_kind_t;
+
+// Flags of AST nodes
+#define AST_VARG    (1 << 0)
+#define AST_PACKED  (1 << 1)
+#define AST_REORDER (1 << 2)
+#define AST_OPAQUE  (1 << 3)
+#define AST_LOCAL   (1 << 4)
+#define AST_LVALUE  (1 << 5) // Set by sema on expressions that have an address
+#define AST_RESOLVED (1 << 6) // Set by sema on structures that have been laid out
+#define AST_VISITING (1 << 7)
+#define AST_DEFAULT (1 << 8)
+#define AST_TAIL    (1 << 9)
+#define AST_ESCAPES (1 << 10) // Set by sema on functions that take the address of a local, and on the declaration of that local
+#define AST_BYREF   (1 << 11)
+#define AST_PASS_ADDRESS (1 << 12) // Set by sema on arguments that are passed by reference
+#define AST_THREADLOCAL (1 << 13)
+#define AST_REDUCE  (1 << 14)
+#define AST_GENERIC (1 << 15) // Type parameters are AST_TYPE_NAMEs, which sema replaces in each copy
+#define AST_CONST   (1 << 16) // Functions that can run at compile time, and read-only globals
+#define AST_IN_BOUNDS (1 << 17) // Set by sema on array indices that a loop condition keeps in bounds
+#define AST_SUFFIX  (1 << 18) // Integer literals with a suffix, whose type the parser sets
+#define AST_UNTYPED (1 << 19) // Set by sema on integer constants that take the type of their context, with int_value folded
+#define AST_BITS    (1 << 20) // Hexadecimal and binary integer literals, which can fill the unsigned range of their type
+
+// An integer literal, with the width of its suffix like 10i64, or 0 without one
+// Hexadecimal and binary literals are bit patterns
+typedef struct int_literal {
+    int64_t value;
+    uint32_t width;
+    bool bits;
+} int_literal_t;
+
+// Every node has the same compact layout; see ast_kind_t for the meaning of each field
+// Lists of nodes are linked through next
+typedef struct ast_node {
+    struct ast_node *next;
+    ast_kind_t kind;
+    operation_t op;
+    uint32_t flags;
+    uint32_t line;
+    uint32_t column;
+    LLVMTypeRef type;       // Type named by a type node, or type of an expression (set by sema)
+    char* name;
+    union {
+        int64_t int_value;
+        double fp_value;
+    };
+    struct ast_node *left;
+    struct ast_node *right;
+    struct ast_node *body;
+    struct ast_node *list;
+} ast_node_t;
+
+// Globals of the program, in source order (set by yyparse())
+extern ast_node_t *ast_program;
+
+// A list of nodes that is appended to while parsing
+typedef struct ast_list {
+    ast_node_t *head;
+    ast_node_t *tail;
+} ast_list_t;
+
+// Allocate a node from the AST arena
+ast_node_t *ast_create(ast_kind_t kind, uint32_t line, uint32_t column);
+
+// Create expression nodes with one or two operands
+ast_node_t *ast_unary(ast_kind_t kind, ast_node_t *left, uint32_t line, uint32_t column);
+ast_node_t *ast_binary(ast_kind_t kind, operation_t op, ast_node_t *left, ast_node_t *right, uint32_t line, uint32_t column);
+
+// Create a type node for an LLVM type that needs no resolving
+ast_node_t *ast_primitive(LLVMTypeRef type, uint32_t line, uint32_t column);
+
+// Copy a generic function or structure, replacing each type parameter with a type
+// The copy has no type parameters, so it is checked and generated like any other
+ast_node_t *ast_instantiate(ast_node_t *node, LLVMTypeRef *types);
+
+// Initialization/Insertion into ast_list
+void initialize_ast_list(ast_list_t *list);
+void insert_ast_list(ast_list_t *list, ast_node_t *node);
+
+// Count the nodes of a list
+uint32_t ast_length(ast_node_t *list);
+
+// Free every node of the arena at once
+void ast_free_all();
+
+#endif
@@ -0,0 +1,15 @@
+#!/bin/sh
+# Compare malloc/free with a region and a pool when building binary trees
+# Usage: bench/alloc.sh [compiler]
+COMPILER=${1:-./out}
+DIR=$(dirname $0)
+RUNTIME=$(dirname $COMPILER)/libruntime.a
+for form in malloc region pool; do
+    $COMPILER $DIR/alloc_$form.txt -o /tmp/alloc_$form.o > /dev/null
+    gcc -no-pie /tmp/alloc_$form.o $RUNTIME -o /tmp/alloc_$form
+    START=$(date +%s.%N)
+    RESULT=$(/tmp/alloc_$form)
+    END=$(date +%s.%N)
+    echo "$form: $(awk -v s=$START -v e=$END 'BEGIN { print e - s }')s (result $RESULT)"
+    rm -f /tmp/alloc_$form.o /tmp/alloc_$form
+done
@@ -0,0 +1,14 @@
+#!/bin/sh
+# Compare passing a large structure by value (byval) and by reference
+# Usage: bench/args.sh [compiler]
+COMPILER=${1:-./out}
+DIR=$(dirname $0)
+for form in value reference; do
+    $COMPILER $DIR/args_$form.txt -o /tmp/args_$form.o > /dev/null
+    gcc -no-pie /tmp/args_$form.o -o /tmp/args_$form
+    START=$(date +%s.%N)
+    RESULT=$(/tmp/args_$form)
+    END=$(date +%s.%N)
+    echo "$form: $(awk -v s=$START -v e=$END 'BEGIN { print e - s }')s (result $RESULT)"
+    rm -f /tmp/args_$form.o /tmp/args_$form
+done
@@ -0,0 +1,19 @@
+#!/bin/sh
+# Compare array loops with and without -f bounds-check, with and without -O2
+# bounds_loop only has indices that sema proves in bounds, bounds_gather checks every access to values
+# Usage: bench/bounds.sh [compiler]
+COMPILER=${1:-./out}
+DIR=$(dirname $0)
+for form in loop gather; do
+    for level in "" -O2; do
+        for check in "" "-f bounds-check"; do
+            $COMPILER $DIR/bounds_$form.txt $level $check -o /tmp/bounds_$form.o > /dev/null
+            gcc -no-pie /tmp/bounds_$form.o -o /tmp/bounds_$form
+            START=$(date +%s.%N)
+            RESULT=$(/tmp/bounds_$form)
+            END=$(date +%s.%N)
+            echo "$form ${level:-(no -O)} ${check:-(unchecked)}: $(awk -v s=$START -v e=$END 'BEGIN { print e - s }')s (result $RESULT)"
+        done
+    done
+    rm -f /tmp/bounds_$form.o /tmp/bounds_$form
+done
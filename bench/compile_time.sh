@@ -0,0 +1,52 @@
+#!/bin/sh
+# Time the compiler on a large generated program
+# Usage: bench/compile_time.sh [compiler] [functions] [runs]
+# OUT_FLAGS are added to every run of the compiler, e.g. OUT_FLAGS="-f lexer-thread"
+COMPILER=${1:-./out}
+FUNCTIONS=${2:-2000}
+RUNS=${3:-5}
+SOURCE=/tmp/compile_time_$$.txt
+
+# Every function has a struct, a loop, a conditional and a call to the previous function
+{
+    echo "fn printf(*i8 str, ...);"
+    echo "struct pair { i32 a, i64 b }"
+    echo "fn work0(i32 x) -> i32 { return x; }"
+    i=1
+    while [ $i -lt $FUNCTIONS ]; do
+        cat <<END
+fn work$i(i32 x) -> i32 {
+    decl pair p;
+    decl i32 i = 0, sum = 0;
+    p.a = x;
+    while(i < x){
+        if(i % 3 == 0) sum = sum + i * 2;
+        else sum = sum - work$((i - 1))(i);
+        i = i + 1;
+    }
+    p.b = sum;
+    return p.a + p.b as i32;
+}
+END
+        i=$((i + 1))
+    done
+    echo "fn main() -> i32 { printf(\"%d\\n\", work$((FUNCTIONS - 1))(3)); return 0; }"
+} > $SOURCE
+
+# Report the best of several runs for the frontend alone (-r) and the whole compile
+best(){
+    BEST=""
+    run=0
+    while [ $run -lt $RUNS ]; do
+        START=$(date +%s.%N)
+        "$@" > /dev/null
+        END=$(date +%s.%N)
+        BEST=$(awk -v s=$START -v e=$END -v b="$BEST" 'BEGIN { t = e - s; if(b == "" || t < b) b = t; print b }')
+        run=$((run + 1))
+    done
+    echo $BEST
+}
+echo "$(wc -l < $SOURCE) lines, $FUNCTIONS functions"
+echo "frontend (-r): $(best $COMPILER $OUT_FLAGS -r $SOURCE -o /tmp/compile_time_$$.ll)s"
+echo "total:         $(best $COMPILER $OUT_FLAGS $SOURCE -o /tmp/compile_time_$$.o)s"
+rm -f $SOURCE /tmp/compile_time_$$.ll /tmp/compile_time_$$.o
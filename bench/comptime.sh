@@ -0,0 +1,17 @@
+#!/bin/sh
+# Compare a lookup table computed while compiling against one computed when the program starts
+# Usage: bench/comptime.sh [compiler]
+COMPILER=${1:-./out}
+DIR=$(dirname $0)
+for form in startup global; do
+    START=$(date +%s.%N)
+    $COMPILER $DIR/comptime_$form.txt -o /tmp/comptime_$form.o > /dev/null
+    END=$(date +%s.%N)
+    COMPILE=$(awk -v s=$START -v e=$END 'BEGIN { print e - s }')
+    gcc -no-pie /tmp/comptime_$form.o -o /tmp/comptime_$form
+    START=$(date +%s.%N)
+    RESULT=$(/tmp/comptime_$form)
+    END=$(date +%s.%N)
+    echo "$form: compile ${COMPILE}s, run $(awk -v s=$START -v e=$END 'BEGIN { print e - s }')s (result $RESULT)"
+    rm -f /tmp/comptime_$form.o /tmp/comptime_$form
+done
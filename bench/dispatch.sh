@@ -0,0 +1,14 @@
+#!/bin/sh
+# Compare switch dispatch against an if/else if chain in a bytecode interpreter loop
+# Usage: bench/dispatch.sh [compiler]
+COMPILER=${1:-./out}
+DIR=$(dirname $0)
+for form in if switch; do
+    $COMPILER $DIR/dispatch_$form.txt -o /tmp/dispatch_$form.o > /dev/null
+    gcc -no-pie /tmp/dispatch_$form.o -o /tmp/dispatch_$form
+    START=$(date +%s.%N)
+    RESULT=$(/tmp/dispatch_$form)
+    END=$(date +%s.%N)
+    echo "$form: $(awk -v s=$START -v e=$END 'BEGIN { print e - s }')s (result $RESULT)"
+    rm -f /tmp/dispatch_$form.o /tmp/dispatch_$form
+done
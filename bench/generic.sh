@@ -0,0 +1,14 @@
+#!/bin/sh
+# Compare a generic quicksort, copied for each element type, against one over *i8 with a comparison function
+# Usage: bench/generic.sh [compiler]
+COMPILER=${1:-./out}
+DIR=$(dirname $0)
+for form in erased sort; do
+    $COMPILER $DIR/generic_$form.txt -o /tmp/generic_$form.o > /dev/null
+    gcc -no-pie /tmp/generic_$form.o -o /tmp/generic_$form
+    START=$(date +%s.%N)
+    RESULT=$(/tmp/generic_$form)
+    END=$(date +%s.%N)
+    echo "$form: $(awk -v s=$START -v e=$END 'BEGIN { print e - s }')s (result $RESULT)"
+    rm -f /tmp/generic_$form.o /tmp/generic_$form
+done
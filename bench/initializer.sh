@@ -0,0 +1,14 @@
+#!/bin/sh
+# Compare a local table initialized from a list, which is copied from read-only data, against one filled element by element
+# Usage: bench/initializer.sh [compiler]
+COMPILER=${1:-./out}
+DIR=$(dirname $0)
+for form in stores list; do
+    $COMPILER $DIR/initializer_$form.txt -o /tmp/initializer_$form.o > /dev/null
+    gcc -no-pie /tmp/initializer_$form.o -o /tmp/initializer_$form
+    START=$(date +%s.%N)
+    RESULT=$(/tmp/initializer_$form)
+    END=$(date +%s.%N)
+    echo "$form: $(awk -v s=$START -v e=$END 'BEGIN { print e - s }')s (result $RESULT)"
+    rm -f /tmp/initializer_$form.o /tmp/initializer_$form
+done
@@ -0,0 +1,14 @@
+#!/bin/sh
+# Compare builtins lowered to LLVM intrinsics against calls to the same operations in libraries
+# Usage: bench/intrinsics.sh [compiler]
+COMPILER=${1:-./out}
+DIR=$(dirname $0)
+for form in extern builtin; do
+    $COMPILER $DIR/intrinsics_$form.txt -o /tmp/intrinsics_$form.o > /dev/null
+    gcc -no-pie /tmp/intrinsics_$form.o -o /tmp/intrinsics_$form -lm
+    START=$(date +%s.%N)
+    RESULT=$(/tmp/intrinsics_$form)
+    END=$(date +%s.%N)
+    echo "$form: $(awk -v s=$START -v e=$END 'BEGIN { print e - s }')s (result $RESULT)"
+    rm -f /tmp/intrinsics_$form.o /tmp/intrinsics_$form
+done
@@ -0,0 +1,35 @@
+#!/bin/sh
+# Compare flex with the hand-written lexer of -f simd-lexer on a large source, made of copies of every benchmark
+# Both have to list the same tokens, with the same values and locations, also when they lex on a thread of their own
+# Usage: bench/lexer.sh [compiler] [copies]
+COMPILER=${1:-./out}
+COPIES=${2:-1000}
+DIR=$(dirname $0)
+TMP=/tmp/lexer_$$
+
+# The copies redefine everything, which only matters after lexing
+i=0
+while [ $i -lt $COPIES ]; do
+    cat $DIR/*.txt $DIR/suite/*.txt
+    i=$((i + 1))
+done > $TMP.txt
+BYTES=$(wc -c < $TMP.txt)
+echo "source: $BYTES bytes"
+
+# With -f lexer-thread, the tokens also go through the queue between the lexer thread and the reader
+for lexer in flex simd flex-thread simd-thread; do
+    FLAGS=""
+    case $lexer in simd*) FLAGS="-f simd-lexer";; esac
+    case $lexer in *thread) FLAGS="$FLAGS -f lexer-thread";; esac
+    $COMPILER $TMP.txt $FLAGS --tokens $TMP.$lexer | awk -v lexer=$lexer -v bytes=$BYTES \
+        '/^Lexed/ { printf "%-12s %s tokens in %s (%.0f MB/s)\n", lexer ":", $2, $5, bytes / $5 / 1e6 }'
+done
+for lexer in simd flex-thread simd-thread; do
+    if cmp -s $TMP.flex $TMP.$lexer; then
+        echo "$lexer: same tokens as flex"
+    else
+        echo "$lexer: different tokens:"
+        diff $TMP.flex $TMP.$lexer | head -10
+    fi
+done
+rm -f $TMP.txt $TMP.flex $TMP.simd $TMP.flex-thread $TMP.simd-thread
@@ -0,0 +1,25 @@
+#!/bin/sh
+# Compare a serial loop with a parallel for loop on 1 to N worker threads
+# Usage: bench/parallel.sh [compiler] [max threads]
+COMPILER=${1:-./out}
+THREADS=${2:-$(nproc)}
+DIR=$(dirname $0)
+RUNTIME=$(dirname $COMPILER)/libruntime.a
+for form in serial for; do
+    $COMPILER $DIR/parallel_$form.txt -o /tmp/parallel_$form.o > /dev/null
+    gcc -no-pie /tmp/parallel_$form.o $RUNTIME -o /tmp/parallel_$form -lpthread
+done
+run(){
+    START=$(date +%s.%N)
+    RESULT=$(PARALLEL_THREADS=$2 /tmp/parallel_$1)
+    END=$(date +%s.%N)
+    echo "$3: $(awk -v s=$START -v e=$END 'BEGIN { print e - s }')s (result $RESULT)"
+}
+run serial 1 serial
+n=1
+while [ $n -le $THREADS ]; do
+    run for $n "parallel, $n threads"
+    n=$((n * 2))
+    [ $n -gt $THREADS ] && [ $((n / 2)) -lt $THREADS ] && n=$THREADS
+done
+rm -f /tmp/parallel_serial.o /tmp/parallel_serial /tmp/parallel_for.o /tmp/parallel_for
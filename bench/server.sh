@@ -0,0 +1,38 @@
+#!/bin/sh
+# Compare compiling many small files with one process each and through a compile server
+# Usage: bench/server.sh [compiler] [files] [jobs]
+# The thin client outc is also timed if it was built next to the compiler
+COMPILER=$(realpath ${1:-./out})
+CLIENT=$(dirname $COMPILER)/outc
+FILES=${2:-200}
+JOBS=${3:-$(nproc)}
+DIR=$(realpath $(dirname $0))
+WORK=/tmp/server_$$
+SOCKET=$WORK/out.sock
+mkdir -p $WORK
+
+# Cycle through the other benchmark programs
+i=0
+for source in $(yes "$DIR"/*.txt | head -n $FILES); do
+    [ $i -ge $FILES ] && break
+    cp $source $WORK/file$i.txt
+    i=$((i + 1))
+done
+
+# Compile every file with up to JOBS commands at once, and report files per second
+run(){
+    START=$(date +%s.%N)
+    ls $WORK/*.txt | xargs -P $JOBS -I{} sh -c "$1 {} -o {}.o > /dev/null"
+    END=$(date +%s.%N)
+    echo "$2: $(awk -v s=$START -v e=$END -v n=$FILES 'BEGIN { printf "%.2fs, %.1f files/s", e - s, n / (e - s) }')"
+}
+cd $WORK
+run "$COMPILER" "one process per file"
+$COMPILER --server $SOCKET --workers $JOBS > /dev/null &
+SERVER=$!
+while [ ! -S $SOCKET ]; do sleep 0.1; done
+run "OUT_SERVER=$SOCKET $COMPILER" "compile server, out client"
+[ -x $CLIENT ] && run "OUT_SERVER=$SOCKET $CLIENT" "compile server, outc client"
+kill $SERVER
+cd /
+rm -rf $WORK
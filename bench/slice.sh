@@ -0,0 +1,17 @@
+#!/bin/sh
+# Compare loops over a pointer and a length against loops over a slice, with and without -O2
+# Pointer indices are computed with integer arithmetic, which keeps their loops from vectorizing
+# Usage: bench/slice.sh [compiler]
+COMPILER=${1:-./out}
+DIR=$(dirname $0)
+for form in pointer for; do
+    for level in "" -O2; do
+        $COMPILER $DIR/slice_$form.txt $level -o /tmp/slice_$form.o > /dev/null
+        gcc -no-pie /tmp/slice_$form.o -o /tmp/slice_$form
+        START=$(date +%s.%N)
+        RESULT=$(/tmp/slice_$form)
+        END=$(date +%s.%N)
+        echo "$form ${level:-(no -O)}: $(awk -v s=$START -v e=$END 'BEGIN { print e - s }')s (result $RESULT)"
+    done
+    rm -f /tmp/slice_$form.o /tmp/slice_$form
+done
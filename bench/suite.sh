@@ -0,0 +1,60 @@
+#!/bin/sh
+# Run each program of bench/suite at every optimization level, and its C reference built with clang -O2
+# Reports the runtime, instructions retired (with perf) and text size of the object, and checks the output against C
+# Usage: bench/suite.sh [compiler] [programs...]
+# OUT_FLAGS are added to every build with the compiler, e.g. OUT_FLAGS="-f bounds-check"
+COMPILER=${1:-./out}
+[ $# -gt 0 ] && shift
+PROGRAMS=${*:-fib nbody matmul sieve hash sim}
+DIR=$(dirname $0)/suite
+TMP=/tmp/suite_$$
+
+# The reference compiler can be changed with CC, and instructions are only counted if perf can read them
+CC=${CC:-clang}
+if ! command -v $CC > /dev/null; then
+    echo "$CC not found, building the C references with cc"
+    CC=cc
+fi
+PERF=""
+if command -v perf > /dev/null && perf stat -x, -e instructions true > /dev/null 2>&1; then
+    PERF=yes
+fi
+
+# Run a binary, setting TIME, INSTRUCTIONS and OUTPUT
+measure(){
+    START=$(date +%s.%N)
+    OUTPUT=$($1)
+    END=$(date +%s.%N)
+    TIME=$(awk -v s=$START -v e=$END 'BEGIN { printf "%.3f", e - s }')
+    INSTRUCTIONS=-
+    if [ -n "$PERF" ]; then
+        INSTRUCTIONS=$(perf stat -x, -e instructions $1 2>&1 > /dev/null | awk -F, '/instructions/ { print $1 }')
+    fi
+}
+
+# Compare the text size of objects, which doesn't depend on how they are linked
+text_size(){
+    size $1 | awk 'NR == 2 { print $1 }'
+}
+
+printf "%-8s %-10s %9s %15s %8s\n" program build time instructions text
+for name in $PROGRAMS; do
+    $CC -O2 -c $DIR/$name.c -o $TMP.c.o
+    $CC $TMP.c.o -o $TMP.c -lm
+    measure $TMP.c
+    EXPECTED=$OUTPUT
+    printf "%-8s %-10s %8ss %15s %8s\n" $name "$CC -O2" $TIME $INSTRUCTIONS $(text_size $TMP.c.o)
+
+    # Without -O, only llc optimizes, at its default level
+    for level in default 0 1 2 3; do
+        FLAGS=""
+        [ $level != default ] && FLAGS=-O$level
+        $COMPILER $DIR/$name.txt $FLAGS $OUT_FLAGS -o $TMP.o > /dev/null
+        cc -no-pie $TMP.o -o $TMP -lm
+        measure $TMP
+        CHECK=""
+        [ "$OUTPUT" != "$EXPECTED" ] && CHECK=" (wrong output: $OUTPUT)"
+        printf "%-8s %-10s %8ss %15s %8s%s\n" $name "out ${FLAGS:-(none)}" $TIME $INSTRUCTIONS $(text_size $TMP.o) "$CHECK"
+    done
+done
+rm -f $TMP $TMP.o $TMP.c $TMP.c.o
@@ -0,0 +1,41 @@
+// Reference for hash.txt
+#include <stdio.h>
+#include <stdlib.h>
+
+long hash_word(char *word, long *length){
+    unsigned long hash = 0;
+    long i = 0;
+    while(word[i] != 0){
+        hash = hash * 31 + (unsigned long)(long)word[i];
+        i = i + 1;
+    }
+    *length = i;
+    return (long)hash;
+}
+
+int main(){
+    long words = 2000000, size = 0, seed = 42;
+    char *buffer = malloc(words * 12);
+    for(long i = 0; i < words; i++){
+        seed = (seed * 1103515245 + 12345) & 2147483647;
+        long length = 3 + ((seed >> 16) & 7);
+        for(long letter = 0; letter < length; letter++){
+            seed = (seed * 1103515245 + 12345) & 2147483647;
+            buffer[size] = (char)(97 + ((seed >> 16) & 15));
+            size = size + 1;
+        }
+        buffer[size] = 0;
+        size = size + 1;
+    }
+
+    unsigned long checksum = 0;
+    for(int round = 0; round < 10; round++){
+        long offset = 0, length = 0;
+        while(offset < size){
+            checksum = checksum * 31 + (unsigned long)hash_word(&buffer[offset], &length);
+            offset = offset + length + 1;
+        }
+    }
+    printf("%ld\n", (long)checksum);
+    return 0;
+}
@@ -0,0 +1,31 @@
+// Reference for matmul.txt
+#include <stdio.h>
+#include <stdlib.h>
+
+void multiply(double *a, double *b, double *c, long n){
+    for(long i = 0; i < n; i++){
+        for(long j = 0; j < n; j++){
+            double sum = 0.0;
+            for(long k = 0; k < n; k++)
+                sum = sum + a[i * n + k] * b[k * n + j];
+            c[i * n + j] = sum;
+        }
+    }
+}
+
+int main(){
+    long n = 600;
+    double *a = malloc(n * n * 8);
+    double *b = malloc(n * n * 8);
+    double *c = malloc(n * n * 8);
+    for(long i = 0; i < n * n; i++){
+        a[i] = (double)(i % 7) - 3.0;
+        b[i] = (double)(i % 11) * 0.5;
+    }
+    multiply(a, b, c, n);
+    double trace = 0.0;
+    for(long i = 0; i < n; i++)
+        trace = trace + c[i * n + i];
+    printf("%.3f\n", trace);
+    return 0;
+}
@@ -0,0 +1,74 @@
+// Reference for nbody.txt
+#include <stdio.h>
+#include <math.h>
+
+typedef struct body { double x, y, z, vx, vy, vz, mass; } body;
+
+static const body initial[5] = {
+    {0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 39.47841760435743},
+    {4.84143144246472090, -1.16032004402742839, -0.103622044471123109,
+        0.606326392995832, 2.81198684491626, -0.02521836165988763, 0.03769367487038949},
+    {8.34336671824457987, 4.12479856412430479, -0.403523417114321381,
+        -1.0107743461787924, 1.8256623712304119, 0.008415761376584154, 0.011286326131968767},
+    {12.8943695621391310, -15.1111514016986312, -0.223307578892655734,
+        1.0827910064415354, 0.8687130181696082, -0.010832637401363636, 0.0017237240570597112},
+    {15.3796971148509165, -25.9193146099879641, 0.179258772950371181,
+        0.979090732243898, 0.5946989986476762, -0.034755955504078104, 0.0020336868699246304}
+};
+
+void advance(body *bodies, long count, double dt){
+    for(long i = 0; i < count; i++){
+        for(long j = i + 1; j < count; j++){
+            double dx = bodies[i].x - bodies[j].x;
+            double dy = bodies[i].y - bodies[j].y;
+            double dz = bodies[i].z - bodies[j].z;
+            double distance2 = dx * dx + dy * dy + dz * dz;
+            double magnitude = dt / (distance2 * sqrt(distance2));
+            bodies[i].vx = bodies[i].vx - dx * bodies[j].mass * magnitude;
+            bodies[i].vy = bodies[i].vy - dy * bodies[j].mass * magnitude;
+            bodies[i].vz = bodies[i].vz - dz * bodies[j].mass * magnitude;
+            bodies[j].vx = bodies[j].vx + dx * bodies[i].mass * magnitude;
+            bodies[j].vy = bodies[j].vy + dy * bodies[i].mass * magnitude;
+            bodies[j].vz = bodies[j].vz + dz * bodies[i].mass * magnitude;
+        }
+    }
+    for(long i = 0; i < count; i++){
+        bodies[i].x = bodies[i].x + dt * bodies[i].vx;
+        bodies[i].y = bodies[i].y + dt * bodies[i].vy;
+        bodies[i].z = bodies[i].z + dt * bodies[i].vz;
+    }
+}
+
+double energy(body *bodies, long count){
+    double e = 0.0;
+    for(long i = 0; i < count; i++){
+        e = e + 0.5 * bodies[i].mass * (bodies[i].vx * bodies[i].vx + bodies[i].vy * bodies[i].vy + bodies[i].vz * bodies[i].vz);
+        for(long j = i + 1; j < count; j++){
+            double dx = bodies[i].x - bodies[j].x;
+            double dy = bodies[i].y - bodies[j].y;
+            double dz = bodies[i].z - bodies[j].z;
+            e = e - bodies[i].mass * bodies[j].mass / sqrt(dx * dx + dy * dy + dz * dz);
+        }
+    }
+    return e;
+}
+
+int main(){
+    body b[5];
+    for(int i = 0; i < 5; i++) b[i] = initial[i];
+    double px = 0.0, py = 0.0, pz = 0.0;
+    for(int i = 0; i < 5; i++){
+        px = px + b[i].vx * b[i].mass;
+        py = py + b[i].vy * b[i].mass;
+        pz = pz + b[i].vz * b[i].mass;
+    }
+    b[0].vx = 0.0 - px / b[0].mass;
+    b[0].vy = 0.0 - py / b[0].mass;
+    b[0].vz = 0.0 - pz / b[0].mass;
+
+    printf("%.9f\n", energy(b, 5));
+    for(long i = 0; i < 5000000; i++)
+        advance(b, 5, 0.01);
+    printf("%.9f\n", energy(b, 5));
+    return 0;
+}
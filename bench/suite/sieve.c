@@ -0,0 +1,26 @@
+// Reference for sieve.txt
+#include <stdio.h>
+#include <stdlib.h>
+
+long count_primes(char *composite, long limit){
+    long count = 0;
+    for(long i = 0; i < limit; i++)
+        composite[i] = 0;
+    for(long i = 2; i < limit; i++){
+        if(composite[i] == 0){
+            count = count + 1;
+            for(long multiple = i * i; multiple < limit; multiple = multiple + i)
+                composite[multiple] = 1;
+        }
+    }
+    return count;
+}
+
+int main(){
+    long limit = 10000000, total = 0;
+    char *composite = malloc(limit);
+    for(int round = 0; round < 5; round++)
+        total = total + count_primes(composite, limit);
+    printf("%ld\n", total);
+    return 0;
+}
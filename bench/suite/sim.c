@@ -0,0 +1,52 @@
+// Reference for sim.txt
+#include <stdio.h>
+#include <stdlib.h>
+
+typedef struct vec { double x, y; } vec;
+typedef struct particle { vec position, velocity; long bounces; } particle;
+
+vec add(vec a, vec b){
+    vec result = {a.x + b.x, a.y + b.y};
+    return result;
+}
+
+vec scale(vec a, double s){
+    vec result = {a.x * s, a.y * s};
+    return result;
+}
+
+void step(particle *particles, long count, vec gravity, double dt){
+    for(long i = 0; i < count; i++){
+        particle p = particles[i];
+        p.velocity = add(p.velocity, scale(gravity, dt));
+        p.position = add(p.position, scale(p.velocity, dt));
+        if(p.position.y < 0.0){
+            p.position.y = 0.0 - p.position.y;
+            p.velocity.y = 0.0 - p.velocity.y * 0.9;
+            p.bounces = p.bounces + 1;
+        }
+        if(p.position.x < 0.0 || p.position.x > 100.0)
+            p.velocity.x = 0.0 - p.velocity.x;
+        particles[i] = p;
+    }
+}
+
+int main(){
+    long count = 20000;
+    particle *particles = malloc(count * sizeof(particle));
+    for(long i = 0; i < count; i++){
+        particle p = {{(double)(i % 100), (double)(i % 37) + 1.0}, {(double)(i % 13) - 6.0, 0.0}, 0};
+        particles[i] = p;
+    }
+    vec gravity = {0.0, -9.81};
+    for(int steps = 0; steps < 1000; steps++)
+        step(particles, count, gravity, 0.001);
+    double sum = 0.0;
+    long bounces = 0;
+    for(long i = 0; i < count; i++){
+        sum = sum + particles[i].position.x + particles[i].position.y;
+        bounces = bounces + particles[i].bounces;
+    }
+    printf("%.6f %ld\n", sum, bounces);
+    return 0;
+}
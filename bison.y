@@ -1,32 +1,60 @@
 %{
 #include <stdio.h>
+#include <string.h>
 #include "flex.l.h"
-int yyerror(char *s) {
-    printf("%s\n", s);
-}
+#include "lexer.h"
+int yyerror(char *s);
+
+// Tokens come from flex or the hand-written lexer, whichever lexer_open() chose
+#define yylex lexer_token
+
+// Create a node at the start of the location of a rule
+#define NODE(kind, loc) ast_create(kind, (loc).first_line, (loc).first_column)
+#define UNARY(kind, left, loc) ast_unary(kind, left, (loc).first_line, (loc).first_column)
+#define BINARY(kind, op, left, right, loc) ast_binary(kind, op, left, right, (loc).first_line, (loc).first_column)
+#define PRIMITIVE(type, loc) ast_primitive(type, (loc).first_line, (loc).first_column)
+#define LOCATE(node, loc) ((node)->line = (loc).first_line, (node)->column = (loc).first_column)
 %}
 
+// Track the source location of every token
+%locations
+
+// Keep the names of tokens, which the token list uses
+%token-table
+
 // Include headers for union structures 
 %code requires {
-    #include "parse.h" 
-    #include "generate.h"  
+    #include "ast.h"
+}
+
+// Helpers for rules that build more than one node
+%code {
+    #define ALLOCATION(type, count, loc) allocation(type, count, (loc).first_line, (loc).first_column)
+
+    // Create a new expression for one value, or for count values
+    // new [N]T is parsed as an array type, so its length becomes the count
+    static ast_node_t *allocation(ast_node_t *type, ast_node_t *count, int line, int column){
+        if(!count && type->kind == AST_TYPE_ARRAY){
+            count = ast_create(AST_INT, type->line, type->column);
+            count->int_value = type->int_value;
+            type = type->left;
+        }
+        return ast_binary(AST_NEW, 0, type, count, line, column);
+    }
 }
 
 // Define all of the types that a rule can match to
 %union {
     char *str;
-    LLVMTypeRef type;
     int64_t int_literal;
+    int_literal_t literal;
     double fp_literal;
-    type_id_list_t type_id_list;
-    value_id_list_t value_id_list;
-    parse_list_t parse_list;
-    arg_def_t arg_def;
-    value_t value;
+    ast_node_t *node;
+    ast_list_t list;
 }
 
 // Define all of the tokens without union types 
-%token FN STRUCT IF ELSE WHILE RETURN BREAK CONTINUE TYPEDEF DECL AS SIZEOF
+%token FN CONST COMPTIME STRUCT PACKED ALIGN REORDER IF ELSE WHILE PARALLEL FOR REDUCE SWITCH REGION POOL NEW DELETE IN CASE DEFAULT RETURN TAIL BREAK CONTINUE TYPEDEF DECL THREADLOCAL AS SIZEOF
 %token L_PAREN R_PAREN L_SQUARE R_SQUARE L_CURLY R_CURLY 
 %token COMMA SEMICOLON ASTERISK ELLIPSES ARROW COLON
 %token ASSIGN ADD SUB DIV MOD 
@@ -36,27 +64,35 @@ int yyerror(char *s) {
 %token LESS LEQ GREATER GEQ EQ NEQ DOT
 
 // Define tokens that also have associated data in the union 
-%token<str> ID
+%token<str> ID BUILTIN
 %token<str> STR_LITERAL
-%token<int_literal> INT_LITERAL
+%token<literal> INT_LITERAL SUFFIX_LITERAL
 %token<fp_literal> FP_LITERAL
 
 // Define rules that have associated data in the union 
 %type<str> label
-%type<type_id_list> type_id_list;
-%type<value_id_list> value_id_list;
-%type<parse_list> type_list;
-%type<parse_list> value_list;
-%type<arg_def> arg_def;
-%type<type> return_type;
-%type<type> type;
-%type<value> expression;
-%type<value> constant;
+%type<list> globals statements field_list value_list initializer_list type_list type_id_list value_id_list type_param_list
+%type<list> cases case_values reductions reduction_list
+%type<node> global function struct struct_attributes typedef global_declaration local_declaration
+%type<node> statement conditional if_statement loop reduction switch case case_value break continue return delete
+%type<node> arg_def param return_type type type_params expression initializer constant allocator
+%type<int_literal> field_align function_qualifiers
 
 // Precedence for if/then/else to avoid parsing conflict 
 %precedence THEN
 %precedence ELSE
 
+// Allocations take the region or pool after them, even inside delete
+%precedence HEAP
+%precedence IN
+
+// A type name followed by < takes type arguments, even after as or new
+%precedence TYPE_NAME
+
+// A literal count of new is read as the length of an array type
+%precedence LENGTH
+%precedence R_SQUARE
+
 // Define precedence/associativity for every operator 
 // The lower a directive is, the more precedence it has 
 %right ASSIGN
@@ -66,7 +102,7 @@ int yyerror(char *s) {
 %left ADD SUB
 %left ASTERISK DIV MOD
 %left BIT_AND BIT_OR BIT_XOR LSHIFT RSHIFT
-%precedence BIT_NOT BOOL_NOT NEG REF DEREF
+%precedence BIT_NOT BOOL_NOT NEG REF DEREF COMPTIME
 %precedence DOT 
 %precedence AS
 %precedence L_SQUARE
@@ -76,11 +112,11 @@ int yyerror(char *s) {
 %start program
 %%
 program: 
-    globals;
+    globals {ast_program = $1.head;};
 
 globals:
-    %empty
-    | globals global;
+    %empty {initialize_ast_list(&$$);}
+    | globals global {$$ = $1; insert_ast_list(&$$, $2);};
 
 global: 
     function
@@ -89,200 +125,543 @@ global:
     | typedef SEMICOLON;
 
 global_declaration:
-    DECL type value_id_list {create_declaration($2, &$3, false);};
+    DECL type value_id_list {
+        $$ = NODE(AST_DECLARATION, @$);
+        $$->left = $2;
+        $$->list = $3.head;
+    }
+    | DECL THREADLOCAL type value_id_list {
+        $$ = NODE(AST_DECLARATION, @$);
+        $$->flags = AST_THREADLOCAL;
+        $$->left = $3;
+        $$->list = $4.head;
+    }
+    | DECL CONST type value_id_list {
+        $$ = NODE(AST_DECLARATION, @$);
+        $$->flags = AST_CONST;
+        $$->left = $3;
+        $$->list = $4.head;
+    };
 
 function: 
-    FN ID L_PAREN arg_def R_PAREN return_type SEMICOLON  {
-        create_function($2, $6 , &$4, false);
+    function_qualifiers FN ID type_params L_PAREN arg_def R_PAREN return_type SEMICOLON  {
+        $$ = $6;
+        LOCATE($$, @$);
+        $$->name = $3;
+        $$->left = $8;
+        $$->right = $4;
+        $$->flags |= $1;
+        if($4) $$->flags |= AST_GENERIC;
     }
-    | FN ID L_PAREN arg_def R_PAREN return_type {
-        create_function($2, $6, &$4,  true);
-    } statement { 
-        finish_function();
+    | function_qualifiers FN ID type_params L_PAREN arg_def R_PAREN return_type statement { 
+        $$ = $6;
+        LOCATE($$, @$);
+        $$->name = $3;
+        $$->left = $8;
+        $$->right = $4;
+        $$->body = $9;
+        $$->flags |= $1;
+        if($4) $$->flags |= AST_GENERIC;
     } 
     ;
 
+function_qualifiers:
+    %empty {$$ = 0;}
+    | CONST {$$ = AST_CONST;};
+
+type_params:
+    %empty {$$ = NULL;}
+    | LESS type_param_list GREATER {$$ = $2.head;};
+
+type_param_list:
+    ID {
+        ast_node_t *param = NODE(AST_TYPE_NAME, @$);
+        param->name = $1;
+        initialize_ast_list(&$$);
+        insert_ast_list(&$$, param);
+    }
+    | type_param_list COMMA ID {
+        ast_node_t *param = NODE(AST_TYPE_NAME, @3);
+        param->name = $3;
+        $$ = $1;
+        insert_ast_list(&$$, param);
+    };
+
 return_type:
-    %empty {$$ = LLVMVoidType();}
+    %empty {$$ = NULL;}
     | ARROW type {$$ = $2;};
 
 struct:
     STRUCT ID SEMICOLON  {
-        create_struct($2, NULL);
+        $$ = NODE(AST_STRUCT, @$);
+        $$->name = $2;
+        $$->flags = AST_OPAQUE;
     }
-    | STRUCT ID L_CURLY type_id_list R_CURLY {
-        create_struct($2, &$4);
+    | STRUCT ID type_params struct_attributes L_CURLY field_list R_CURLY {
+        $$ = $4;
+        LOCATE($$, @$);
+        $$->name = $2;
+        $$->right = $3;
+        $$->list = $6.head;
+        if($3) $$->flags |= AST_GENERIC;
     };
 
+struct_attributes:
+    %empty {$$ = NODE(AST_STRUCT, @$);}
+    | struct_attributes PACKED {$$ = $1; $$->flags |= AST_PACKED;}
+    | struct_attributes REORDER {$$ = $1; $$->flags |= AST_REORDER;}
+    | struct_attributes ALIGN L_PAREN INT_LITERAL R_PAREN {$$ = $1; $$->int_value = $4.value;};
+
+field_list:
+    type ID field_align {
+        ast_node_t *field = NODE(AST_FIELD, @$);
+        field->name = $2;
+        field->left = $1;
+        field->int_value = $3;
+        initialize_ast_list(&$$);
+        insert_ast_list(&$$, field);
+    }
+    | field_list COMMA type ID field_align {
+        ast_node_t *field = NODE(AST_FIELD, @3);
+        field->name = $4;
+        field->left = $3;
+        field->int_value = $5;
+        $$ = $1;
+        insert_ast_list(&$$, field);
+    };
+
+field_align:
+    %empty {$$ = 0;}
+    | ALIGN L_PAREN INT_LITERAL R_PAREN {$$ = $3.value;};
+
 typedef:
-    TYPEDEF ID type {create_type($2, $3);};
+    TYPEDEF ID type {
+        $$ = NODE(AST_TYPEDEF, @$);
+        $$->name = $2;
+        $$->left = $3;
+    };
 
 statements:
-    %empty
-    | statements statement;
+    %empty {initialize_ast_list(&$$);}
+    | statements statement {$$ = $1; insert_ast_list(&$$, $2);};
 
 statement:
-    L_CURLY {create_scope();} statements R_CURLY {finish_scope();}
+    L_CURLY statements R_CURLY {
+        $$ = NODE(AST_BLOCK, @$);
+        $$->list = $2.head;
+    }
     | local_declaration SEMICOLON;
     | conditional;
     | loop;
+    | switch;
     | break SEMICOLON;
     | continue SEMICOLON;
     | return SEMICOLON;
+    | delete SEMICOLON;
     | expression SEMICOLON;
 
 local_declaration: 
-    DECL type value_id_list {create_declaration($2, &$3, true);};
+    DECL type value_id_list {
+        $$ = NODE(AST_DECLARATION, @$);
+        $$->flags = AST_LOCAL;
+        $$->left = $2;
+        $$->list = $3.head;
+    };
 
 conditional:
-    if_statement  ELSE {create_else();} statement {finish_if();} 
-    | if_statement %prec THEN {finish_if();} ;
+    if_statement ELSE statement {$$ = $1; $$->right = $3;}
+    | if_statement %prec THEN;
 
 if_statement:
-    IF L_PAREN expression R_PAREN {create_if($3);} statement;
+    IF L_PAREN expression R_PAREN statement {
+        $$ = NODE(AST_IF, @$);
+        $$->left = $3;
+        $$->body = $5;
+    };
 
 loop:
-    label WHILE {create_while($1);} L_PAREN expression R_PAREN {create_while_condition($5); } statement {finish_while();};
+    label WHILE L_PAREN expression R_PAREN statement {
+        $$ = NODE(AST_WHILE, @2);
+        $$->name = $1;
+        $$->left = $4;
+        $$->body = $6;
+    }
+    | label FOR L_PAREN ID IN expression R_PAREN statement {
+        $$ = NODE(AST_FOR, @2);
+        $$->name = $1;
+        $$->list = NODE(AST_DECLARATOR, @4);
+        $$->list->name = $4;
+        $$->left = $6;
+        $$->body = $8;
+    }
+    | PARALLEL FOR L_PAREN ID ASSIGN expression COMMA expression R_PAREN reductions statement {
+        $$ = NODE(AST_PARALLEL, @$);
+        $$->name = $4;
+        $$->left = $6;
+        $$->right = $8;
+        $$->list = $10.head;
+        $$->body = $11;
+    };
+
+reductions:
+    %empty {initialize_ast_list(&$$);}
+    | REDUCE L_PAREN reduction_list R_PAREN {$$ = $3;};
+
+reduction_list:
+    reduction {
+        initialize_ast_list(&$$);
+        insert_ast_list(&$$, $1);
+    }
+    | reduction_list COMMA reduction {
+        $$ = $1;
+        insert_ast_list(&$$, $3);
+    };
+
+// Each reduction is an operator followed by the variable it combines into
+reduction:
+    ADD ID {$$ = NODE(AST_CAPTURE, @2); $$->name = $2; $$->op = OP_ADD; $$->flags = AST_REDUCE;}
+    | ASTERISK ID {$$ = NODE(AST_CAPTURE, @2); $$->name = $2; $$->op = OP_MUL; $$->flags = AST_REDUCE;}
+    | BIT_AND ID {$$ = NODE(AST_CAPTURE, @2); $$->name = $2; $$->op = OP_BIT_AND; $$->flags = AST_REDUCE;}
+    | BIT_OR ID {$$ = NODE(AST_CAPTURE, @2); $$->name = $2; $$->op = OP_BIT_OR; $$->flags = AST_REDUCE;}
+    | BIT_XOR ID {$$ = NODE(AST_CAPTURE, @2); $$->name = $2; $$->op = OP_BIT_XOR; $$->flags = AST_REDUCE;}
+    | ID ID {
+        $$ = NODE(AST_CAPTURE, @2);
+        $$->name = $2;
+        $$->flags = AST_REDUCE;
+        if(strcmp($1, "min") == 0){
+            $$->op = OP_MIN;
+        } else if(strcmp($1, "max") == 0){
+            $$->op = OP_MAX;
+        } else{
+            yyerror("Expected a reduction operator");
+            YYERROR;
+        }
+    };
+
+switch:
+    label SWITCH L_PAREN expression R_PAREN L_CURLY cases R_CURLY {
+        $$ = NODE(AST_SWITCH, @2);
+        $$->name = $1;
+        $$->left = $4;
+        $$->list = $7.head;
+    };
+
+cases:
+    %empty {initialize_ast_list(&$$);}
+    | cases case {$$ = $1; insert_ast_list(&$$, $2);};
+
+case:
+    CASE case_values COLON statements {
+        $$ = NODE(AST_CASE, @$);
+        $$->list = $2.head;
+        $$->body = $4.head;
+    }
+    | DEFAULT COLON statements {
+        $$ = NODE(AST_CASE, @$);
+        $$->flags = AST_DEFAULT;
+        $$->body = $3.head;
+    };
+
+case_values:
+    case_value {
+        initialize_ast_list(&$$);
+        insert_ast_list(&$$, $1);
+    }
+    | case_values COMMA case_value {
+        $$ = $1;
+        insert_ast_list(&$$, $3);
+    };
+
+case_value:
+    expression
+    | expression ELLIPSES expression {$$ = BINARY(AST_RANGE, 0, $1, $3, @$);};
 
 label:
     %empty {$$ = NULL;}
     | ID COLON {$$ = $1;};
 
 break:
-    BREAK ID {create_break_continue($2, true);}
-    | BREAK {create_break_continue(NULL, true);};
+    BREAK ID {$$ = NODE(AST_BREAK, @$); $$->name = $2;}
+    | BREAK {$$ = NODE(AST_BREAK, @$);};
 
 continue:
-    CONTINUE ID {create_break_continue($2, false);}
-    | CONTINUE {create_break_continue(NULL, false);};
+    CONTINUE ID {$$ = NODE(AST_CONTINUE, @$); $$->name = $2;}
+    | CONTINUE {$$ = NODE(AST_CONTINUE, @$);};
 
 return:
-    RETURN expression {create_return($2);} |
-    RETURN {
-        value_t dummy;
-        dummy.address = NULL;
-        dummy.value = NULL;
-        create_return(dummy);
+    RETURN expression {$$ = UNARY(AST_RETURN, $2, @$);}
+    | RETURN {$$ = NODE(AST_RETURN, @$);}
+    | TAIL RETURN expression {
+        $$ = UNARY(AST_RETURN, $3, @$);
+        $$->flags |= AST_TAIL;
+    };
+
+delete:
+    DELETE expression allocator {
+        $$ = UNARY(AST_DELETE, $2, @$);
+        $$->body = $3;
+    };
+
+// Regions and pools are named after in, and the heap is used without one
+allocator:
+    %empty {$$ = NULL;}
+    | IN ID {
+        $$ = NODE(AST_IDENTIFIER, @2);
+        $$->name = $2;
     };
 
 expression:
-    expression ASSIGN expression {$$ = create_assignment($1, $3);}
-    | expression ADD expression {$$ = create_math_binop($1, $3, OP_ADD);}
-    | expression SUB expression { $$ = create_math_binop($1, $3, OP_SUB);}
-    | expression ASTERISK expression {$$ = create_math_binop($1, $3, OP_MUL);}
-    | expression DIV expression {$$ = create_math_binop($1, $3, OP_DIV);}
-    | expression MOD expression {$$ = create_math_binop($1, $3, OP_MOD);}
-    | SUB  expression %prec NEG { $$ = create_math_negate($2);}
-    | expression BIT_AND expression {$$ = create_bitwise_binop($1, $3, OP_BIT_AND);}
-    | expression BIT_OR expression {$$ = create_bitwise_binop($1, $3, OP_BIT_OR);}
-    | expression BIT_XOR expression {$$ = create_bitwise_binop($1, $3, OP_BIT_XOR);}
-    | BIT_NOT expression  {$$ = create_bitwise_not($2);}
-    | expression LSHIFT expression {$$ = create_bitwise_binop($1, $3, OP_LSHIFT);}
-    | expression RSHIFT expression {$$ = create_bitwise_binop($1, $3, OP_RSHIFT);}
-    | expression BOOL_AND expression {$$ = create_boolean_binop($1, $3, OP_BOOL_AND);}
-    | expression BOOL_OR expression {$$ = create_boolean_binop($1, $3, OP_BOOL_OR);}
-    | BOOL_NOT expression { $$ = create_boolean_not($2);}
-    | expression LESS expression {$$ = create_comparison($1, $3, OP_LESS);}
-    | expression LEQ expression {$$ = create_comparison($1, $3, OP_LEQ);}
-    | expression GREATER expression {$$ = create_comparison($1, $3, OP_GREATER);}
-    | expression GEQ expression {$$ = create_comparison($1, $3, OP_GEQ);}
-    | expression EQ expression {$$ = create_comparison($1, $3, OP_EQ);}
-    | expression NEQ expression {$$ = create_comparison($1, $3, OP_NEQ);}
-    | SIZEOF L_PAREN type R_PAREN  {$$ = create_sizeof($3);}
-    | expression L_PAREN value_list R_PAREN{ $$ = create_call($1, $3); } 
-    | expression L_PAREN  R_PAREN{ 
-        parse_list_t temp; 
-        initialize_parse_list(&temp);
-        $$ = create_call($1, temp); 
+    expression ASSIGN expression {$$ = BINARY(AST_ASSIGN, 0, $1, $3, @$);}
+    | expression ADD expression {$$ = BINARY(AST_MATH, OP_ADD, $1, $3, @$);}
+    | expression SUB expression {$$ = BINARY(AST_MATH, OP_SUB, $1, $3, @$);}
+    | expression ASTERISK expression {$$ = BINARY(AST_MATH, OP_MUL, $1, $3, @$);}
+    | expression DIV expression {$$ = BINARY(AST_MATH, OP_DIV, $1, $3, @$);}
+    | expression MOD expression {$$ = BINARY(AST_MATH, OP_MOD, $1, $3, @$);}
+    | SUB  expression %prec NEG {$$ = UNARY(AST_NEGATE, $2, @$);}
+    | expression BIT_AND expression {$$ = BINARY(AST_BITWISE, OP_BIT_AND, $1, $3, @$);}
+    | expression BIT_OR expression {$$ = BINARY(AST_BITWISE, OP_BIT_OR, $1, $3, @$);}
+    | expression BIT_XOR expression {$$ = BINARY(AST_BITWISE, OP_BIT_XOR, $1, $3, @$);}
+    | BIT_NOT expression  {$$ = UNARY(AST_BIT_NOT, $2, @$);}
+    | COMPTIME expression {$$ = UNARY(AST_COMPTIME, $2, @$);}
+    | expression LSHIFT expression {$$ = BINARY(AST_BITWISE, OP_LSHIFT, $1, $3, @$);}
+    | expression RSHIFT expression {$$ = BINARY(AST_BITWISE, OP_RSHIFT, $1, $3, @$);}
+    | expression BOOL_AND expression {$$ = BINARY(AST_BOOLEAN, OP_BOOL_AND, $1, $3, @$);}
+    | expression BOOL_OR expression {$$ = BINARY(AST_BOOLEAN, OP_BOOL_OR, $1, $3, @$);}
+    | BOOL_NOT expression {$$ = UNARY(AST_BOOL_NOT, $2, @$);}
+    | expression LESS expression {$$ = BINARY(AST_COMPARISON, OP_LESS, $1, $3, @$);}
+    | expression LEQ expression {$$ = BINARY(AST_COMPARISON, OP_LEQ, $1, $3, @$);}
+    | expression GREATER expression {$$ = BINARY(AST_COMPARISON, OP_GREATER, $1, $3, @$);}
+    | expression GEQ expression {$$ = BINARY(AST_COMPARISON, OP_GEQ, $1, $3, @$);}
+    | expression EQ expression {$$ = BINARY(AST_COMPARISON, OP_EQ, $1, $3, @$);}
+    | expression NEQ expression {$$ = BINARY(AST_COMPARISON, OP_NEQ, $1, $3, @$);}
+    | SIZEOF L_PAREN type R_PAREN  {$$ = UNARY(AST_SIZEOF, $3, @$);}
+    | NEW type %prec HEAP {$$ = ALLOCATION($2, NULL, @$);}
+    | NEW type IN ID {
+        $$ = ALLOCATION($2, NULL, @$);
+        $$->body = NODE(AST_IDENTIFIER, @4);
+        $$->body->name = $4;
+    }
+    | NEW L_SQUARE expression R_SQUARE type %prec HEAP {$$ = ALLOCATION($5, $3, @$);}
+    | NEW L_SQUARE expression R_SQUARE type IN ID {
+        $$ = ALLOCATION($5, $3, @$);
+        $$->body = NODE(AST_IDENTIFIER, @7);
+        $$->body->name = $7;
+    }
+    | expression L_PAREN value_list R_PAREN {
+        $$ = UNARY(AST_CALL, $1, @$);
+        $$->list = $3.head;
     } 
-    | expression AS type { $$ = cast($1,$3, true);}
-    | expression DOT ID { $$ = create_dot($1,$3);}
-    | expression L_SQUARE expression R_SQUARE { $$ = create_index($1, $3); } 
-    | ASTERISK expression %prec DEREF {$$ = create_deref($2);}
-    | BIT_AND expression %prec REF {$$ = create_ref($2);}
+    | expression L_PAREN  R_PAREN {$$ = UNARY(AST_CALL, $1, @$);} 
+    | BUILTIN L_PAREN value_list R_PAREN {
+        $$ = NODE(AST_BUILTIN, @$);
+        $$->name = $1;
+        $$->list = $3.head;
+    }
+    | BUILTIN L_PAREN R_PAREN {
+        $$ = NODE(AST_BUILTIN, @$);
+        $$->name = $1;
+    }
+    | expression AS type {$$ = BINARY(AST_CAST, 0, $1, $3, @$);}
+    | expression DOT ID {
+        $$ = UNARY(AST_DOT, $1, @$);
+        $$->name = $3;
+    }
+    | expression L_SQUARE expression R_SQUARE {$$ = BINARY(AST_INDEX, 0, $1, $3, @$);} 
+    | expression L_SQUARE expression COLON expression R_SQUARE {
+        $$ = BINARY(AST_SLICE, 0, $1, $3, @$);
+        $$->body = $5;
+    }
+    | expression L_SQUARE expression COLON R_SQUARE {$$ = BINARY(AST_SLICE, 0, $1, $3, @$);}
+    | expression L_SQUARE COLON expression R_SQUARE {
+        $$ = UNARY(AST_SLICE, $1, @$);
+        $$->body = $4;
+    }
+    | expression L_SQUARE COLON R_SQUARE {$$ = UNARY(AST_SLICE, $1, @$);}
+    | ASTERISK expression %prec DEREF {$$ = UNARY(AST_DEREF, $2, @$);}
+    | BIT_AND expression %prec REF {$$ = UNARY(AST_REF, $2, @$);}
     | L_PAREN expression R_PAREN {$$ = $2;}
-    | ID  {$$ = get_identifier($1);}
+    | ID  {
+        $$ = NODE(AST_IDENTIFIER, @$);
+        $$->name = $1;
+    }
     | constant;
 
 constant:
-    INT_LITERAL {$$ = create_int_constant($1);}
-    | FP_LITERAL {$$ = create_fp_constant($1);}
-    | STR_LITERAL {$$ = create_string_constant($1);}
+    INT_LITERAL %prec LENGTH {
+        $$ = NODE(AST_INT, @$);
+        $$->int_value = $1.value;
+        if($1.bits) $$->flags = AST_BITS;
+    }
+    | SUFFIX_LITERAL {
+        $$ = NODE(AST_INT, @$);
+        $$->int_value = $1.value;
+        $$->type = LLVMIntType($1.width);
+        $$->flags = AST_SUFFIX | ($1.bits ? AST_BITS : 0);
+    }
+    | FP_LITERAL {$$ = NODE(AST_FP, @$); $$->fp_value = $1;}
+    | STR_LITERAL {$$ = NODE(AST_STRING, @$); $$->name = $1;}
 
 arg_def:
-    %empty {create_arg_def(&$$, NULL, false);}
-    | ELLIPSES {create_arg_def(&$$, NULL, true);}
-    | type_id_list {create_arg_def(&$$, &$1, false);}
-    | type_id_list COMMA ELLIPSES {create_arg_def(&$$, &$1, true);}
+    %empty {$$ = NODE(AST_FUNCTION, @$);}
+    | ELLIPSES {$$ = NODE(AST_FUNCTION, @$); $$->flags = AST_VARG;}
+    | type_id_list {$$ = NODE(AST_FUNCTION, @$); $$->list = $1.head;}
+    | type_id_list COMMA ELLIPSES {
+        $$ = NODE(AST_FUNCTION, @$);
+        $$->list = $1.head;
+        $$->flags = AST_VARG;
+    }
     ;
 
 type_id_list:
-    type ID { 
-        initialize_type_id_list(&$$);
-        insert_type_id_list(&$$, $1, $2); 
+    param { 
+        initialize_ast_list(&$$);
+        insert_ast_list(&$$, $1);
     }
-    | type_id_list COMMA type ID { 
+    | type_id_list COMMA param { 
         $$ = $1; 
-        insert_type_id_list(&$$, $3, $4); 
+        insert_ast_list(&$$, $3);
+    };
+
+param:
+    type ID {
+        $$ = NODE(AST_PARAM, @$);
+        $$->name = $2;
+        $$->left = $1;
+    }
+    | BIT_AND type ID {
+        // References are passed as pointers, but used like the value they point to
+        $$ = NODE(AST_PARAM, @$);
+        $$->name = $3;
+        $$->left = UNARY(AST_TYPE_POINTER, $2, @2);
+        $$->flags |= AST_BYREF;
     };
 
 type_list:
     type {
-        initialize_parse_list(&$$);
-        insert_parse_list(&$$, $1, PL_TYPE); 
+        initialize_ast_list(&$$);
+        insert_ast_list(&$$, $1);
     }
     | type_list COMMA type {
         $$ = $1;
-        insert_parse_list(&$$, $3, PL_TYPE); 
+        insert_ast_list(&$$, $3);
     };
 
 value_list:
     expression {
-        initialize_parse_list(&$$);
-        insert_parse_list(&$$, $1.value, PL_VALUE); 
+        initialize_ast_list(&$$);
+        insert_ast_list(&$$, $1);
     }
     | value_list COMMA expression {
         $$ = $1;
-        insert_parse_list(&$$, $3.value, PL_VALUE); 
+        insert_ast_list(&$$, $3);
+    };
+
+// Arrays and structures can be initialized with a list of their elements or fields
+initializer:
+    expression
+    | L_CURLY R_CURLY {$$ = NODE(AST_INITIALIZER, @$);}
+    | L_CURLY initializer_list R_CURLY {$$ = NODE(AST_INITIALIZER, @$); $$->list = $2.head;}
+    | L_CURLY initializer_list COMMA R_CURLY {$$ = NODE(AST_INITIALIZER, @$); $$->list = $2.head;};
+
+initializer_list:
+    initializer {
+        initialize_ast_list(&$$);
+        insert_ast_list(&$$, $1);
+    }
+    | initializer_list COMMA initializer {
+        $$ = $1;
+        insert_ast_list(&$$, $3);
     };
 
 value_id_list:
     ID {
-        initialize_value_id_list(&$$);
-        insert_value_id_list(&$$, NULL, $1);
+        ast_node_t *declarator = NODE(AST_DECLARATOR, @$);
+        declarator->name = $1;
+        initialize_ast_list(&$$);
+        insert_ast_list(&$$, declarator);
     }
-    | ID ASSIGN expression {
-        initialize_value_id_list(&$$);
-        insert_value_id_list(&$$, $3.value, $1);
+    | ID ASSIGN initializer {
+        ast_node_t *declarator = NODE(AST_DECLARATOR, @$);
+        declarator->name = $1;
+        declarator->right = $3;
+        initialize_ast_list(&$$);
+        insert_ast_list(&$$, declarator);
     }
     | value_id_list COMMA ID {
+        ast_node_t *declarator = NODE(AST_DECLARATOR, @3);
+        declarator->name = $3;
         $$ = $1;
-        insert_value_id_list(&$$, NULL, $3);
+        insert_ast_list(&$$, declarator);
     } 
-    | value_id_list COMMA ID ASSIGN expression {
+    | value_id_list COMMA ID ASSIGN initializer {
+        ast_node_t *declarator = NODE(AST_DECLARATOR, @3);
+        declarator->name = $3;
+        declarator->right = $5;
         $$ = $1;
-        insert_value_id_list(&$$, $5.value, $3);
+        insert_ast_list(&$$, declarator);
     };
 
 type:
-    ID {$$ = get_type($1, true);}
-    | BOOL      {$$ = LLVMInt1Type();}
-    | I8      {$$ = LLVMInt8Type();}
-    | I16   {$$ = LLVMInt16Type();}
-    | I32   {$$ = LLVMInt32Type();}
-    | I64   {$$ = LLVMInt64Type();}
-    | F32   {$$ = LLVMFloatType();}
-    | F64   {$$ = LLVMDoubleType();}
+    ID %prec TYPE_NAME {$$ = NODE(AST_TYPE_NAME, @$); $$->name = $1;}
+    | ID LESS type_list GREATER {
+        $$ = NODE(AST_TYPE_NAME, @$);
+        $$->name = $1;
+        $$->list = $3.head;
+    }
+    | ID LESS ID LESS type_list RSHIFT {
+        // The >> that closes two type argument lists is a single token
+        ast_node_t *inner = NODE(AST_TYPE_NAME, @3);
+        inner->name = $3;
+        inner->list = $5.head;
+        $$ = NODE(AST_TYPE_NAME, @$);
+        $$->name = $1;
+        $$->list = inner;
+    }
+    | ID LESS type_list COMMA ID LESS type_list RSHIFT {
+        ast_node_t *inner = NODE(AST_TYPE_NAME, @5);
+        inner->name = $5;
+        inner->list = $7.head;
+        $$ = NODE(AST_TYPE_NAME, @$);
+        insert_ast_list(&$3, inner);
+        $$->name = $1;
+        $$->list = $3.head;
+    }
+    | BOOL  {$$ = PRIMITIVE(LLVMInt1Type(), @$);}
+    | I8    {$$ = PRIMITIVE(LLVMInt8Type(), @$);}
+    | I16   {$$ = PRIMITIVE(LLVMInt16Type(), @$);}
+    | I32   {$$ = PRIMITIVE(LLVMInt32Type(), @$);}
+    | I64   {$$ = PRIMITIVE(LLVMInt64Type(), @$);}
+    | F32   {$$ = PRIMITIVE(LLVMFloatType(), @$);}
+    | F64   {$$ = PRIMITIVE(LLVMDoubleType(), @$);}
+    | REGION {$$ = NODE(AST_TYPE_REGION, @$);}
+    | POOL type {$$ = UNARY(AST_TYPE_POOL, $2, @$);}
     | FN L_PAREN R_PAREN return_type {
-        $$ = LLVMPointerType(LLVMFunctionType($4, NULL, 0, false), 0);
+        $$ = UNARY(AST_TYPE_FUNCTION, $4, @$);
     } | FN L_PAREN type_list R_PAREN return_type {
-        $$ = LLVMPointerType(LLVMFunctionType($5, $3.types, $3.length, false), 0);
+        $$ = UNARY(AST_TYPE_FUNCTION, $5, @$);
+        $$->list = $3.head;
     } | FN L_PAREN ELLIPSES R_PAREN return_type {
-        $$ = LLVMPointerType(LLVMFunctionType($5, NULL, 0, true), 0);
+        $$ = UNARY(AST_TYPE_FUNCTION, $5, @$);
+        $$->flags = AST_VARG;
     } | FN L_PAREN type_list COMMA ELLIPSES R_PAREN return_type {
-        $$ = LLVMPointerType(LLVMFunctionType($7, $3.types, $3.length, true), 0);
+        $$ = UNARY(AST_TYPE_FUNCTION, $7, @$);
+        $$->list = $3.head;
+        $$->flags = AST_VARG;
     }
     | L_PAREN type R_PAREN  {$$ = $2;}
-    | ASTERISK type {$$ = LLVMPointerType($2, 0);}
-    | L_SQUARE INT_LITERAL R_SQUARE type { $$ = LLVMArrayType($4, $2); };
-%%
\ No newline at end of file
+    | ASTERISK type {$$ = UNARY(AST_TYPE_POINTER, $2, @$);}
+    | L_SQUARE R_SQUARE type {$$ = UNARY(AST_TYPE_SLICE, $3, @$);}
+    | L_SQUARE INT_LITERAL R_SQUARE type {
+        $$ = UNARY(AST_TYPE_ARRAY, $4, @$);
+        $$->int_value = $2.value;
+    };
+%%
+
+// Report errors with the location of the lookahead token
+int yyerror(char *s) {
+    printf("%d:%d: %s\n", yylloc.first_line, yylloc.first_column, s);
+}
+
+const char* token_name(int token) {
+    return yytname[YYTRANSLATE(token)];
+}
@@ -0,0 +1,345 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "codegen.h"
+#include "generate.h"
+#include "comptime.h"
+
+// Function whose body is being generated
+static ast_node_t *codegen_function = NULL;
+
+// Give the instructions generated next the location of a node
+static void locate(ast_node_t *node){
+    debug_location(node->line, node->column);
+}
+
+// Build the argument definition that create_function() expects
+static void function_args(ast_node_t *node, arg_def_t *args){
+    type_id_list_t list;
+    initialize_type_id_list(&list);
+    for(ast_node_t *param = node->list; param; param = param->next)
+        insert_type_id_list(&list, param->left->type, param->name);
+    create_arg_def(args, &list, node->flags & AST_VARG);
+}
+
+static value_t codegen_expression(ast_node_t *node){
+    value_t left, right, high;
+    value_t args[5];
+    uint32_t count;
+    value_t *values;
+
+    // Sema folded untyped constants, and gave them the type of their context
+    if(node->flags & AST_UNTYPED && node->kind == AST_FP)
+        return create_fp_constant(node->fp_value, node->type);
+    if(node->flags & AST_UNTYPED)
+        return create_int_constant(node->int_value, node->type);
+    switch(node->kind){
+    case AST_ASSIGN:
+        left = codegen_expression(node->left);
+        right = codegen_expression(node->right);
+        locate(node);
+        return create_assignment(left, right);
+    case AST_MATH:
+        left = codegen_expression(node->left);
+        right = codegen_expression(node->right);
+        locate(node);
+        return create_math_binop(left, right, node->op);
+    case AST_BITWISE:
+        left = codegen_expression(node->left);
+        right = codegen_expression(node->right);
+        locate(node);
+        return create_bitwise_binop(left, right, node->op);
+    case AST_BOOLEAN:
+        left = codegen_expression(node->left);
+        right = codegen_expression(node->right);
+        locate(node);
+        return create_boolean_binop(left, right, node->op);
+    case AST_COMPARISON:
+        left = codegen_expression(node->left);
+        right = codegen_expression(node->right);
+        locate(node);
+        return create_comparison(left, right, node->op);
+    case AST_NEGATE:
+        left = codegen_expression(node->left);
+        locate(node);
+        return create_math_negate(left);
+    case AST_BIT_NOT:
+        left = codegen_expression(node->left);
+        locate(node);
+        return create_bitwise_not(left);
+    case AST_BOOL_NOT:
+        left = codegen_expression(node->left);
+        locate(node);
+        return create_boolean_not(left);
+    case AST_REF:
+        left = codegen_expression(node->left);
+        locate(node);
+        return create_ref(left);
+    case AST_DEREF:
+        left = codegen_expression(node->left);
+        locate(node);
+        return create_deref(left);
+    case AST_CALL:
+        // Aggregates stay lvalues so that they can be passed without another copy
+        left = codegen_expression(node->left);
+        values = malloc(sizeof(value_t) * (ast_length(node->list) + 1));
+        count = 0;
+        for(ast_node_t *arg = node->list; arg; arg = arg->next, count++){
+            values[count] = codegen_expression(arg);
+            if(arg->flags & AST_PASS_ADDRESS)
+                values[count] = create_ref(values[count]);
+            else if(LLVMGetTypeKind(arg->type) != LLVMStructTypeKind && LLVMGetTypeKind(arg->type) != LLVMArrayTypeKind)
+                values[count] = rvalue(values[count]);
+        }
+        locate(node);
+        left = create_call(left, values, count);
+        free(values);
+        return left;
+    case AST_BUILTIN:
+        // Builtins take at most five arguments
+        count = 0;
+        for(ast_node_t *arg = node->list; arg; arg = arg->next)
+            args[count++] = codegen_expression(arg);
+        locate(node);
+        return create_builtin(node->int_value, args, count, node->type);
+    case AST_INITIALIZER:
+        // Sema has set the type of every list to the element or field it initializes
+        values = malloc(sizeof(value_t) * (ast_length(node->list) + 1));
+        count = 0;
+        for(ast_node_t *value = node->list; value; value = value->next, count++)
+            values[count] = rvalue(codegen_expression(value));
+        locate(node);
+        left = create_initializer(node->type, values, count);
+        free(values);
+        return left;
+    case AST_CAST:
+        left = codegen_expression(node->left);
+        locate(node);
+        return cast(left, node->type, true);
+    case AST_DOT:
+        left = codegen_expression(node->left);
+        locate(node);
+        return create_dot(left, node->name);
+    case AST_INDEX:
+        left = codegen_expression(node->left);
+        right = codegen_expression(node->right);
+        locate(node);
+        return create_index(left, right, node->flags & AST_IN_BOUNDS);
+    case AST_SLICE:
+        // Both bounds are optional
+        left = codegen_expression(node->left);
+        if(node->right) right = codegen_expression(node->right);
+        if(node->body) high = codegen_expression(node->body);
+        locate(node);
+        return create_slice(left, node->right ? &right : NULL, node->body ? &high : NULL);
+    case AST_SIZEOF:
+        return create_sizeof(node->left->type);
+    case AST_NEW:
+        // The count and the region or pool are optional
+        if(node->right) right = codegen_expression(node->right);
+        if(node->body) left = codegen_expression(node->body);
+        locate(node);
+        return create_new(node->left->type, node->right ? &right : NULL, node->body ? &left : NULL);
+    case AST_IDENTIFIER:
+        // References are stored as pointers
+        if(node->flags & AST_BYREF)
+            return create_deref(get_identifier(node->name));
+        return get_identifier(node->name);
+    case AST_COMPTIME:
+        // A load stands in for the value until it is computed
+        left.address = NULL;
+        left.value = comptime_placeholder(node);
+        return left;
+    case AST_INT:
+        return create_int_constant(node->int_value, node->type);
+    case AST_FP:
+        return create_fp_constant(node->fp_value, node->type);
+    case AST_STRING:
+        locate(node);
+        return create_string_constant(node->name);
+    default:
+        printf("%u:%u: Expected an expression\n", node->line, node->column);
+        exit(0);
+    }
+}
+
+static void codegen_declaration(ast_node_t *node){
+    // Declare one variable at a time so that each is visible to the initializers after it
+    for(ast_node_t *declarator = node->list; declarator; declarator = declarator->next){
+        value_id_list_t list;
+        initialize_value_id_list(&list);
+        LLVMValueRef value = NULL;
+        bool is_comptime = declarator->right && declarator->right->kind == AST_COMPTIME && !(node->flags & AST_LOCAL);
+        if(declarator->right && !is_comptime)
+            value = rvalue(codegen_expression(declarator->right)).value;
+        locate(declarator);
+        insert_value_id_list(&list, value, declarator->name);
+        create_declaration(node->left->type, &list, node->flags & AST_LOCAL, node->flags & AST_THREADLOCAL, node->flags & AST_CONST);
+        if(is_comptime)
+            comptime_global(get_identifier(declarator->name).address, declarator->right);
+        free(list.id_list.ids);
+        free(list.value_list.values);
+    }
+}
+
+static void codegen_statement(ast_node_t *node);
+
+static void codegen_switch(ast_node_t *node){
+    value_t val = codegen_expression(node->left);
+    locate(node);
+    create_switch(val, node->name, node->flags & AST_DEFAULT);
+
+    // Sema has already evaluated the value of every case
+    create_scope();
+    for(ast_node_t *current = node->list; current; current = current->next){
+        locate(current);
+        if(current->flags & AST_DEFAULT)
+            create_default();
+        else
+            create_case();
+        for(ast_node_t *value = current->list; value; value = value->next){
+            if(value->kind == AST_RANGE)
+                add_case_range(value->left->int_value, value->right->int_value);
+            else
+                add_case_range(value->int_value, value->int_value);
+        }
+        for(ast_node_t *statement = current->body; statement; statement = statement->next)
+            codegen_statement(statement);
+    }
+    finish_scope();
+    finish_switch();
+}
+
+static void codegen_parallel(ast_node_t *node){
+    value_t start = codegen_expression(node->left);
+    value_t end = codegen_expression(node->right);
+
+    // Sema has found every variable of the function that the body uses
+    uint32_t count = ast_length(node->list);
+    capture_t *captures = calloc(count ? count : 1, sizeof(capture_t));
+    uint32_t i = 0;
+    for(ast_node_t *capture = node->list; capture; capture = capture->next, i++){
+        captures[i].name = capture->name;
+        captures[i].type = capture->type;
+        captures[i].op = capture->op;
+        captures[i].is_reduction = capture->flags & AST_REDUCE;
+        captures[i].is_byref = capture->flags & AST_BYREF;
+    }
+    locate(node);
+    create_parallel(node->name, start, end, captures, count);
+    codegen_statement(node->body);
+    locate(node);
+    finish_parallel();
+    free(captures);
+}
+
+static void codegen_statement(ast_node_t *node){
+    value_t val, pool;
+    tail_call_t tail;
+    locate(node);
+    if(node->kind != AST_BLOCK)
+        stats_statement();
+    switch(node->kind){
+    case AST_BLOCK:
+        create_scope();
+        for(ast_node_t *statement = node->list; statement; statement = statement->next)
+            codegen_statement(statement);
+        finish_scope();
+        break;
+    case AST_DECLARATION:
+        codegen_declaration(node);
+        break;
+    case AST_IF:
+        val = codegen_expression(node->left);
+        locate(node);
+        create_if(val);
+        codegen_statement(node->body);
+        if(node->right){
+            create_else();
+            codegen_statement(node->right);
+        }
+        finish_if();
+        break;
+    case AST_WHILE:
+        create_while(node->name);
+        val = codegen_expression(node->left);
+        locate(node);
+        create_while_condition(val);
+        codegen_statement(node->body);
+        finish_while();
+        break;
+    case AST_FOR:
+        // The element is declared in a scope around the body
+        create_scope();
+        val = codegen_expression(node->left);
+        locate(node);
+        create_for(node->name, node->list->name, val);
+        codegen_statement(node->body);
+        finish_for();
+        finish_scope();
+        break;
+    case AST_PARALLEL:
+        codegen_parallel(node);
+        break;
+    case AST_SWITCH:
+        codegen_switch(node);
+        break;
+    case AST_BREAK:
+    case AST_CONTINUE:
+        create_break_continue(node->name, node->kind == AST_BREAK);
+        break;
+    case AST_RETURN:
+        val.address = NULL;
+        val.value = NULL;
+        if(node->left){
+            val = codegen_expression(node->left);
+            locate(node);
+        }
+        // Sema has checked that no local escapes to a tail call
+        tail = TAIL_NONE;
+        if(node->flags & AST_TAIL)
+            tail = TAIL_REQUIRED;
+        else if(node->left && node->left->kind == AST_CALL && !(codegen_function->flags & AST_ESCAPES))
+            tail = TAIL_ALLOWED;
+        create_return(val, tail);
+        break;
+    case AST_DELETE:
+        val = codegen_expression(node->left);
+        if(node->body) pool = codegen_expression(node->body);
+        locate(node);
+        create_delete(val, node->body ? &pool : NULL);
+        break;
+    default:
+        codegen_expression(node);
+    }
+}
+
+void codegen_program(ast_node_t *program){
+    arg_def_t args;
+    ast_node_t *node;
+
+    // Declare every function and global before generating any function bodies
+    for(node = program; node; node = node->next){
+        if(node->kind == AST_FUNCTION && !(node->flags & AST_GENERIC)){
+            locate(node);
+            function_args(node, &args);
+            create_function(node->name, LLVMGetReturnType(node->type), &args, false);
+        } else if(node->kind == AST_DECLARATION){
+            codegen_declaration(node);
+        }
+    }
+
+    // Generate the body of each function definition
+    for(node = program; node; node = node->next){
+        if(node->kind != AST_FUNCTION || !node->body || (node->flags & AST_GENERIC)) continue;
+        locate(node);
+        function_args(node, &args);
+        create_function(node->name, LLVMGetReturnType(node->type), &args, true);
+        codegen_function = node;
+        codegen_statement(node->body);
+        finish_function();
+    }
+}
+
+void codegen_comptime(){
+    comptime_finalize(codegen_expression);
+}
@@ -0,0 +1,12 @@
+#ifndef CODEGEN_H
+#define CODEGEN_H
+
+#include "ast.h"
+
+// Generate LLVM IR for a program that has been checked by sema_program()
+void codegen_program(ast_node_t *program);
+
+// Compute the comptime expressions of the program, once every function has been generated
+void codegen_comptime();
+
+#endif
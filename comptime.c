@@ -0,0 +1,272 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <llvm-c/ExecutionEngine.h>
+#include <llvm-c/Support.h>
+#include <llvm-c/Transforms/IPO.h>
+#include "comptime.h"
+
+// Store the state needed to evaluate comptime expressions
+LLVMModuleRef comptime_module = NULL;
+LLVMBuilderRef comptime_builder;
+LLVMTargetDataRef comptime_data;
+uint32_t comptime_seconds;
+uint32_t comptime_megabytes;
+comptime_list_t *comptimes = NULL;
+comptime_list_t *last_comptime = NULL;
+uint32_t comptime_count = 0;
+
+void comptime_initialize(LLVMModuleRef module, LLVMBuilderRef builder, LLVMTargetDataRef target_data, uint32_t seconds, uint32_t megabytes){
+    comptime_module = module;
+    comptime_builder = builder;
+    comptime_data = target_data;
+    comptime_seconds = seconds;
+    comptime_megabytes = megabytes;
+}
+
+// Values are computed in the order they were added, so globals are computed in source order
+static comptime_list_t *add_comptime(ast_node_t *node, LLVMValueRef global){
+    comptime_list_t *comptime = calloc(1, sizeof(comptime_list_t));
+    comptime->node = node;
+    comptime->global = global;
+    comptime->name = strdup(LLVMGetValueName(global));
+    if(last_comptime) last_comptime->next = comptime;
+    else comptimes = comptime;
+    last_comptime = comptime;
+    comptime_count++;
+    return comptime;
+}
+
+LLVMValueRef comptime_placeholder(ast_node_t *node){
+    if(LLVMGetBasicBlockTerminator(LLVMGetInsertBlock(comptime_builder))) return NULL;
+
+    // The value is loaded from a global of its own until it is known
+    char name[32];
+    snprintf(name, sizeof(name), "__comptime.%u.value", comptime_count);
+    LLVMValueRef global = LLVMAddGlobal(comptime_module, node->type, name);
+    LLVMSetInitializer(global, LLVMConstNull(node->type));
+    comptime_list_t *comptime = add_comptime(node, global);
+    comptime->placeholder = LLVMBuildLoad2(comptime_builder, node->type, global, "");
+    return comptime->placeholder;
+}
+
+void comptime_global(LLVMValueRef global, ast_node_t *node){
+    // The global starts as zero, which gives the JIT memory to compute it in
+    LLVMSetInitializer(global, LLVMConstNull(LLVMGlobalGetValueType(global)));
+    add_comptime(node, global);
+}
+
+// Turn the bytes of a value in memory into a constant
+// The JIT runs on the host, which is also the target, so the layout and byte order match
+static LLVMValueRef constant_from_bytes(LLVMTypeRef type, const char* bytes){
+    LLVMTypeKind kind = LLVMGetTypeKind(type);
+    if(kind == LLVMIntegerTypeKind){
+        uint64_t value = 0;
+        memcpy(&value, bytes, (LLVMGetIntTypeWidth(type) + 7) / 8);
+        return LLVMConstInt(type, value, false);
+    } else if(kind == LLVMFloatTypeKind){
+        float value;
+        memcpy(&value, bytes, sizeof(float));
+        return LLVMConstReal(type, value);
+    } else if(kind == LLVMDoubleTypeKind){
+        double value;
+        memcpy(&value, bytes, sizeof(double));
+        return LLVMConstReal(type, value);
+    } else if(kind == LLVMArrayTypeKind){
+        LLVMTypeRef element = LLVMGetElementType(type);
+        uint32_t length = LLVMGetArrayLength(type);
+        uint64_t stride = LLVMABISizeOfType(comptime_data, element);
+        LLVMValueRef *elements = malloc(sizeof(LLVMValueRef) * (length ? length : 1));
+        for(uint32_t i = 0; i<length; i++)
+            elements[i] = constant_from_bytes(element, bytes + i * stride);
+        LLVMValueRef value = LLVMConstArray(element, elements, length);
+        free(elements);
+        return value;
+    } else if(kind == LLVMStructTypeKind){
+        uint32_t count = LLVMCountStructElementTypes(type);
+        LLVMValueRef *elements = malloc(sizeof(LLVMValueRef) * (count ? count : 1));
+        for(uint32_t i = 0; i<count; i++){
+            uint64_t offset = LLVMOffsetOfElement(comptime_data, type, i);
+            elements[i] = constant_from_bytes(LLVMStructGetTypeAtIndex(type, i), bytes + offset);
+        }
+        LLVMValueRef value = LLVMGetStructName(type) ? LLVMConstNamedStruct(type, elements, count)
+            : LLVMConstStruct(elements, count, LLVMIsPackedStruct(type));
+        free(elements);
+        return value;
+    }
+    return LLVMConstNull(type);
+}
+
+// Profiling hooks of -f instrument-functions, and the coverage runtime, do nothing at compile time
+static void ignore_hook(){}
+
+// Drop everything that the comptime functions can't reach
+// Otherwise the JIT would have to find every external function and global of the program
+static void keep_comptime_code(LLVMModuleRef copy){
+    LLVMValueRef ctors = LLVMGetNamedGlobal(copy, "llvm.global_ctors");
+    if(ctors) LLVMDeleteGlobal(ctors);
+    for(LLVMValueRef function = LLVMGetFirstFunction(copy); function; function = LLVMGetNextFunction(function)){
+        if(LLVMGetFirstBasicBlock(function) && strncmp(LLVMGetValueName(function), "__comptime.", 11) != 0)
+            LLVMSetLinkage(function, LLVMInternalLinkage);
+    }
+    // Compile-time code runs on one thread, and the JIT can't place thread-local globals
+    for(LLVMValueRef global = LLVMGetFirstGlobal(copy); global; global = LLVMGetNextGlobal(global)){
+        if(LLVMGetInitializer(global)) LLVMSetLinkage(global, LLVMInternalLinkage);
+        LLVMSetThreadLocal(global, false);
+    }
+    for(comptime_list_t *comptime = comptimes; comptime; comptime = comptime->next)
+        LLVMSetLinkage(LLVMGetNamedGlobal(copy, comptime->name), LLVMExternalLinkage);
+    LLVMPassManagerRef passes = LLVMCreatePassManager();
+    LLVMAddGlobalDCEPass(passes);
+    LLVMRunPassManager(passes, copy);
+    LLVMDisposePassManager(passes);
+}
+
+// Run each thunk in the child process and send back the value it computed
+// The parent knows which one failed from how many values it got
+static void run_comptime(LLVMModuleRef copy, int fd){
+    alarm(comptime_seconds);
+
+    // The memory limit is on top of what the compiler has already mapped
+    unsigned long pages = 0;
+    FILE* statm = fopen("/proc/self/statm", "r");
+    if(statm){
+        if(fscanf(statm, "%lu", &pages) != 1) pages = 0;
+        fclose(statm);
+    }
+    struct rlimit limit;
+    limit.rlim_cur = (rlim_t)pages * sysconf(_SC_PAGESIZE) + ((rlim_t)comptime_megabytes << 20);
+    limit.rlim_max = limit.rlim_cur;
+    setrlimit(RLIMIT_AS, &limit);
+
+    keep_comptime_code(copy);
+    LLVMAddSymbol("__instrument_enter", (void*)ignore_hook);
+    LLVMAddSymbol("__instrument_exit", (void*)ignore_hook);
+    LLVMAddSymbol("__coverage_thread", (void*)ignore_hook);
+    LLVMLinkInMCJIT();
+    struct LLVMMCJITCompilerOptions options;
+    LLVMInitializeMCJITCompilerOptions(&options, sizeof(options));
+    options.OptLevel = 2;
+    LLVMExecutionEngineRef engine;
+    char* error;
+    if(LLVMCreateMCJITCompilerForModule(&engine, copy, &options, sizeof(options), &error)){
+        fprintf(stderr, "%s\n", error);
+        _exit(1);
+    }
+    uint32_t i = 0;
+    for(comptime_list_t *comptime = comptimes; comptime; comptime = comptime->next, i++){
+        char name[32];
+        snprintf(name, sizeof(name), "__comptime.%u", i);
+        void (*thunk)() = (void (*)())LLVMGetFunctionAddress(engine, name);
+        thunk();
+        char* value = (char*)LLVMGetGlobalValueAddress(engine, comptime->name);
+        size_t size = LLVMABISizeOfType(comptime_data, LLVMGlobalGetValueType(comptime->global));
+        while(size > 0){
+            ssize_t written = write(fd, value, size);
+            if(written <= 0) _exit(1);
+            value += written;
+            size -= written;
+        }
+    }
+    _exit(0);
+}
+
+// Run the thunks in a copy of the module, in a child process that can be stopped
+// Returns the value of every comptime expression, one after the other
+static char* evaluate(){
+    size_t total = 0;
+    for(comptime_list_t *comptime = comptimes; comptime; comptime = comptime->next)
+        total += LLVMABISizeOfType(comptime_data, LLVMGlobalGetValueType(comptime->global));
+    char* results = malloc(total ? total : 1);
+    LLVMModuleRef copy = LLVMCloneModule(comptime_module);
+    int fds[2];
+    if(pipe(fds) != 0){
+        printf("Couldn't start compile-time evaluation\n");
+        exit(0);
+    }
+    fflush(stdout);
+    pid_t pid = fork();
+    if(pid == 0){
+        close(fds[0]);
+        run_comptime(copy, fds[1]);
+    }
+    close(fds[1]);
+    size_t received = 0;
+    ssize_t count;
+    while(received < total && (count = read(fds[0], results + received, total - received)) > 0)
+        received += count;
+    close(fds[0]);
+    int status;
+    waitpid(pid, &status, 0);
+    LLVMDisposeModule(copy);
+
+    // Report the expression that didn't finish
+    if(received < total || !WIFEXITED(status) || WEXITSTATUS(status) != 0){
+        comptime_list_t *failed = comptimes;
+        size_t offset = LLVMABISizeOfType(comptime_data, LLVMGlobalGetValueType(failed->global));
+        while(failed->next && offset <= received){
+            failed = failed->next;
+            offset += LLVMABISizeOfType(comptime_data, LLVMGlobalGetValueType(failed->global));
+        }
+        printf("%u:%u: ", failed->node->line, failed->node->column);
+        if(WIFSIGNALED(status) && WTERMSIG(status) == SIGALRM)
+            printf("Compile-time evaluation took more than %u seconds\n", comptime_seconds);
+        else
+            printf("Compile-time evaluation crashed, or needed more than %u MB of memory\n", comptime_megabytes);
+        exit(0);
+    }
+    return results;
+}
+
+void comptime_finalize(comptime_value_fn_t generate_value){
+    if(!comptime_module || !comptimes) return;
+
+    // Generate a function that stores the value of each expression into its global
+    arg_def_t args;
+    create_arg_def(&args, NULL, false);
+    uint32_t i = 0;
+    for(comptime_list_t *comptime = comptimes; comptime; comptime = comptime->next, i++){
+        // The symbol table keeps the name
+        char buffer[32];
+        snprintf(buffer, sizeof(buffer), "__comptime.%u", i);
+        char* name = strdup(buffer);
+        create_function(name, LLVMVoidType(), &args, true);
+        value_t global;
+        global.value = NULL;
+        global.address = comptime->global;
+        create_assignment(global, generate_value(comptime->node->left));
+        finish_function();
+        comptime->thunk = LLVMGetNamedFunction(comptime_module, name);
+    }
+    char* results = evaluate();
+
+    // The thunks are only needed at compile time
+    // Values used inside functions become constants, and computed globals become read-only
+    char* bytes = results;
+    while(comptimes){
+        comptime_list_t *comptime = comptimes;
+        LLVMTypeRef type = LLVMGlobalGetValueType(comptime->global);
+        LLVMValueRef value = constant_from_bytes(type, bytes);
+        bytes += LLVMABISizeOfType(comptime_data, type);
+        LLVMDeleteFunction(comptime->thunk);
+        if(comptime->placeholder){
+            LLVMReplaceAllUsesWith(comptime->placeholder, value);
+            LLVMInstructionEraseFromParent(comptime->placeholder);
+            LLVMDeleteGlobal(comptime->global);
+        } else{
+            LLVMSetInitializer(comptime->global, value);
+            LLVMSetGlobalConstant(comptime->global, true);
+        }
+        comptimes = comptime->next;
+        free(comptime->name);
+        free(comptime);
+    }
+    last_comptime = NULL;
+    comptime_count = 0;
+    comptime_module = NULL;
+    free(results);
+}
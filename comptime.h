@@ -0,0 +1,37 @@
+#ifndef COMPTIME_H
+#define COMPTIME_H
+
+#include <stdint.h>
+#include <llvm-c/Core.h>
+#include <llvm-c/Target.h>
+#include "ast.h"
+#include "generate.h"
+
+// Generate the value of an expression in the current function
+typedef value_t (*comptime_value_fn_t)(ast_node_t *node);
+
+// Store each comptime expression and the global its value is computed into
+typedef struct comptime_list {
+    struct comptime_list *next;
+    ast_node_t *node;
+    LLVMValueRef global;
+    LLVMValueRef placeholder;   // Load that stands in for the value in a function (NULL for global initializers)
+    LLVMValueRef thunk;         // Function that computes the value
+    char* name;                 // Name of the global, which the JIT finds it by
+} comptime_list_t;
+
+// Start collecting comptime expressions in a module
+// Evaluation is stopped after seconds, or when it needs more than megabytes of memory
+void comptime_initialize(LLVMModuleRef module, LLVMBuilderRef builder, LLVMTargetDataRef target_data, uint32_t seconds, uint32_t megabytes);
+
+// Stand in for the value of a comptime expression in the current function
+LLVMValueRef comptime_placeholder(ast_node_t *node);
+
+// Compute the initializer of a global at compile time
+void comptime_global(LLVMValueRef global, ast_node_t *node);
+
+// Run every comptime expression with a JIT in a child process, and replace each one with its value
+// Needs every function that the expressions can call to be generated
+void comptime_finalize(comptime_value_fn_t generate_value);
+
+#endif
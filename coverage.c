@@ -0,0 +1,147 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "coverage.h"
+#include "debug.h"
+#include "generate.h"
+
+// Store the state needed to count blocks
+LLVMModuleRef coverage_module = NULL;
+LLVMBuilderRef coverage_builder;
+char* coverage_file;
+LLVMValueRef counters_placeholder;
+LLVMValueRef totals_placeholder;
+LLVMValueRef thread_ready;
+coverage_list_t *counters = NULL;
+unsigned counter_count = 0;
+
+void coverage_initialize(LLVMModuleRef module, LLVMBuilderRef builder, char* input_file){
+    coverage_module = module;
+    coverage_builder = builder;
+    coverage_file = input_file;
+
+    // The number of counters is only known at the end, so increments use a placeholder
+    counters_placeholder = LLVMAddGlobal(module, LLVMArrayType(LLVMInt64Type(), 0), "__coverage_placeholder");
+    totals_placeholder = LLVMAddGlobal(module, LLVMArrayType(LLVMInt64Type(), 0), "__coverage_totals_placeholder");
+
+    // Whether the current thread has given its counters to the runtime yet
+    thread_ready = LLVMAddGlobal(module, LLVMInt1Type(), "__coverage_thread_ready");
+    LLVMSetLinkage(thread_ready, LLVMPrivateLinkage);
+    LLVMSetThreadLocal(thread_ready, true);
+    LLVMSetInitializer(thread_ready, LLVMConstNull(LLVMInt1Type()));
+}
+
+void coverage_function(){
+    if(!coverage_module) return;
+    LLVMValueRef fn = LLVMGetBasicBlockParent(LLVMGetInsertBlock(coverage_builder));
+    LLVMBasicBlockRef start = LLVMAppendBasicBlock(fn, "");
+    LLVMBasicBlockRef done = LLVMAppendBasicBlock(fn, "");
+    LLVMBuildCondBr(coverage_builder, LLVMBuildLoad2(coverage_builder, LLVMInt1Type(), thread_ready, ""), done, start);
+
+    // The first time a thread runs a function of the module, the runtime learns where its counters are
+    LLVMPositionBuilderAtEnd(coverage_builder, start);
+    LLVMTypeRef i64_ptr = LLVMPointerType(LLVMInt64Type(), 0);
+    LLVMTypeRef params[2] = {i64_ptr, i64_ptr};
+    LLVMValueRef args[2] = {
+        LLVMConstBitCast(counters_placeholder, i64_ptr),
+        LLVMConstBitCast(totals_placeholder, i64_ptr)
+    };
+    LLVMValueRef thread_fn = get_runtime_function("__coverage_thread", LLVMVoidType(), params, 2);
+    LLVMBuildCall2(coverage_builder, LLVMGlobalGetValueType(thread_fn), thread_fn, args, 2, "");
+    LLVMBuildStore(coverage_builder, LLVMConstInt(LLVMInt1Type(), 1, false), thread_ready);
+    LLVMBuildBr(coverage_builder, done);
+    LLVMPositionBuilderAtEnd(coverage_builder, done);
+}
+
+void coverage_counter(coverage_kind_t kind){
+    if(!coverage_module) return;
+
+    // Record where the counter came from
+    coverage_list_t *counter = malloc(sizeof(coverage_list_t));
+    debug_get_location(&counter->line, &counter->column);
+    counter->kind = kind;
+    counter->next = counters;
+    counters = counter;
+
+    LLVMValueRef indices[2] = {
+        LLVMConstInt(LLVMInt64Type(), 0, false),
+        LLVMConstInt(LLVMInt64Type(), counter_count++, false)
+    };
+    LLVMValueRef address = LLVMBuildInBoundsGEP2(coverage_builder, LLVMArrayType(LLVMInt64Type(), 0), counters_placeholder, indices, 2, "");
+
+    // Each thread has its own counters, so a plain add doesn't lose counts
+    LLVMValueRef count = LLVMBuildLoad2(coverage_builder, LLVMInt64Type(), address, "");
+    LLVMBuildStore(coverage_builder, LLVMBuildAdd(coverage_builder, count, LLVMConstInt(LLVMInt64Type(), 1, false), ""), address);
+}
+
+void coverage_finalize(){
+    if(!coverage_module) return;
+    LLVMTypeRef i8_ptr = LLVMPointerType(LLVMInt8Type(), 0);
+    LLVMTypeRef i32 = LLVMInt32Type();
+
+    // Create the real counter arrays and use them instead of the placeholders
+    // The runtime adds the counters of each thread to the totals when the thread exits, and at exit
+    LLVMTypeRef counters_type = LLVMArrayType(LLVMInt64Type(), counter_count);
+    LLVMTypeRef placeholder_type = LLVMPointerType(LLVMArrayType(LLVMInt64Type(), 0), 0);
+    LLVMValueRef counters_global = LLVMAddGlobal(coverage_module, counters_type, "__coverage_counters");
+    LLVMSetLinkage(counters_global, LLVMPrivateLinkage);
+    LLVMSetThreadLocal(counters_global, true);
+    LLVMSetInitializer(counters_global, LLVMConstNull(counters_type));
+    LLVMReplaceAllUsesWith(counters_placeholder, LLVMConstBitCast(counters_global, placeholder_type));
+    LLVMDeleteGlobal(counters_placeholder);
+    LLVMValueRef totals_global = LLVMAddGlobal(coverage_module, counters_type, "__coverage_totals");
+    LLVMSetLinkage(totals_global, LLVMPrivateLinkage);
+    LLVMSetInitializer(totals_global, LLVMConstNull(counters_type));
+    LLVMReplaceAllUsesWith(totals_placeholder, LLVMConstBitCast(totals_global, placeholder_type));
+    LLVMDeleteGlobal(totals_placeholder);
+
+    // Store (line, column, kind) of each counter, in counter order
+    LLVMValueRef *records = malloc(sizeof(LLVMValueRef) * (counter_count * 3 + 1));
+    unsigned index = counter_count;
+    while(counters){
+        coverage_list_t *temp = counters;
+        index--;
+        records[index * 3] = LLVMConstInt(i32, temp->line, false);
+        records[index * 3 + 1] = LLVMConstInt(i32, temp->column, false);
+        records[index * 3 + 2] = LLVMConstInt(i32, temp->kind, false);
+        counters = counters->next;
+        free(temp);
+    }
+    LLVMValueRef records_init = LLVMConstArray(i32, records, counter_count * 3);
+    LLVMValueRef records_global = LLVMAddGlobal(coverage_module, LLVMTypeOf(records_init), "__coverage_records");
+    LLVMSetLinkage(records_global, LLVMPrivateLinkage);
+    LLVMSetGlobalConstant(records_global, true);
+    LLVMSetInitializer(records_global, records_init);
+    free(records);
+
+    LLVMValueRef file_init = LLVMConstString(coverage_file, strlen(coverage_file), false);
+    LLVMValueRef file_global = LLVMAddGlobal(coverage_module, LLVMTypeOf(file_init), "__coverage_file");
+    LLVMSetLinkage(file_global, LLVMPrivateLinkage);
+    LLVMSetGlobalConstant(file_global, true);
+    LLVMSetInitializer(file_global, file_init);
+
+    // Register the counters with the runtime from a module constructor
+    LLVMValueRef init = LLVMAddFunction(coverage_module, "__coverage_init", LLVMFunctionType(LLVMVoidType(), NULL, 0, false));
+    LLVMSetLinkage(init, LLVMInternalLinkage);
+    LLVMBuilderRef init_builder = LLVMCreateBuilder();
+    LLVMPositionBuilderAtEnd(init_builder, LLVMAppendBasicBlock(init, "entry"));
+    LLVMTypeRef params[4] = {LLVMPointerType(LLVMInt64Type(), 0), LLVMPointerType(i32, 0), i32, i8_ptr};
+    LLVMValueRef args[4] = {
+        LLVMConstBitCast(totals_global, params[0]),
+        LLVMConstBitCast(records_global, params[1]),
+        LLVMConstInt(i32, counter_count, false),
+        LLVMConstBitCast(file_global, i8_ptr)
+    };
+    LLVMValueRef register_fn = get_runtime_function("__coverage_register", LLVMVoidType(), params, 4);
+    LLVMBuildCall2(init_builder, LLVMGlobalGetValueType(register_fn), register_fn, args, 4, "");
+    LLVMBuildRetVoid(init_builder);
+    LLVMDisposeBuilder(init_builder);
+
+    LLVMValueRef ctor_values[3] = {LLVMConstInt(i32, 65535, false), init, LLVMConstNull(i8_ptr)};
+    LLVMValueRef ctor = LLVMConstStruct(ctor_values, 3, false);
+    LLVMTypeRef ctor_type = LLVMTypeOf(ctor);
+    LLVMValueRef ctors = LLVMAddGlobal(coverage_module, LLVMArrayType(ctor_type, 1), "llvm.global_ctors");
+    LLVMSetLinkage(ctors, LLVMAppendingLinkage);
+    LLVMSetInitializer(ctors, LLVMConstArray(ctor_type, &ctor, 1));
+    coverage_module = NULL;
+}
@@ -0,0 +1,34 @@
+#ifndef COVERAGE_H
+#define COVERAGE_H
+
+#include <stdbool.h>
+#include <llvm-c/Core.h>
+
+// Kinds of blocks that get a counter
+typedef enum coverage_kind {
+    COV_IF_THEN,
+    COV_IF_ELSE,
+    COV_LOOP_CONDITION,
+    COV_LOOP_BODY
+} coverage_kind_t;
+
+// Store the source location and kind of each counter
+typedef struct coverage_list {
+    struct coverage_list *next;
+    unsigned line;
+    unsigned column;
+    coverage_kind_t kind;
+} coverage_list_t;
+
+// Start/finish counting blocks in a module
+// Coverage functions do nothing unless coverage_initialize() was called
+void coverage_initialize(LLVMModuleRef module, LLVMBuilderRef builder, char* input_file);
+void coverage_finalize();
+
+// Count executions of the block the builder is positioned at
+void coverage_counter(coverage_kind_t kind);
+
+// Give the counters of the current thread to the runtime, if it hasn't yet, at the start of a function
+void coverage_function();
+
+#endif
@@ -0,0 +1,232 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "debug.h"
+#include "generate.h"
+
+// DWARF constants used for debug types
+#define DW_TAG_STRUCTURE_TYPE 0x13
+#define DW_ATE_BOOLEAN 0x02
+#define DW_ATE_FLOAT 0x04
+#define DW_ATE_SIGNED 0x05
+
+// Store the state needed to describe the module
+LLVMDIBuilderRef dibuilder = NULL;
+LLVMBuilderRef debug_builder;
+LLVMTargetDataRef debug_target_data;
+LLVMMetadataRef debug_file;
+LLVMMetadataRef compile_unit;
+debug_scope_t *curr_scope = NULL;
+debug_type_list_t *debug_types = NULL;
+
+// Store the location of the current construct
+unsigned curr_line = 0;
+unsigned curr_column = 0;
+
+void debug_initialize(LLVMModuleRef module, LLVMBuilderRef builder, LLVMTargetDataRef target_data, char* input_file){
+    debug_builder = builder;
+    debug_target_data = target_data;
+    dibuilder = LLVMCreateDIBuilder(module);
+
+    // Describe the source file relative to the working directory
+    char directory[1024];
+    if(!getcwd(directory, sizeof(directory))) directory[0] = 0;
+    debug_file = LLVMDIBuilderCreateFile(dibuilder, input_file, strlen(input_file), directory, strlen(directory));
+    compile_unit = LLVMDIBuilderCreateCompileUnit(dibuilder, LLVMDWARFSourceLanguageC, debug_file, "out", 3,
+        false, "", 0, 0, "", 0, LLVMDWARFEmissionFull, 0, false, false, "", 0, "", 0);
+
+    // Every module with debug info must state which versions it uses
+    LLVMAddModuleFlag(module, LLVMModuleFlagBehaviorWarning, "Debug Info Version", 18,
+        LLVMValueAsMetadata(LLVMConstInt(LLVMInt32Type(), LLVMDebugMetadataVersion(), false)));
+    LLVMAddModuleFlag(module, LLVMModuleFlagBehaviorWarning, "Dwarf Version", 13,
+        LLVMValueAsMetadata(LLVMConstInt(LLVMInt32Type(), 4, false)));
+}
+
+void debug_finalize(){
+    if(!dibuilder) return;
+    LLVMDIBuilderFinalize(dibuilder);
+    LLVMDisposeDIBuilder(dibuilder);
+    dibuilder = NULL;
+    while(debug_types){
+        debug_type_list_t *temp = debug_types;
+        debug_types = debug_types->next;
+        free(temp);
+    }
+}
+
+// Attach the current location to the instruction builder
+// Instructions outside of functions have no scope, so they get no location
+static void apply_location(){
+    if(!curr_scope || !curr_scope->scope){
+        LLVMSetCurrentDebugLocation2(debug_builder, NULL);
+        return;
+    }
+    LLVMMetadataRef location = LLVMDIBuilderCreateDebugLocation(LLVMGetGlobalContext(), curr_line, curr_column, curr_scope->scope, NULL);
+    LLVMSetCurrentDebugLocation2(debug_builder, location);
+}
+
+void debug_location(unsigned line, unsigned column){
+    // The location is tracked even without debug info for other instrumentation
+    curr_line = line;
+    curr_column = column;
+    if(!dibuilder) return;
+    apply_location();
+}
+
+void debug_get_location(unsigned *line, unsigned *column){
+    *line = curr_line;
+    *column = curr_column;
+}
+
+// Create the debug type that describes an LLVM type
+static LLVMMetadataRef debug_type(LLVMTypeRef type){
+    // Check if the type has already been described
+    debug_type_list_t *curr = debug_types;
+    while(curr){
+        if(curr->type == type) return curr->debug_type;
+        curr = curr->next;
+    }
+
+    LLVMMetadataRef result = NULL;
+    LLVMTypeKind kind = LLVMGetTypeKind(type);
+    uint64_t size = kind == LLVMVoidTypeKind || kind == LLVMFunctionTypeKind || !LLVMTypeIsSized(type)
+        ? 0 : LLVMSizeOfTypeInBits(debug_target_data, type);
+    if(kind == LLVMIntegerTypeKind){
+        char name[16];
+        unsigned width = LLVMGetIntTypeWidth(type);
+        if(width == 1) strcpy(name, "bool");
+        else sprintf(name, "i%u", width);
+        result = LLVMDIBuilderCreateBasicType(dibuilder, name, strlen(name), width == 1 ? 8 : width,
+            width == 1 ? DW_ATE_BOOLEAN : DW_ATE_SIGNED, LLVMDIFlagZero);
+    } else if(kind == LLVMFloatTypeKind){
+        result = LLVMDIBuilderCreateBasicType(dibuilder, "f32", 3, 32, DW_ATE_FLOAT, LLVMDIFlagZero);
+    } else if(kind == LLVMDoubleTypeKind){
+        result = LLVMDIBuilderCreateBasicType(dibuilder, "f64", 3, 64, DW_ATE_FLOAT, LLVMDIFlagZero);
+    } else if(kind == LLVMPointerTypeKind){
+        result = LLVMDIBuilderCreatePointerType(dibuilder, debug_type(LLVMGetElementType(type)), size, 0, 0, "", 0);
+    } else if(kind == LLVMArrayTypeKind){
+        LLVMMetadataRef subrange = LLVMDIBuilderGetOrCreateSubrange(dibuilder, 0, LLVMGetArrayLength(type));
+        result = LLVMDIBuilderCreateArrayType(dibuilder, size, type_alignment(type) * 8,
+            debug_type(LLVMGetElementType(type)), &subrange, 1);
+    } else if(kind == LLVMFunctionTypeKind){
+        // The first element of a subroutine type is the return type
+        unsigned count = LLVMCountParamTypes(type);
+        LLVMTypeRef *params = malloc(sizeof(LLVMTypeRef) * (count + 1));
+        LLVMMetadataRef *elements = malloc(sizeof(LLVMMetadataRef) * (count + 1));
+        LLVMGetParamTypes(type, params);
+        elements[0] = debug_type(LLVMGetReturnType(type));
+        for(unsigned i = 0; i<count; i++)
+            elements[i + 1] = debug_type(params[i]);
+        result = LLVMDIBuilderCreateSubroutineType(dibuilder, debug_file, elements, count + 1, LLVMDIFlagZero);
+        free(params);
+        free(elements);
+    } else if(kind == LLVMStructTypeKind){
+        const char* name = LLVMGetStructName(type);
+        agg_list_t *agg = get_struct(type);
+        if(!agg){
+            // Opaque structures only have a name
+            result = LLVMDIBuilderCreateForwardDecl(dibuilder, DW_TAG_STRUCTURE_TYPE, name, strlen(name),
+                debug_file, debug_file, 0, 0, 0, 0, "", 0);
+        } else{
+            // Structures can contain pointers to themselves, so a placeholder is cached first
+            LLVMMetadataRef placeholder = LLVMDIBuilderCreateReplaceableCompositeType(dibuilder, DW_TAG_STRUCTURE_TYPE,
+                name, strlen(name), debug_file, debug_file, 0, 0, size, agg->align * 8, LLVMDIFlagZero, "", 0);
+            debug_type_list_t *entry = malloc(sizeof(debug_type_list_t));
+            entry->type = type;
+            entry->debug_type = placeholder;
+            entry->next = debug_types;
+            debug_types = entry;
+
+            // Describe each of the components at their actual offsets
+            uint32_t length = agg->components.id_list.length;
+            LLVMMetadataRef *members = malloc(sizeof(LLVMMetadataRef) * (length ? length : 1));
+            for(uint32_t i = 0; i<length; i++){
+                LLVMTypeRef field_type = agg->components.type_list.types[i];
+                char* field_name = agg->components.id_list.ids[i];
+                members[i] = LLVMDIBuilderCreateMemberType(dibuilder, placeholder, field_name, strlen(field_name),
+                    debug_file, 0, LLVMSizeOfTypeInBits(debug_target_data, field_type), type_alignment(field_type) * 8,
+                    LLVMOffsetOfElement(debug_target_data, type, agg->indices[i]) * 8, LLVMDIFlagZero, debug_type(field_type));
+            }
+            result = LLVMDIBuilderCreateStructType(dibuilder, debug_file, name, strlen(name), debug_file, 0,
+                size, agg->align * 8, LLVMDIFlagZero, NULL, members, length, 0, NULL, "", 0);
+            LLVMMetadataReplaceAllUsesWith(placeholder, result);
+            entry->debug_type = result;
+            free(members);
+            return result;
+        }
+    }
+
+    // Cache the debug type for later uses
+    debug_type_list_t *entry = malloc(sizeof(debug_type_list_t));
+    entry->type = type;
+    entry->debug_type = result;
+    entry->next = debug_types;
+    debug_types = entry;
+    return result;
+}
+
+void debug_function(LLVMValueRef function, LLVMTypeRef type, char* name){
+    if(!dibuilder) return;
+
+    // The function's own variable scope becomes the subprogram
+    LLVMMetadataRef debug_function_type = debug_type(type);
+    LLVMMetadataRef subprogram = LLVMDIBuilderCreateFunction(dibuilder, debug_file, name, strlen(name), name, strlen(name),
+        debug_file, curr_line, debug_function_type, false, true, curr_line, LLVMDIFlagPrototyped, false);
+    LLVMSetSubprogram(function, subprogram);
+    curr_scope->scope = subprogram;
+    apply_location();
+}
+
+void debug_finish_function(){
+    if(!dibuilder) return;
+    LLVMSetCurrentDebugLocation2(debug_builder, NULL);
+}
+
+void debug_scope_begin(){
+    if(!dibuilder) return;
+
+    // Only scopes inside of a function are lexical blocks
+    debug_scope_t *new_scope = malloc(sizeof(debug_scope_t));
+    new_scope->prev = curr_scope;
+    new_scope->scope = NULL;
+    if(curr_scope && curr_scope->scope)
+        new_scope->scope = LLVMDIBuilderCreateLexicalBlock(dibuilder, curr_scope->scope, debug_file, curr_line, curr_column);
+    curr_scope = new_scope;
+}
+
+void debug_scope_end(){
+    if(!dibuilder) return;
+    debug_scope_t *temp = curr_scope;
+    curr_scope = curr_scope->prev;
+    free(temp);
+    apply_location();
+}
+
+void debug_variable(LLVMValueRef address, LLVMTypeRef type, char* name, unsigned arg_number){
+    if(!dibuilder || !curr_scope || !curr_scope->scope) return;
+    LLVMMetadataRef variable;
+    if(arg_number)
+        variable = LLVMDIBuilderCreateParameterVariable(dibuilder, curr_scope->scope, name, strlen(name), arg_number,
+            debug_file, curr_line, debug_type(type), true, LLVMDIFlagZero);
+    else
+        variable = LLVMDIBuilderCreateAutoVariable(dibuilder, curr_scope->scope, name, strlen(name),
+            debug_file, curr_line, debug_type(type), true, LLVMDIFlagZero, 0);
+
+    // Declare the variable right after its stack allocation
+    LLVMMetadataRef location = LLVMDIBuilderCreateDebugLocation(LLVMGetGlobalContext(), curr_line, curr_column, curr_scope->scope, NULL);
+    LLVMMetadataRef expression = LLVMDIBuilderCreateExpression(dibuilder, NULL, 0);
+    LLVMValueRef next = LLVMGetNextInstruction(address);
+    if(next)
+        LLVMDIBuilderInsertDeclareBefore(dibuilder, address, variable, expression, location, next);
+    else
+        LLVMDIBuilderInsertDeclareAtEnd(dibuilder, address, variable, expression, location, LLVMGetInstructionParent(address));
+}
+
+void debug_global(LLVMValueRef address, LLVMTypeRef type, char* name){
+    if(!dibuilder) return;
+    LLVMMetadataRef expression = LLVMDIBuilderCreateExpression(dibuilder, NULL, 0);
+    LLVMMetadataRef variable = LLVMDIBuilderCreateGlobalVariableExpression(dibuilder, compile_unit, name, strlen(name),
+        name, strlen(name), debug_file, curr_line, debug_type(type), false, expression, NULL, type_alignment(type) * 8);
+    LLVMGlobalSetMetadata(address, LLVMGetMDKindID("dbg", 3), variable);
+}
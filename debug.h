@@ -0,0 +1,44 @@
+#ifndef DEBUG_H
+#define DEBUG_H
+
+#include <stdbool.h>
+#include <llvm-c/Core.h>
+#include <llvm-c/DebugInfo.h>
+#include <llvm-c/Target.h>
+
+// Store each lexical scope that debug information is nested in
+typedef struct debug_scope {
+    struct debug_scope *prev;
+    LLVMMetadataRef scope;
+} debug_scope_t;
+
+// Store the debug type created for each LLVM type
+typedef struct debug_type_list {
+    struct debug_type_list *next;
+    LLVMTypeRef type;
+    LLVMMetadataRef debug_type;
+} debug_type_list_t;
+
+// Create/finalize the compile unit for the source file
+// Debug functions do nothing unless debug_initialize() was called
+void debug_initialize(LLVMModuleRef module, LLVMBuilderRef builder, LLVMTargetDataRef target_data, char* input_file);
+void debug_finalize();
+
+// Set/get the source location of the instructions being generated
+void debug_location(unsigned line, unsigned column);
+void debug_get_location(unsigned *line, unsigned *column);
+
+// Create/finish the subprogram of a function definition
+// The type is the source type of the function
+void debug_function(LLVMValueRef function, LLVMTypeRef type, char* name);
+void debug_finish_function();
+
+// Create/end a lexical block for each variable scope
+void debug_scope_begin();
+void debug_scope_end();
+
+// Describe a local variable, parameter (arg_number > 0) or global variable
+void debug_variable(LLVMValueRef address, LLVMTypeRef type, char* name, unsigned arg_number);
+void debug_global(LLVMValueRef address, LLVMTypeRef type, char* name);
+
+#endif
@@ -1,25 +1,113 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <inttypes.h>
 #include <string.h>
+#include <math.h>
+#include <llvm-c/Transforms/PassManagerBuilder.h>
 #include "generate.h"
+#include "sema.h"
+#include "codegen.h"
+#include "comptime.h"
 #include "bison.tab.h"
 #include "flex.l.h"
+#include "lexer.h"
 
 // Store the LLVM module and builder
 LLVMBuilderRef builder;
 LLVMModuleRef module;
 
+// Store the target that code is generated for
+LLVMTargetMachineRef target_machine = NULL;
+LLVMTargetDataRef target_data;
+char* target_triple;
+options_t *options;
+
+// Number of buckets in the structure hash table
+#define STRUCT_BUCKETS 256
+#define STRUCT_BUCKET(type) ((((uintptr_t)(type)) >> 4) & (STRUCT_BUCKETS - 1))
+
+// Number of buckets in the string literal hash table
+#define STRING_BUCKETS 256
+
 // Store various aspects of state needed by the code generator
 cond_stack_t *curr_cond = NULL;
 loop_stack_t *curr_loop = NULL;
+parallel_stack_t *curr_parallel = NULL;
+allocator_stack_t *curr_allocator = NULL;
 type_list_t *types = NULL;
-agg_list_t *structs = NULL;
+pool_list_t *pools = NULL;
+slice_list_t *slices = NULL;
+LLVMTypeRef region_type = NULL;
+agg_list_t *structs[STRUCT_BUCKETS];
+string_list_t *strings[STRING_BUCKETS];
 table_t *symbol_table = NULL;
+abi_function_t *current_abi = NULL;
+LLVMValueRef last_call = NULL;
 
 // Check whether the current block of code has been terminated
 #define FINISHED (LLVMGetInsertBlock(builder) && LLVMGetBasicBlockTerminator(LLVMGetInsertBlock(builder)))
 
-void create_struct(char* name, type_id_list_t *list){
+agg_list_t *get_struct(LLVMTypeRef type){
+    agg_list_t *current = structs[STRUCT_BUCKET(type)];
+    while(current){
+        if(current->type == type) return current;
+        current = current->next;
+    }
+    return NULL;
+}
+
+uint32_t type_alignment(LLVMTypeRef type){
+    // Structs can be aligned beyond what LLVM knows about
+    LLVMTypeKind kind = LLVMGetTypeKind(type);
+    if(kind == LLVMStructTypeKind){
+        agg_list_t *agg = get_struct(type);
+        if(agg) return agg->align;
+    } else if(kind == LLVMArrayTypeKind){
+        return type_alignment(LLVMGetElementType(type));
+    }
+    return LLVMABIAlignmentOfType(target_data, type);
+}
+
+// Give a stack or global variable the alignment its type requires
+static void set_variable_alignment(LLVMValueRef address, LLVMTypeRef type){
+    uint32_t align = type_alignment(type);
+    if(align != LLVMABIAlignmentOfType(target_data, type))
+        LLVMSetAlignment(address, align);
+}
+
+// Print the offset, size and padding of every field of a struct
+static void dump_layout(char* name, agg_list_t *agg, uint32_t *aligns){
+    uint32_t length = agg->components.id_list.length;
+    uint64_t size = LLVMABISizeOfType(target_data, agg->type);
+    uint64_t offset = 0, padding = 0;
+    printf("struct %s: size %" PRIu64 ", align %u%s\n", name, size, agg->align, agg->packed ? ", packed" : "");
+
+    // Fields are printed in memory order, which differs from source order when reordered
+    for(uint32_t index = 0; index < LLVMCountStructElementTypes(agg->type); index++){
+        for(uint32_t i = 0; i<length; i++){
+            if(agg->indices[i] != index) continue;
+            LLVMTypeRef field_type = agg->components.type_list.types[i];
+            uint64_t field_offset = LLVMOffsetOfElement(target_data, agg->type, index);
+            if(field_offset > offset){
+                printf("    [%" PRIu64 " bytes padding]\n", field_offset - offset);
+                padding += field_offset - offset;
+            }
+            char* type_name = LLVMPrintTypeToString(field_type);
+            printf("    %4" PRIu64 ": %s %s (size %" PRIu64 ", align %u)\n", field_offset,
+                LLVMGetTypeKind(field_type) == LLVMStructTypeKind ? LLVMGetStructName(field_type) : type_name,
+                agg->components.id_list.ids[i], (uint64_t)LLVMABISizeOfType(target_data, field_type), aligns[i]);
+            LLVMDisposeMessage(type_name);
+            offset = field_offset + LLVMABISizeOfType(target_data, field_type);
+        }
+    }
+    if(size > offset){
+        printf("    [%" PRIu64 " bytes tail padding]\n", size - offset);
+        padding += size - offset;
+    }
+    printf("    total padding: %" PRIu64 " bytes\n", padding);
+}
+
+void create_struct(char* name, struct_def_t *def){
     // Check if the type has already been defined
     LLVMTypeRef type = LLVMGetTypeByName(module, name);
     if(type ){
@@ -31,15 +119,93 @@ void create_struct(char* name, type_id_list_t *list){
         type = LLVMStructCreateNamed(LLVMGetGlobalContext(), name);
         create_type(name, type);
     }
-    if(list){ 
-        // Create the struct using the specified information
-        LLVMStructSetBody(type, list->type_list.types, list->type_list.length, true);
-        agg_list_t *struct_type = malloc(sizeof(agg_list_t));
-        struct_type->next = structs;
-        struct_type->type = type;
-        struct_type->components = *list;
-        structs = struct_type;
+    if(!def) return;
+
+    uint32_t length = def->fields.type_list.length;
+    LLVMTypeRef *field_types = def->fields.type_list.types;
+    agg_list_t *struct_type = malloc(sizeof(agg_list_t));
+    struct_type->type = type;
+    struct_type->components = def->fields;
+    struct_type->indices = malloc(sizeof(uint32_t) * (length ? length : 1));
+    struct_type->packed = def->packed;
+
+    // Find the alignment of each field
+    // Packed structs only align fields with an explicit align(N)
+    bool explicit_layout = def->align != 0;
+    uint32_t *aligns = malloc(sizeof(uint32_t) * (length ? length : 1));
+    uint32_t *order = malloc(sizeof(uint32_t) * (length ? length : 1));
+    if(def->align & (def->align - 1)){
+        printf("Alignment must be a power of two\n");
+        exit(0);
     }
+    for(uint32_t i = 0; i<length; i++){
+        uint32_t natural = type_alignment(field_types[i]);
+        uint32_t requested = def->field_aligns[i];
+        if(requested & (requested - 1)){
+            printf("Alignment must be a power of two\n");
+            exit(0);
+        }
+        aligns[i] = def->packed ? 1 : natural;
+        if(requested > aligns[i]) aligns[i] = requested;
+        if(requested || natural != LLVMABIAlignmentOfType(target_data, field_types[i]))
+            explicit_layout = true;
+        order[i] = i;
+    }
+
+    // Reorder fields by decreasing alignment to minimize padding (stable insertion sort)
+    if((def->reorder || options->reorder_fields) && !def->packed){
+        for(uint32_t i = 1; i<length; i++){
+            uint32_t current = order[i];
+            uint32_t j = i;
+            while(j > 0 && aligns[order[j-1]] < aligns[current]){
+                order[j] = order[j-1];
+                j--;
+            }
+            order[j] = current;
+        }
+    }
+
+    // Lay out the fields, inserting explicit padding when LLVM can't compute the layout itself
+    LLVMTypeRef *elements = malloc(sizeof(LLVMTypeRef) * (2 * length + 1));
+    uint32_t count = 0;
+    uint64_t offset = 0;
+    uint32_t struct_align = def->packed ? 1 : 0;
+    for(uint32_t k = 0; k<length; k++){
+        uint32_t i = order[k];
+        if(explicit_layout){
+            uint64_t aligned = (offset + aligns[i] - 1) / aligns[i] * aligns[i];
+            if(aligned > offset)
+                elements[count++] = LLVMArrayType(LLVMInt8Type(), aligned - offset);
+            offset = aligned + LLVMABISizeOfType(target_data, field_types[i]);
+        }
+        if(aligns[i] > struct_align) struct_align = aligns[i];
+        struct_type->indices[i] = count;
+        elements[count++] = field_types[i];
+    }
+    if(def->align > struct_align) struct_align = def->align;
+    if(struct_align == 0) struct_align = 1;
+    if(explicit_layout){
+        uint64_t size = (offset + struct_align - 1) / struct_align * struct_align;
+        if(size > offset)
+            elements[count++] = LLVMArrayType(LLVMInt8Type(), size - offset);
+    }
+
+    // Create the struct using the computed layout
+    // Structures are naturally aligned like C unless they are packed
+    LLVMStructSetBody(type, elements, count, def->packed || explicit_layout);
+    struct_type->align = struct_align;
+    initialize_index_map(&struct_type->fields, length);
+    for(uint32_t i = 0; i<length; i++)
+        insert_index_map(&struct_type->fields, def->fields.id_list.ids[i], i);
+    struct_type->next = structs[STRUCT_BUCKET(type)];
+    structs[STRUCT_BUCKET(type)] = struct_type;
+    if(options->dump_layout)
+        dump_layout(name, struct_type, aligns);
+
+    free(elements);
+    free(order);
+    free(aligns);
+    free(def->field_aligns);
 }
 
 void create_type(char* name, LLVMTypeRef type){
@@ -77,10 +243,170 @@ LLVMTypeRef get_type(char* name, bool error){
     return NULL;
 }
 
+LLVMTypeRef get_region_type(){
+    // Regions match region_t of the runtime: the list of chunks, and the free space in the newest one
+    if(!region_type){
+        LLVMTypeRef i8_ptr = LLVMPointerType(LLVMInt8Type(), 0);
+        LLVMTypeRef fields[3] = {i8_ptr, i8_ptr, i8_ptr};
+        region_type = LLVMStructCreateNamed(LLVMGetGlobalContext(), "region");
+        LLVMStructSetBody(region_type, fields, 3, false);
+    }
+    return region_type;
+}
+
+LLVMTypeRef get_pool_type(LLVMTypeRef element){
+    for(pool_list_t *current = pools; current; current = current->next){
+        if(current->element == element) return current->type;
+    }
+
+    // Pools match pool_t of the runtime: the free list, the chunks and the size and alignment of items
+    // Every element type gets its own type so that pools of different types can't be mixed up
+    LLVMTypeRef i8_ptr = LLVMPointerType(LLVMInt8Type(), 0);
+    LLVMTypeRef fields[6] = {i8_ptr, i8_ptr, i8_ptr, i8_ptr, LLVMInt64Type(), LLVMInt64Type()};
+    pool_list_t *pool = malloc(sizeof(pool_list_t));
+    pool->element = element;
+    pool->type = LLVMStructCreateNamed(LLVMGetGlobalContext(), "pool");
+    LLVMStructSetBody(pool->type, fields, 6, false);
+    pool->next = pools;
+    pools = pool;
+    return pool->type;
+}
+
+LLVMTypeRef get_pool_element(LLVMTypeRef type){
+    for(pool_list_t *current = pools; current; current = current->next){
+        if(current->type == type) return current->element;
+    }
+    return NULL;
+}
+
+LLVMTypeRef get_slice_type(LLVMTypeRef element){
+    for(slice_list_t *current = slices; current; current = current->next){
+        if(current->element == element) return current->type;
+    }
+
+    // Slices are a pointer to the first element and the number of elements
+    // They are registered like a struct, so that ptr and len can be dotted and assigned
+    LLVMTypeRef fields[2] = {LLVMPointerType(element, 0), LLVMInt64Type()};
+    slice_list_t *slice = malloc(sizeof(slice_list_t));
+    slice->element = element;
+    slice->type = LLVMStructCreateNamed(LLVMGetGlobalContext(), "slice");
+    LLVMStructSetBody(slice->type, fields, 2, false);
+    slice->next = slices;
+    slices = slice;
+
+    agg_list_t *agg = malloc(sizeof(agg_list_t));
+    agg->type = slice->type;
+    initialize_type_id_list(&agg->components);
+    insert_type_id_list(&agg->components, fields[0], "ptr");
+    insert_type_id_list(&agg->components, fields[1], "len");
+    agg->indices = malloc(sizeof(uint32_t) * 2);
+    agg->indices[0] = 0;
+    agg->indices[1] = 1;
+    agg->align = LLVMABIAlignmentOfType(target_data, slice->type);
+    agg->packed = false;
+    initialize_index_map(&agg->fields, 2);
+    insert_index_map(&agg->fields, "ptr", 0);
+    insert_index_map(&agg->fields, "len", 1);
+    agg->next = structs[STRUCT_BUCKET(slice->type)];
+    structs[STRUCT_BUCKET(slice->type)] = agg;
+    return slice->type;
+}
+
+LLVMTypeRef get_slice_element(LLVMTypeRef type){
+    for(slice_list_t *current = slices; current; current = current->next){
+        if(current->type == type) return current->element;
+    }
+    return NULL;
+}
+
+bool is_allocator(LLVMTypeRef type){
+    return (region_type && type == region_type) || get_pool_element(type);
+}
+
+LLVMValueRef get_runtime_function(char* name, LLVMTypeRef return_type, LLVMTypeRef *params, unsigned count){
+    // Declare the runtime function the first time it is used
+    LLVMValueRef fn = LLVMGetNamedFunction(module, name);
+    if(!fn)
+        fn = LLVMAddFunction(module, name, LLVMFunctionType(return_type, params, count, false));
+    return fn;
+}
+
+// Call the profiling runtime on entry to the current function
+static void instrument_enter(LLVMValueRef fn, char* name){
+    LLVMTypeRef params[2] = {LLVMPointerType(LLVMInt8Type(), 0), LLVMPointerType(LLVMInt8Type(), 0)};
+    LLVMValueRef hook = get_runtime_function("__instrument_enter", LLVMVoidType(), params, 2);
+    LLVMValueRef args[2] = {
+        LLVMBuildBitCast(builder, fn, params[0], ""),
+        LLVMBuildGlobalStringPtr(builder, name, "")
+    };
+    LLVMBuildCall2(builder, LLVMGlobalGetValueType(hook), hook, args, 2, "");
+}
+
+// Call the profiling runtime right before the current function returns
+static void instrument_exit(){
+    if(!options->instrument_functions) return;
+    LLVMValueRef fn = LLVMGetBasicBlockParent(LLVMGetInsertBlock(builder));
+    LLVMTypeRef param = LLVMPointerType(LLVMInt8Type(), 0);
+    LLVMValueRef hook = get_runtime_function("__instrument_exit", LLVMVoidType(), &param, 1);
+    LLVMValueRef arg = LLVMBuildBitCast(builder, fn, param, "");
+    LLVMBuildCall2(builder, LLVMGlobalGetValueType(hook), hook, &arg, 1, "");
+}
+
+// Allocate a temporary in the entry block so that loops don't grow the stack
+static LLVMValueRef create_entry_alloca(LLVMTypeRef type){
+    LLVMBasicBlockRef current = LLVMGetInsertBlock(builder);
+    LLVMBasicBlockRef entry = LLVMGetFirstBasicBlock(LLVMGetBasicBlockParent(current));
+    LLVMValueRef terminator = LLVMGetBasicBlockTerminator(entry);
+    if(terminator)
+        LLVMPositionBuilderBefore(builder, terminator);
+    else
+        LLVMPositionBuilderAtEnd(builder, entry);
+    LLVMValueRef address = LLVMBuildAlloca(builder, type, "");
+    set_variable_alignment(address, type);
+    LLVMPositionBuilderAtEnd(builder, current);
+    return address;
+}
+
+// Load or store a register piece of a coerced value in memory of its source type
+// The pieces never extend past the end of the source type
+static LLVMValueRef coerced_piece(LLVMValueRef address, abi_arg_t *arg, uint32_t i, LLVMValueRef store){
+    LLVMValueRef pointer = LLVMBuildBitCast(builder, address, LLVMPointerType(arg->coerced, 0), "");
+    LLVMValueRef piece = LLVMBuildStructGEP2(builder, arg->coerced, pointer, i, "");
+    LLVMTypeRef piece_type = LLVMStructGetTypeAtIndex(arg->coerced, i);
+    LLVMValueRef access = store ? LLVMBuildStore(builder, store, piece) : LLVMBuildLoad2(builder, piece_type, piece, "");
+
+    // The source type may be less aligned than the pieces
+    uint32_t align = type_alignment(arg->type);
+    if(align > LLVMABIAlignmentOfType(target_data, piece_type))
+        align = LLVMABIAlignmentOfType(target_data, piece_type);
+    LLVMSetAlignment(access, align);
+    return access;
+}
+
+// Split a value into the register pieces of its coerced type
+static uint32_t split_coerced(value_t val, abi_arg_t *arg, LLVMValueRef *pieces){
+    LLVMValueRef address = val.address;
+    if(val.value || LLVMTypeOf(address) != LLVMPointerType(arg->type, 0)){
+        address = create_entry_alloca(arg->type);
+        LLVMBuildStore(builder, cast(val, arg->type, false).value, address);
+    }
+    uint32_t count = LLVMCountStructElementTypes(arg->coerced);
+    for(uint32_t i = 0; i<count; i++)
+        pieces[i] = coerced_piece(address, arg, i, NULL);
+    return count;
+}
+
+// Join register pieces back into memory of the source type
+static void join_coerced(LLVMValueRef address, abi_arg_t *arg, LLVMValueRef *pieces){
+    for(uint32_t i = 0; i<LLVMCountStructElementTypes(arg->coerced); i++)
+        coerced_piece(address, arg, i, pieces[i]);
+}
 
 void create_function(char* name, LLVMTypeRef return_type, arg_def_t *args, bool is_definition){
-    // Create a type for the new function
-    LLVMTypeRef type = LLVMFunctionType(return_type, args->list.type_list.types, args->list.type_list.length, args->varg);
+    // Create a type for the new function, and lower it for the C ABI
+    LLVMTypeRef source_type = LLVMFunctionType(return_type, args->list.type_list.types, args->list.type_list.length, args->varg);
+    abi_function_t *abi = abi_function(source_type);
+    LLVMTypeRef type = abi->lowered;
     value_t fn;
     fn.address = NULL;
 
@@ -105,7 +431,15 @@ void create_function(char* name, LLVMTypeRef return_type, arg_def_t *args, bool
     else {
         fn.value = LLVMAddFunction(module, name, type);
         LLVMSetFunctionCallConv(fn.value, LLVMCCallConv);
-        insert_value(symbol_table, name, fn);
+        abi_attributes(fn.value, &abi->ret, true, false);
+        for(uint32_t i = 0; i<args->list.type_list.length; i++)
+            abi_attributes(fn.value, &abi->args[i], false, false);
+
+        // The rest of the program sees the function with its source type
+        value_t symbol = fn;
+        if(abi->is_lowered)
+            symbol.value = LLVMConstBitCast(fn.value, LLVMPointerType(source_type, 0));
+        insert_value(symbol_table, name, symbol);
     }
 
     // If it is a defintiion, extra instructions must be generated
@@ -114,15 +448,36 @@ void create_function(char* name, LLVMTypeRef return_type, arg_def_t *args, bool
         create_scope();
         entry = LLVMAppendBasicBlock(fn.value, "entry");
         LLVMPositionBuilderAtEnd(builder, entry);
+        debug_function(fn.value, source_type, name);
+        current_abi = abi;
 
         // Define each of the arguments in the function's scope
+        // Arguments passed in memory already have a copy that belongs to this function
         for(int i = 0; i<args->list.type_list.length; i++){
+            abi_arg_t *lowering = &abi->args[i];
             value_t arg;
             arg.value = NULL;
-            arg.address = LLVMBuildAlloca(builder, args->list.type_list.types[i], "");
-            LLVMBuildStore(builder, LLVMGetParam(fn.value, i), arg.address);
+            if(lowering->kind == ABI_MEMORY){
+                arg.address = LLVMGetParam(fn.value, lowering->first);
+            } else{
+                arg.address = LLVMBuildAlloca(builder, args->list.type_list.types[i], "");
+                set_variable_alignment(arg.address, args->list.type_list.types[i]);
+            }
+            if(lowering->kind == ABI_DIRECT){
+                LLVMBuildStore(builder, LLVMGetParam(fn.value, lowering->first), arg.address);
+            } else if(lowering->kind == ABI_COERCE){
+                LLVMValueRef pieces[2] = {
+                    LLVMGetParam(fn.value, lowering->first),
+                    LLVMCountStructElementTypes(lowering->coerced) > 1 ? LLVMGetParam(fn.value, lowering->first + 1) : NULL
+                };
+                join_coerced(arg.address, lowering, pieces);
+            }
+            debug_variable(arg.address, args->list.type_list.types[i], args->list.id_list.ids[i], i + 1);
             insert_value(symbol_table, args->list.id_list.ids[i], arg);
         }
+        if(options->instrument_functions)
+            instrument_enter(fn.value, name);
+        coverage_function();
     }
 }
 
@@ -135,14 +490,72 @@ void finish_function(){
     LLVMValueRef fn = LLVMGetBasicBlockParent(block);
     LLVMTypeRef fn_type = LLVMGetElementType(LLVMTypeOf(fn));
     if(LLVMGetReturnType(fn_type) == LLVMVoidType() && !FINISHED){
+        instrument_exit();
         LLVMBuildRetVoid(builder);
     }
 
     // Reset the Instruction Builder
+    debug_finish_function();
     LLVMClearInsertionPosition(builder);
 }
 
-void create_declaration(LLVMTypeRef type, value_id_list_t *list, bool is_local){
+// Get the empty value of a region or pool
+// Pools also store the size of their items, which must be able to hold a pointer in the free list
+static LLVMValueRef empty_allocator(LLVMTypeRef type){
+    LLVMTypeRef element = get_pool_element(type);
+    if(!element) return LLVMConstNull(type);
+    uint64_t align = type_alignment(element);
+    uint64_t size = LLVMABISizeOfType(target_data, element);
+    if(align < 8) align = 8;
+    if(size < 8) size = 8;
+    size = (size + align - 1) / align * align;
+    LLVMValueRef fields[6];
+    for(uint32_t i = 0; i<4; i++)
+        fields[i] = LLVMConstNull(LLVMPointerType(LLVMInt8Type(), 0));
+    fields[4] = LLVMConstInt(LLVMInt64Type(), size, false);
+    fields[5] = LLVMConstInt(LLVMInt64Type(), align, false);
+    return LLVMConstNamedStruct(type, fields, 6);
+}
+
+// Free the regions and pools declared after the given one, newest first
+// The runtime leaves them empty, so they can be used again the next time their scope runs
+static void release_allocators(allocator_stack_t *last){
+    if(FINISHED) return;
+    LLVMTypeRef param = LLVMPointerType(LLVMInt8Type(), 0);
+    for(allocator_stack_t *current = curr_allocator; current != last; current = current->prev){
+        LLVMValueRef fn = get_runtime_function(current->is_pool ? "__pool_destroy" : "__region_free", LLVMVoidType(), &param, 1);
+        LLVMValueRef arg = LLVMBuildBitCast(builder, current->address, param, "");
+        LLVMBuildCall2(builder, LLVMGlobalGetValueType(fn), fn, &arg, 1, "");
+    }
+}
+
+// Store the initial value of a local
+// Constant arrays and structures are copied from read-only data instead of being stored element by element
+static void store_initial(LLVMValueRef address, LLVMValueRef value, LLVMTypeRef type){
+    LLVMTypeKind kind = LLVMGetTypeKind(type);
+    if((kind != LLVMArrayTypeKind && kind != LLVMStructTypeKind) || !LLVMIsConstant(value)){
+        LLVMBuildStore(builder, LLVMBuildTruncOrBitCast(builder, value, type, ""), address);
+        return;
+    }
+    LLVMValueRef size = LLVMConstInt(LLVMInt64Type(), LLVMABISizeOfType(target_data, type), false);
+    uint32_t align = type_alignment(type);
+    if(LLVMIsNull(value)){
+        LLVMBuildMemSet(builder, address, LLVMConstInt(LLVMInt8Type(), 0, false), size, align);
+        return;
+    }
+    // Like the x86-64 ABI does for arrays, copies of 16 bytes or more get a 16 byte aligned source
+    // Otherwise the copy becomes rep movs instead of vector moves
+    LLVMValueRef data = LLVMAddGlobal(module, type, ".init");
+    LLVMSetInitializer(data, value);
+    LLVMSetGlobalConstant(data, true);
+    LLVMSetLinkage(data, LLVMPrivateLinkage);
+    LLVMSetUnnamedAddress(data, LLVMGlobalUnnamedAddr);
+    uint32_t data_align = LLVMABISizeOfType(target_data, type) >= 16 && align < 16 ? 16 : align;
+    LLVMSetAlignment(data, data_align);
+    LLVMBuildMemCpy(builder, address, align, data, data_align, size);
+}
+
+void create_declaration(LLVMTypeRef type, value_id_list_t *list, bool is_local, bool is_thread_local, bool is_constant){
     // Global and local declarations are different
     if(is_local){
         // Check if the current block is finished
@@ -172,14 +585,27 @@ void create_declaration(LLVMTypeRef type, value_id_list_t *list, bool is_local){
             value_t var;
             var.value = NULL;
             var.address = LLVMBuildAlloca(builder, type, "");
+            set_variable_alignment(var.address, type);
+            debug_variable(var.address, type, list->id_list.ids[i], 0);
             insert_value(symbol_table, list->id_list.ids[i], var);
 
+            // Regions and pools start empty in the entry block, because their scope might not run
+            if(is_allocator(type)){
+                LLVMBuildStore(builder, empty_allocator(type), var.address);
+                allocator_stack_t *allocator = malloc(sizeof(allocator_stack_t));
+                allocator->address = var.address;
+                allocator->is_pool = get_pool_element(type) != NULL;
+                allocator->scope = symbol_table;
+                allocator->prev = curr_allocator;
+                curr_allocator = allocator;
+            }
+
             // If the declaration has an "=" initializer, move back and create a store
             if(list->value_list.values[i]){
                 current_value.value = list->value_list.values[i];
                 casted_value = cast(current_value, type, false);
                 LLVMPositionBuilderAtEnd(builder, current);
-                LLVMBuildStore(builder, LLVMBuildTruncOrBitCast(builder, casted_value.value, type, ""), var.address);
+                store_initial(var.address, casted_value.value, type);
             }
         }
     
@@ -195,11 +621,21 @@ void create_declaration(LLVMTypeRef type, value_id_list_t *list, bool is_local){
             value_t var;
             var.value = NULL;
             var.address = LLVMAddGlobal(module, type, list->id_list.ids[i]);
+            set_variable_alignment(var.address, type);
+            LLVMSetThreadLocal(var.address, is_thread_local);
+            debug_global(var.address, type, list->id_list.ids[i]);
             current_value.value = list->value_list.values[i];
 
             // Globals must be initialized instead of stored 
+            // Constant globals can be merged with identical ones, since their address isn't used to tell them apart
             if(current_value.value)
                 LLVMSetInitializer(var.address, cast(current_value, type, false).value);
+            else
+                LLVMSetInitializer(var.address, LLVMConstNull(type));
+            if(is_constant){
+                LLVMSetGlobalConstant(var.address, true);
+                LLVMSetUnnamedAddress(var.address, LLVMGlobalUnnamedAddr);
+            }
             insert_value(symbol_table, list->id_list.ids[i], var);
         }
     }
@@ -207,13 +643,26 @@ void create_declaration(LLVMTypeRef type, value_id_list_t *list, bool is_local){
 void create_scope(){
     // Create a new symbol table using the previous one
     symbol_table = create_table(symbol_table);
+    debug_scope_begin();
 }
 
 void finish_scope(){
+    // Free the regions and pools declared in this scope
+    allocator_stack_t *last = curr_allocator;
+    while(last && last->scope == symbol_table)
+        last = last->prev;
+    release_allocators(last);
+    while(curr_allocator != last){
+        allocator_stack_t *temp = curr_allocator;
+        curr_allocator = curr_allocator->prev;
+        free(temp);
+    }
+
     // Destroy the old symbol table and revert to the previous one
     table_t *prev = symbol_table->nexttable;
     destroy_table(symbol_table);
     symbol_table = prev;
+    debug_scope_end();
 }
 
 void create_if(value_t condition){
@@ -229,10 +678,12 @@ void create_if(value_t condition){
     if(!FINISHED){
         new_cond->if_branch = LLVMAppendBasicBlock(fn, "");
         new_cond->else_branch = LLVMAppendBasicBlock(fn, "");
+        condition = rvalue(condition);
         if(LLVMTypeOf(condition.value) != LLVMInt1Type())
             condition = truthy(condition);
         LLVMBuildCondBr(builder, condition.value, curr_cond->if_branch, curr_cond->else_branch);
         LLVMPositionBuilderAtEnd(builder, curr_cond->if_branch);
+        coverage_counter(COV_IF_THEN);
     }
 }
 
@@ -253,6 +704,7 @@ void create_else(){
 
     // Move the instruction builder to the else branch
     LLVMPositionBuilderAtEnd(builder, prev_else);
+    coverage_counter(COV_IF_ELSE);
 }
 
 void finish_if(){
@@ -281,6 +733,7 @@ void create_while(char* label){
     loop_stack_t *new_loop = calloc(1, sizeof(loop_stack_t));
     new_loop->prev = curr_loop;
     new_loop->label = label;
+    new_loop->allocators = curr_allocator;
     curr_loop = new_loop;
 
     // Make sure that the block has not terminated
@@ -290,6 +743,7 @@ void create_while(char* label){
         new_loop->end = LLVMAppendBasicBlock(fn, "");
         LLVMBuildBr(builder, curr_loop->condition);
         LLVMPositionBuilderAtEnd(builder, curr_loop->condition);
+        coverage_counter(COV_LOOP_CONDITION);
         
     }
 }
@@ -299,12 +753,14 @@ void create_while_condition(value_t condition){
     if(FINISHED) return;
 
     // Get a truthy value for the condition
+    condition = rvalue(condition);
     if(LLVMTypeOf(condition.value) != LLVMInt1Type())
         condition = truthy(condition);
 
     // Build the conditional jmp and move to the loop's body
     LLVMBuildCondBr(builder, condition.value, curr_loop->body, curr_loop->end);
     LLVMPositionBuilderAtEnd(builder, curr_loop->body);
+    coverage_counter(COV_LOOP_BODY);
 }
 
 void finish_while(){
@@ -319,50 +775,463 @@ void finish_while(){
     // Remove the loop from the stack
     loop_stack_t *temp = curr_loop;
     curr_loop = curr_loop->prev;
-    if(temp->label) free(temp->label);
     free(temp);
 }
 
-void create_break_continue(char* label, bool is_break){
-    if(FINISHED) {
-        if(label) free(label);
-        return;
+void create_for(char* label, char* name, value_t sequence){
+    LLVMValueRef fn = LLVMGetBasicBlockParent(LLVMGetInsertBlock(builder));
+    LLVMTypeRef i64 = LLVMInt64Type();
+
+    // Create a new loop struct
+    loop_stack_t *new_loop = calloc(1, sizeof(loop_stack_t));
+    new_loop->prev = curr_loop;
+    new_loop->label = label;
+    new_loop->allocators = curr_allocator;
+    curr_loop = new_loop;
+    if(FINISHED) return;
+
+    // Find the first element and the length, which only slices have to load
+    LLVMTypeRef type = value_type(sequence);
+    LLVMValueRef first, length;
+    if(LLVMGetTypeKind(type) == LLVMArrayTypeKind){
+        LLVMValueRef indices[2] = {LLVMConstInt(i64, 0, false), LLVMConstInt(i64, 0, false)};
+        first = LLVMBuildInBoundsGEP2(builder, type, sequence.address, indices, 2, "");
+        length = LLVMConstInt(i64, LLVMGetArrayLength(type), false);
+    } else{
+        sequence = rvalue(sequence);
+        first = LLVMBuildExtractValue(builder, sequence.value, 0, "");
+        length = LLVMBuildExtractValue(builder, sequence.value, 1, "");
     }
 
-    if(!label) LLVMBuildBr(builder, is_break ? curr_loop->end : curr_loop->condition);
-    else {
-        loop_stack_t *current = curr_loop;
-        while(current){
-            if(current->label && strcmp(current->label, label) == 0){
-                LLVMBuildBr(builder, is_break ? current->end : current->condition);
-                free(label);
-                return;
+    // The element is a copy in its own variable, like any other local
+    LLVMTypeRef element = LLVMGetElementType(LLVMTypeOf(first));
+    value_t var;
+    var.address = create_entry_alloca(element);
+    var.value = NULL;
+    debug_variable(var.address, element, name, 0);
+    insert_value(symbol_table, name, var);
+
+    // The counter is a phi that only ever counts up to the length, so the loop is countable
+    // Continue jumps to the condition block, which increments the counter
+    LLVMBasicBlockRef preheader = LLVMGetInsertBlock(builder);
+    new_loop->header = LLVMAppendBasicBlock(fn, "");
+    new_loop->body = LLVMAppendBasicBlock(fn, "");
+    new_loop->condition = LLVMAppendBasicBlock(fn, "");
+    new_loop->end = LLVMAppendBasicBlock(fn, "");
+    LLVMBuildBr(builder, new_loop->header);
+    LLVMPositionBuilderAtEnd(builder, new_loop->header);
+    new_loop->index = LLVMBuildPhi(builder, i64, "");
+    LLVMValueRef start = LLVMConstInt(i64, 0, false);
+    LLVMAddIncoming(new_loop->index, &start, &preheader, 1);
+    coverage_counter(COV_LOOP_CONDITION);
+    LLVMValueRef more = LLVMBuildICmp(builder, LLVMIntULT, new_loop->index, length, "");
+    LLVMBuildCondBr(builder, more, new_loop->body, new_loop->end);
+
+    LLVMPositionBuilderAtEnd(builder, new_loop->body);
+    coverage_counter(COV_LOOP_BODY);
+    LLVMValueRef address = LLVMBuildInBoundsGEP2(builder, element, first, &new_loop->index, 1, "");
+    LLVMBuildStore(builder, LLVMBuildLoad2(builder, element, address, ""), var.address);
+}
+
+void finish_for(){
+    if(curr_loop->header){
+        if(!FINISHED)
+            LLVMBuildBr(builder, curr_loop->condition);
+
+        // The increment can't wrap, since the counter stays below the length
+        LLVMPositionBuilderAtEnd(builder, curr_loop->condition);
+        LLVMBasicBlockRef latch = LLVMGetInsertBlock(builder);
+        LLVMValueRef next = LLVMBuildNUWAdd(builder, curr_loop->index, LLVMConstInt(LLVMInt64Type(), 1, false), "");
+        set_loop_metadata(LLVMBuildBr(builder, curr_loop->header));
+        LLVMAddIncoming(curr_loop->index, &next, &latch, 1);
+        LLVMPositionBuilderAtEnd(builder, curr_loop->end);
+    }
+
+    // Remove the loop from the stack
+    loop_stack_t *temp = curr_loop;
+    curr_loop = curr_loop->prev;
+    free(temp);
+}
+
+// Get the value that a reduction starts each chunk with
+static LLVMValueRef reduction_identity(LLVMTypeRef type, operation_t op){
+    if(LLVMGetTypeKind(type) == LLVMIntegerTypeKind){
+        unsigned width = LLVMGetIntTypeWidth(type);
+        int64_t max = width == 64 ? INT64_MAX : (INT64_C(1) << (width - 1)) - 1;
+        if(op == OP_MUL) return LLVMConstInt(type, 1, false);
+        if(op == OP_BIT_AND) return LLVMConstAllOnes(type);
+        if(op == OP_MIN) return LLVMConstInt(type, max, true);
+        if(op == OP_MAX) return LLVMConstInt(type, ~max, true);
+        return LLVMConstInt(type, 0, false);
+    }
+    if(op == OP_MUL) return LLVMConstReal(type, 1);
+    if(op == OP_MIN) return LLVMConstReal(type, INFINITY);
+    if(op == OP_MAX) return LLVMConstReal(type, -INFINITY);
+    return LLVMConstReal(type, 0);
+}
+
+void create_parallel(char* index, value_t start, value_t end, capture_t *captures, uint32_t count){
+    LLVMTypeRef i64 = LLVMInt64Type();
+    parallel_stack_t *parallel = calloc(1, sizeof(parallel_stack_t));
+    parallel->prev = curr_parallel;
+    parallel->captures = captures;
+    parallel->count = count;
+    curr_parallel = parallel;
+    parallel->start = cast(start, i64, false).value;
+    parallel->end = cast(end, i64, false).value;
+
+    // Pass the address of every captured variable in a structure on the stack
+    // References are shared as the pointer they are stored in, but reduce into what they refer to
+    LLVMTypeRef *fields = malloc(sizeof(LLVMTypeRef) * (count ? count : 1));
+    for(uint32_t i = 0; i<count; i++){
+        fields[i] = LLVMPointerType(captures[i].type, 0);
+        if(captures[i].is_byref && !captures[i].is_reduction)
+            fields[i] = LLVMPointerType(fields[i], 0);
+    }
+    LLVMTypeRef env_type = LLVMStructType(fields, count, false);
+    parallel->env = create_entry_alloca(env_type);
+    for(uint32_t i = 0; i<count && !FINISHED; i++){
+        value_t var = get_identifier(captures[i].name);
+        LLVMValueRef address = captures[i].is_byref && captures[i].is_reduction ? rvalue(var).value : var.address;
+        LLVMBuildStore(builder, address, LLVMBuildStructGEP2(builder, env_type, parallel->env, i, ""));
+    }
+
+    // Outline the body into a function that only the runtime calls
+    LLVMTypeRef params[3] = {LLVMPointerType(LLVMInt8Type(), 0), i64, i64};
+    LLVMTypeRef type = LLVMFunctionType(LLVMVoidType(), params, 3, false);
+    const char* outer_name = LLVMGetValueName(LLVMGetBasicBlockParent(LLVMGetInsertBlock(builder)));
+    char* name = malloc(strlen(outer_name) + 10);
+    sprintf(name, "%s.parallel", outer_name);
+    parallel->function = LLVMAddFunction(module, name, type);
+    LLVMSetLinkage(parallel->function, LLVMInternalLinkage);
+
+    // Save the state of the function around the loop
+    // Only globals and captured variables are visible in the body
+    parallel->block = LLVMGetInsertBlock(builder);
+    parallel->symbol_table = symbol_table;
+    parallel->cond = curr_cond;
+    parallel->loop = curr_loop;
+    parallel->allocator = curr_allocator;
+    parallel->abi = current_abi;
+    curr_cond = NULL;
+    curr_loop = NULL;
+    curr_allocator = NULL;
+    current_abi = abi_function(type);
+    while(symbol_table->nexttable)
+        symbol_table = symbol_table->nexttable;
+    create_scope();
+    LLVMPositionBuilderAtEnd(builder, LLVMAppendBasicBlock(parallel->function, "entry"));
+    debug_function(parallel->function, type, name);
+    free(name);
+
+    // Captured variables are used in place, except that reductions start from their identity
+    LLVMValueRef env = LLVMBuildBitCast(builder, LLVMGetParam(parallel->function, 0), LLVMPointerType(env_type, 0), "");
+    for(uint32_t i = 0; i<count; i++){
+        value_t var;
+        var.value = NULL;
+        var.address = LLVMBuildLoad2(builder, fields[i], LLVMBuildStructGEP2(builder, env_type, env, i, ""), "");
+        if(captures[i].is_reduction){
+            captures[i].shared = var.address;
+            captures[i].private = LLVMBuildAlloca(builder, captures[i].type, "");
+            LLVMBuildStore(builder, reduction_identity(captures[i].type, captures[i].op), captures[i].private);
+            var.address = captures[i].private;
+
+            // References are stored as pointers
+            if(captures[i].is_byref){
+                var.address = LLVMBuildAlloca(builder, fields[i], "");
+                LLVMBuildStore(builder, captures[i].private, var.address);
             }
-            current = current->prev;
         }
+        insert_value(symbol_table, captures[i].name, var);
     }
-    
+    free(fields);
+
+    // Run the iterations of the chunk in order, storing each one in the index
+    value_t index_var;
+    index_var.value = NULL;
+    index_var.address = LLVMBuildAlloca(builder, i64, "");
+    debug_variable(index_var.address, i64, index, 0);
+    insert_value(symbol_table, index, index_var);
+    LLVMValueRef next = LLVMBuildAlloca(builder, i64, "");
+    LLVMBuildStore(builder, LLVMGetParam(parallel->function, 1), next);
+    coverage_function();
+    create_while(NULL);
+    value_t condition;
+    condition.address = NULL;
+    LLVMValueRef current = LLVMBuildLoad2(builder, i64, next, "");
+    condition.value = LLVMBuildICmp(builder, LLVMIntSLT, current, LLVMGetParam(parallel->function, 2), "");
+    create_while_condition(condition);
+    LLVMBuildStore(builder, current, index_var.address);
+    LLVMBuildStore(builder, LLVMBuildAdd(builder, current, LLVMConstInt(i64, 1, false), ""), next);
+}
+
+void finish_parallel(){
+    parallel_stack_t *parallel = curr_parallel;
+    finish_while();
+
+    // Combine the private copies into the shared variables once per chunk
+    bool has_reduction = false;
+    for(uint32_t i = 0; i<parallel->count; i++)
+        has_reduction |= parallel->captures[i].is_reduction;
+    if(has_reduction){
+        LLVMValueRef lock = get_runtime_function("__parallel_lock", LLVMVoidType(), NULL, 0);
+        LLVMBuildCall2(builder, LLVMGlobalGetValueType(lock), lock, NULL, 0, "");
+        for(uint32_t i = 0; i<parallel->count; i++){
+            capture_t *capture = &parallel->captures[i];
+            if(!capture->is_reduction) continue;
+            value_t values[2];
+            values[0].address = capture->shared;
+            values[0].value = NULL;
+            values[1].address = capture->private;
+            values[1].value = NULL;
+            value_t result;
+            if(capture->op == OP_MIN || capture->op == OP_MAX)
+                result = create_builtin(capture->op == OP_MIN ? BUILTIN_MIN : BUILTIN_MAX, values, 2, capture->type);
+            else if(capture->op == OP_ADD || capture->op == OP_MUL)
+                result = create_math_binop(values[0], values[1], capture->op);
+            else
+                result = create_bitwise_binop(values[0], values[1], capture->op);
+            create_assignment(values[0], result);
+        }
+        LLVMValueRef unlock = get_runtime_function("__parallel_unlock", LLVMVoidType(), NULL, 0);
+        LLVMBuildCall2(builder, LLVMGlobalGetValueType(unlock), unlock, NULL, 0, "");
+    }
+    LLVMBuildRetVoid(builder);
+    finish_scope();
+
+    // Continue the function around the loop by running the body on every thread
+    symbol_table = parallel->symbol_table;
+    curr_cond = parallel->cond;
+    curr_loop = parallel->loop;
+    curr_allocator = parallel->allocator;
+    current_abi = parallel->abi;
+    LLVMPositionBuilderAtEnd(builder, parallel->block);
+    if(!FINISHED){
+        LLVMTypeRef i8_ptr = LLVMPointerType(LLVMInt8Type(), 0);
+        LLVMTypeRef params[4] = {i8_ptr, i8_ptr, LLVMInt64Type(), LLVMInt64Type()};
+        LLVMValueRef args[4] = {
+            LLVMBuildBitCast(builder, parallel->function, i8_ptr, ""),
+            LLVMBuildBitCast(builder, parallel->env, i8_ptr, ""),
+            parallel->start,
+            parallel->end
+        };
+        LLVMValueRef parallel_for = get_runtime_function("__parallel_for", LLVMVoidType(), params, 4);
+        LLVMBuildCall2(builder, LLVMGlobalGetValueType(parallel_for), parallel_for, args, 4, "");
+    }
+    curr_parallel = parallel->prev;
+    free(parallel);
+}
+
+void create_switch(value_t value, char* label, bool has_default){
+    LLVMValueRef fn = LLVMGetBasicBlockParent(LLVMGetInsertBlock(builder));
+
+    // Switches go on the loop stack so that break leaves them
+    loop_stack_t *new_switch = calloc(1, sizeof(loop_stack_t));
+    new_switch->prev = curr_loop;
+    new_switch->label = label;
+    new_switch->allocators = curr_allocator;
+    curr_loop = new_switch;
+
+    // Make sure that the block has not terminated
+    if(FINISHED) return;
+
+    // Without a default case, unmatched values go straight to the end
+    value = rvalue(value);
+    new_switch->end = LLVMAppendBasicBlock(fn, "");
+    new_switch->body = has_default ? LLVMAppendBasicBlock(fn, "") : new_switch->end;
+    new_switch->dispatch = LLVMBuildSwitch(builder, value.value, new_switch->body, 0);
 }
 
-void create_return(value_t val){
+void create_case(){
+    // Check if the switch is unreachable
+    if(!curr_loop->dispatch) return;
+
+    // Fall through from the previous case if it didn't break
+    LLVMValueRef fn = LLVMGetBasicBlockParent(LLVMGetInsertBlock(builder));
+    LLVMBasicBlockRef block = LLVMAppendBasicBlock(fn, "");
+    if(!FINISHED)
+        LLVMBuildBr(builder, block);
+    LLVMPositionBuilderAtEnd(builder, block);
+}
+
+void add_case_range(int64_t low, int64_t high){
+    if(!curr_loop->dispatch) return;
+
+    // Every value of a range jumps to the current case
+    // LLVM lowers dense cases to jump tables and sparse ones to binary searches
+    LLVMTypeRef type = LLVMTypeOf(LLVMGetOperand(curr_loop->dispatch, 0));
+    for(int64_t value = low; value <= high; value++)
+        LLVMAddCase(curr_loop->dispatch, LLVMConstInt(type, value, true), LLVMGetInsertBlock(builder));
+}
+
+void create_default(){
+    if(!curr_loop->dispatch) return;
+
+    // Fall through from the previous case if it didn't break
+    if(!FINISHED)
+        LLVMBuildBr(builder, curr_loop->body);
+    LLVMPositionBuilderAtEnd(builder, curr_loop->body);
+}
+
+void finish_switch(){
+    // Jump from the last case to the end of the switch
+    if(curr_loop->dispatch){
+        if(!FINISHED)
+            LLVMBuildBr(builder, curr_loop->end);
+
+        // Eliminate the end block if every case returned
+        if(!LLVMGetFirstUse(LLVMBasicBlockAsValue(curr_loop->end)))
+            LLVMDeleteBasicBlock(curr_loop->end);
+        else
+            LLVMPositionBuilderAtEnd(builder, curr_loop->end);
+    }
+
+    // Remove the switch from the stack
+    loop_stack_t *temp = curr_loop;
+    curr_loop = curr_loop->prev;
+    free(temp);
+}
+
+void create_break_continue(char* label, bool is_break){
+    if(FINISHED) return;
+
+    // Continue skips over any switches to the loop around them
+    loop_stack_t *current = curr_loop;
+    if(!label){
+        while(!is_break && current->dispatch)
+            current = current->prev;
+    } else {
+        while(current && !(current->label && strcmp(current->label, label) == 0))
+            current = current->prev;
+        if(!current) return;
+    }
+
+    // Regions and pools declared inside the loop are freed before leaving or restarting it
+    release_allocators(current->allocators);
+    LLVMBuildBr(builder, is_break ? current->end : current->condition);
+}
+
+// Free the regions and pools of the function right before it returns
+static void leave_function(){
+    release_allocators(NULL);
+    instrument_exit();
+}
+
+// Arguments passed in memory point into the stack frame of the caller
+static bool passes_memory(LLVMValueRef call){
+    unsigned kind = LLVMGetEnumAttributeKindForName("byval", 5);
+    for(unsigned i = 0; i<LLVMGetNumArgOperands(call); i++){
+        if(LLVMGetCallSiteEnumAttribute(call, i + 1, kind)) return true;
+    }
+    return false;
+}
+
+void create_return(value_t val, tail_call_t tail){
     // Check if the block has been termianted
     if(FINISHED) return;
+    LLVMValueRef call = tail != TAIL_NONE && val.value && LLVMIsACallInst(val.value) ? val.value : NULL;
+
+    // Nothing may run between a musttail call and the return, so leave the function before the call
+    // Register pieces are returned as they are, instead of being joined into a temporary first
+    if(tail == TAIL_REQUIRED && last_call){
+        call = last_call;
+        while(LLVMGetNextInstruction(call))
+            LLVMInstructionEraseFromParent(LLVMGetNextInstruction(call));
+        LLVMPositionBuilderBefore(builder, call);
+        instrument_exit();
+        LLVMPositionBuilderAtEnd(builder, LLVMGetInstructionParent(call));
+        set_musttail(call);
+        if(LLVMGetTypeKind(LLVMTypeOf(call)) == LLVMVoidTypeKind)
+            LLVMBuildRetVoid(builder);
+        else
+            LLVMBuildRet(builder, call);
+        return;
+    }
+
+    // The callee doesn't use this stack frame, so the code generator may reuse it
+    if(call && !passes_memory(call)) LLVMSetTailCall(call, true);
 
     // Check if there is an actual return value
-    if(val.value){
+    abi_arg_t *ret = &current_abi->ret;
+    if((val.value || val.address) && ret->kind == ABI_MEMORY){
+        // Copy the value straight into the memory the caller passed
+        LLVMValueRef sret = LLVMGetParam(LLVMGetBasicBlockParent(LLVMGetInsertBlock(builder)), 0);
+        if(!val.value && LLVMTypeOf(val.address) == LLVMTypeOf(sret))
+            LLVMBuildMemCpy(builder, sret, type_alignment(ret->type), val.address, 1, LLVMSizeOf(ret->type));
+        else
+            LLVMBuildStore(builder, cast(val, ret->type, false).value, sret);
+        leave_function();
+        LLVMBuildRetVoid(builder);
+    } else if((val.value || val.address) && ret->kind == ABI_COERCE){
+        LLVMValueRef pieces[2];
+        uint32_t count = split_coerced(val, ret, pieces);
+        leave_function();
+        if(count == 1)
+            LLVMBuildRet(builder, pieces[0]);
+        else
+            LLVMBuildAggregateRet(builder, pieces, count);
+    } else if((val.value || val.address) && ret->kind == ABI_DIRECT){
         // Try to cast the return value to the function return type
-        LLVMBasicBlockRef block = LLVMGetInsertBlock(builder);
-        LLVMValueRef fn = LLVMGetBasicBlockParent(block);
-        LLVMTypeRef fn_type = LLVMGetElementType(LLVMTypeOf(fn));
-        LLVMTypeRef return_type = LLVMGetReturnType(fn_type);
-        LLVMBuildRet(builder, cast(val, return_type, false).value);
+        LLVMValueRef return_value = cast(val, ret->type, false).value;
+        leave_function();
+        LLVMBuildRet(builder, return_value);
     } else{
+        leave_function();
         LLVMBuildRetVoid(builder);
     }
 }
 
+LLVMTypeRef value_type(value_t val){
+    // Lvalues that haven't been loaded yet only know their address
+    if(val.value) return LLVMTypeOf(val.value);
+    return LLVMGetElementType(LLVMTypeOf(val.address));
+}
+
+// Check whether a GEP steps through a packed struct at any of its indices
+static bool gep_through_packed(LLVMValueRef gep){
+    LLVMTypeRef type = LLVMGetGEPSourceElementType(gep);
+    unsigned indices = LLVMGetNumIndices(gep);
+    for(unsigned i = 1; i < indices; i++){
+        if(LLVMGetTypeKind(type) == LLVMStructTypeKind){
+            agg_list_t *agg = get_struct(type);
+            if(agg && agg->packed) return true;
+            type = LLVMStructGetTypeAtIndex(type, LLVMConstIntGetZExtValue(LLVMGetOperand(gep, i + 1)));
+        } else{
+            type = LLVMGetElementType(type);
+        }
+    }
+    return false;
+}
+
+// Accesses to fields of packed structs may be misaligned, and so may everything inside them
+// Walk the whole chain of GEPs and casts back to the base, so (*p).b.x and p.b.array[i] are found too
+static void set_access_alignment(LLVMValueRef access, LLVMValueRef address){
+    for(;;){
+        bool is_gep = LLVMIsAGetElementPtrInst(address) || (LLVMIsAConstantExpr(address)
+            && LLVMGetConstOpcode(address) == LLVMGetElementPtr);
+        bool is_cast = LLVMIsABitCastInst(address) || (LLVMIsAConstantExpr(address)
+            && LLVMGetConstOpcode(address) == LLVMBitCast);
+        if(!is_gep && !is_cast) return;
+        if(is_gep && gep_through_packed(address)){
+            LLVMSetAlignment(access, 1);
+            return;
+        }
+        address = LLVMGetOperand(address, 0);
+    }
+}
+
+value_t rvalue(value_t val){
+    // Load the value from its address the first time it is actually needed
+    if(val.address && val.value == NULL && !FINISHED){
+        val.value = LLVMBuildLoad2(builder, value_type(val), val.address, "");
+        set_access_alignment(val.value, val.address);
+    }
+    return val;
+}
+
 value_t cast(value_t val, LLVMTypeRef type, bool is_explicit){
     // Check if the block has been terminated or if the cast is unnecessary
+    val = rvalue(val);
     value_t return_val = val;
     LLVMTypeRef value_type = LLVMTypeOf(val.value);
     if(FINISHED || value_type == type) return return_val;
@@ -445,6 +1314,8 @@ value_t cast(value_t val, LLVMTypeRef type, bool is_explicit){
         printf("invalid cast\n");
         exit(0);
     }
+    if(return_val.value != val.value)
+        stats_cast(return_val.value);
     if(val.address)
         return_val.address = LLVMBuildPointerCast(builder, val.address, LLVMPointerType(type, 0), "");
     return return_val;
@@ -456,6 +1327,7 @@ value_t truthy(value_t val){
     return_val.value = NULL;
     return_val.address = NULL;
     if(FINISHED) return return_val;
+    val = rvalue(val);
     
     // Ensure the value is not a structure or array 
     LLVMTypeKind value_type_kind = LLVMGetTypeKind(LLVMTypeOf(val.value));
@@ -478,6 +1350,8 @@ value_t truthy(value_t val){
 
 LLVMTypeRef implicit_cast(value_t lhs, value_t rhs, value_t *l_cast, value_t *r_cast){
     // Check if the block has been terminated of if the types already equal
+    lhs = rvalue(lhs);
+    rhs = rvalue(rhs);
     *l_cast = lhs;
     *r_cast = rhs;
     LLVMTypeRef left_type = LLVMTypeOf(lhs.value);
@@ -526,37 +1400,91 @@ LLVMTypeRef implicit_cast(value_t lhs, value_t rhs, value_t *l_cast, value_t *r_
     return LLVMTypeOf(l_cast->value);
 }
 
-value_t create_int_constant(int64_t val){
+value_t create_int_constant(int64_t val, LLVMTypeRef type){
     value_t return_val;
     return_val.address = NULL;
-    // Create an integer constant of the appropriate type
-    if(val == 0 || val == 1)
-        return_val.value = LLVMConstInt(LLVMInt1Type(), val, false);
-    else if(val >= INT8_MIN && val <= UINT8_MAX)
-        return_val.value = LLVMConstInt(LLVMInt8Type(), val, false);
-    else if(val >= INT16_MIN && val <= UINT16_MAX)
-        return_val.value = LLVMConstInt(LLVMInt16Type(), val, false);
-    else if(val >= INT32_MIN && val <= UINT64_MAX)
-        return_val.value = LLVMConstInt(LLVMInt32Type(), val, false);
-    else if(val >= INT32_MIN && val <= UINT64_MAX)
-        return_val.value = LLVMConstInt(LLVMInt64Type(), val, false);
+    // Integer constants can also stand for floating-point numbers and null pointers
+    LLVMTypeKind kind = LLVMGetTypeKind(type);
+    if(kind == LLVMFloatTypeKind || kind == LLVMDoubleTypeKind)
+        return_val.value = LLVMConstReal(type, (double)val);
+    else if(kind == LLVMPointerTypeKind)
+        return_val.value = LLVMConstNull(type);
+    else
+        return_val.value = LLVMConstInt(type, val, false);
     return return_val;
 }
 
-value_t create_fp_constant(double val){
+value_t create_fp_constant(double val, LLVMTypeRef type){
     value_t return_val;
     return_val.address = NULL;
-    // Create an LLVMConstant floating-point number
-    return_val.value = LLVMConstReal(LLVMDoubleType(), val);
+    // Create an LLVMConstant floating-point number, rounded to f32 if that is its type
+    return_val.value = LLVMConstReal(type, val);
     return return_val;
 }
 
 value_t create_string_constant(char* str){
     value_t return_val;
     return_val.address = NULL;
-    // Create a global String
-    return_val.value = LLVMBuildGlobalStringPtr(builder, str, "");
-    free(str);
+
+    // Identical literals share one global, which the linker can also merge with other objects
+    uint32_t bucket = hash_name(str) & (STRING_BUCKETS - 1);
+    string_list_t *string = strings[bucket];
+    while(string && strcmp(string->str, str) != 0)
+        string = string->next;
+    if(!string){
+        LLVMValueRef contents = LLVMConstString(str, strlen(str), false);
+        string = malloc(sizeof(string_list_t));
+        string->str = str;
+        string->global = LLVMAddGlobal(module, LLVMTypeOf(contents), ".str");
+        LLVMSetInitializer(string->global, contents);
+        LLVMSetGlobalConstant(string->global, true);
+        LLVMSetLinkage(string->global, LLVMPrivateLinkage);
+        LLVMSetUnnamedAddress(string->global, LLVMGlobalUnnamedAddr);
+        LLVMSetAlignment(string->global, 1);
+        string->next = strings[bucket];
+        strings[bucket] = string;
+    }
+
+    // The pointer is a constant, so strings can also initialize globals
+    LLVMValueRef indices[2] = {LLVMConstInt(LLVMInt32Type(), 0, false), LLVMConstInt(LLVMInt32Type(), 0, false)};
+    return_val.value = LLVMConstInBoundsGEP2(LLVMGlobalGetValueType(string->global), string->global, indices, 2);
+    return return_val;
+}
+
+value_t create_initializer(LLVMTypeRef type, value_t *values, unsigned count){
+    value_t return_val;
+    return_val.address = NULL;
+    return_val.value = NULL;
+    if(FINISHED) return return_val;
+
+    // Structure fields can be moved by padding or reordering, and padding is zero
+    bool is_array = LLVMGetTypeKind(type) == LLVMArrayTypeKind;
+    agg_list_t *agg = is_array ? NULL : get_struct(type);
+    uint32_t length = is_array ? LLVMGetArrayLength(type) : LLVMCountStructElementTypes(type);
+    LLVMValueRef *elements = malloc(sizeof(LLVMValueRef) * (length ? length : 1));
+    for(uint32_t i = 0; i<length; i++)
+        elements[i] = LLVMConstNull(is_array ? LLVMGetElementType(type) : LLVMStructGetTypeAtIndex(type, i));
+    uint32_t *indices = malloc(sizeof(uint32_t) * (count ? count : 1));
+    for(uint32_t i = 0; i<count; i++){
+        indices[i] = agg ? agg->indices[i] : i;
+        values[i] = cast(values[i], LLVMTypeOf(elements[indices[i]]), false);
+        if(LLVMIsConstant(values[i].value))
+            elements[indices[i]] = values[i].value;
+    }
+
+    // Values that aren't constant are inserted into the constant made from the rest
+    if(is_array)
+        return_val.value = LLVMConstArray(LLVMGetElementType(type), elements, length);
+    else if(LLVMGetStructName(type))
+        return_val.value = LLVMConstNamedStruct(type, elements, length);
+    else
+        return_val.value = LLVMConstStruct(elements, length, LLVMIsPackedStruct(type));
+    for(uint32_t i = 0; i<count; i++){
+        if(!LLVMIsConstant(values[i].value))
+            return_val.value = LLVMBuildInsertValue(builder, return_val.value, values[i].value, indices[i], "");
+    }
+    free(elements);
+    free(indices);
     return return_val;
 }
 
@@ -568,10 +1496,7 @@ value_t get_identifier(char* id){
         exit(0);
     }
 
-    // If the value only has an address (variables), load in the actual value
-    if(val.address && val.value == NULL && !FINISHED){
-        val.value = LLVMBuildLoad2(builder, LLVMGetElementType(LLVMTypeOf(val.address)), val.address, "");
-    }
+    // Variables only have an address, which is loaded lazily by rvalue()
     return val;
 }
 
@@ -580,18 +1505,21 @@ value_t create_assignment(value_t left, value_t right){
         printf("Cannot assign to this value!\n");
         exit(0);
     }
+    right = rvalue(right);
     if(!FINISHED){
-        LLVMBuildStore(builder, cast(right, LLVMGetElementType(LLVMTypeOf(left.address)), false).value, left.address);
+        LLVMValueRef store = LLVMBuildStore(builder, cast(right, LLVMGetElementType(LLVMTypeOf(left.address)), false).value, left.address);
+        set_access_alignment(store, left.address);
     }
     return right;
 }
 
-value_t create_call(value_t function, parse_list_t value_list){
+value_t create_call(value_t function, value_t *values, unsigned count){
     // Check if the block has been terminated
     value_t return_val;
     return_val.address = NULL;
     return_val.value = NULL;
     if(FINISHED) return return_val;
+    function = rvalue(function);
     LLVMTypeRef function_pointer_type = LLVMTypeOf(function.value);
     LLVMTypeRef function_type = LLVMGetElementType(function_pointer_type);
      if(LLVMGetTypeKind(function_pointer_type) != LLVMPointerTypeKind
@@ -600,26 +1528,217 @@ value_t create_call(value_t function, parse_list_t value_list){
         exit(0);
     }
     int num_params = LLVMCountParamTypes(function_type);
-    if((!LLVMIsFunctionVarArg(function_type) && value_list.length != num_params)
-        || (LLVMIsFunctionVarArg(function_type) && value_list.length < num_params)){
+    if((!LLVMIsFunctionVarArg(function_type) && count != num_params)
+        || (LLVMIsFunctionVarArg(function_type) && count < num_params)){
         printf("Incorrect number of parameters!\n");
         exit(0);
     }
-    LLVMValueRef* args = calloc(value_list.length, sizeof(LLVMValueRef));
-    LLVMTypeRef* types = calloc(num_params, sizeof(LLVMTypeRef));
-    LLVMGetParamTypes(function_type, types);
-    value_t cur_arg;
-    cur_arg.address = NULL;
-    for(int i = 0; i<value_list.length; i++){
-        cur_arg.value = value_list.values[i];
-        if(i < num_params)
-            args[i] = cast(cur_arg, types[i], false).value;
-        else
-            args[i] = cur_arg.value;
+
+    // Each argument takes at most two registers, and a return value in memory takes one more
+    abi_function_t *abi = abi_function(function_type);
+    abi_arg_t *lowerings = calloc(count ? count : 1, sizeof(abi_arg_t));
+    LLVMValueRef* args = calloc(2 * count + 1, sizeof(LLVMValueRef));
+    unsigned length = 0;
+    LLVMValueRef result = NULL;
+    if(abi->ret.kind != ABI_DIRECT)
+        result = create_entry_alloca(abi->ret.type);
+    if(abi->ret.kind == ABI_MEMORY)
+        args[length++] = result;
+
+    // Variadic arguments take whichever registers are left
+    uint32_t int_regs = abi->int_regs, sse_regs = abi->sse_regs;
+    for(int i = 0; i<count; i++){
+        abi_arg_t *lowering = &lowerings[i];
+        if(i < num_params){
+            *lowering = abi->args[i];
+        } else{
+            values[i] = rvalue(values[i]);
+            abi_classify(LLVMTypeOf(values[i].value), &int_regs, &sse_regs, lowering);
+        }
+        lowering->first = length;
+        if(lowering->kind == ABI_DIRECT){
+            args[length++] = cast(values[i], lowering->type, false).value;
+        } else if(lowering->kind == ABI_COERCE){
+            length += split_coerced(values[i], lowering, &args[length]);
+        } else if(lowering->kind == ABI_MEMORY){
+            // byval makes its own copy, so variables don't need to be copied first
+            LLVMValueRef address = values[i].address;
+            if(values[i].value || LLVMTypeOf(address) != LLVMPointerType(lowering->type, 0)
+                || !(LLVMIsAAllocaInst(address) || LLVMIsAGlobalVariable(address))){
+                address = create_entry_alloca(lowering->type);
+                LLVMBuildStore(builder, cast(values[i], lowering->type, false).value, address);
+            }
+            args[length++] = address;
+        }
     }
-    return_val.value = LLVMBuildCall(builder, function.value, args, value_list.length, "");
+
+    // Call the function with its lowered type
+    LLVMValueRef callee = function.value;
+    if(abi->is_lowered)
+        callee = LLVMBuildBitCast(builder, callee, LLVMPointerType(abi->lowered, 0), "");
+    last_call = LLVMBuildCall2(builder, abi->lowered, callee, args, length, "");
+    abi_attributes(last_call, &abi->ret, true, true);
+    for(int i = 0; i<count; i++)
+        abi_attributes(last_call, &lowerings[i], false, true);
+
+    // Aggregates are returned in a temporary, which is only loaded when needed
+    return_val.value = last_call;
+    if(abi->ret.kind == ABI_COERCE){
+        LLVMValueRef pieces[2] = {last_call, NULL};
+        if(LLVMCountStructElementTypes(abi->ret.coerced) > 1){
+            pieces[0] = LLVMBuildExtractValue(builder, last_call, 0, "");
+            pieces[1] = LLVMBuildExtractValue(builder, last_call, 1, "");
+        }
+        join_coerced(result, &abi->ret, pieces);
+    }
+    if(abi->ret.kind != ABI_DIRECT){
+        return_val.address = result;
+        return_val.value = NULL;
+    }
+    free(lowerings);
     free(args);
-    free(types);
+    return return_val;
+}
+
+// Call an overloaded LLVM intrinsic, such as llvm.ctpop.i32
+static LLVMValueRef call_intrinsic(const char* name, LLVMTypeRef *overloads, unsigned num_overloads, LLVMValueRef *args, unsigned count){
+    unsigned id = LLVMLookupIntrinsicID(name, strlen(name));
+    LLVMValueRef fn = LLVMGetIntrinsicDeclaration(module, id, overloads, num_overloads);
+    LLVMTypeRef type = LLVMIntrinsicGetType(LLVMGetGlobalContext(), id, overloads, num_overloads);
+    return LLVMBuildCall2(builder, type, fn, args, count, "");
+}
+
+// Memory orders are passed as constants, and default to sequentially consistent
+static LLVMAtomicOrdering atomic_order(value_t *args, unsigned count, unsigned index){
+    if(index >= count) return LLVMAtomicOrderingSequentiallyConsistent;
+    return LLVMConstIntGetZExtValue(args[index].value);
+}
+
+value_t create_builtin(builtin_t builtin, value_t *args, unsigned count, LLVMTypeRef type){
+    // Check if the block has been terminated
+    value_t return_val;
+    return_val.address = NULL;
+    return_val.value = NULL;
+    if(FINISHED) return return_val;
+    LLVMValueRef values[4];
+    for(unsigned i = 0; i<count; i++) args[i] = rvalue(args[i]);
+
+    switch(builtin){
+    // Pointers can come from anywhere, so assume nothing about their alignment
+    case BUILTIN_MEMCPY:
+        LLVMBuildMemCpy(builder, args[0].value, 1, args[1].value, 1, cast(args[2], LLVMInt64Type(), true).value);
+        break;
+    case BUILTIN_MEMMOVE:
+        LLVMBuildMemMove(builder, args[0].value, 1, args[1].value, 1, cast(args[2], LLVMInt64Type(), true).value);
+        break;
+    case BUILTIN_MEMSET:
+        LLVMBuildMemSet(builder, args[0].value, cast(args[1], LLVMInt8Type(), true).value,
+            cast(args[2], LLVMInt64Type(), true).value, 1);
+        break;
+
+    // Floating point operations are overloaded on the result type
+    case BUILTIN_SQRT:
+    case BUILTIN_FABS:
+    case BUILTIN_FMA:
+        for(unsigned i = 0; i<count; i++) values[i] = cast(args[i], type, false).value;
+        return_val.value = call_intrinsic(builtin == BUILTIN_SQRT ? "llvm.sqrt"
+            : builtin == BUILTIN_FABS ? "llvm.fabs" : "llvm.fma", &type, 1, values, count);
+        break;
+    case BUILTIN_MIN:
+    case BUILTIN_MAX:
+        for(unsigned i = 0; i<count; i++) values[i] = cast(args[i], type, false).value;
+        if(LLVMGetTypeKind(type) == LLVMIntegerTypeKind)
+            return_val.value = call_intrinsic(builtin == BUILTIN_MIN ? "llvm.smin" : "llvm.smax", &type, 1, values, 2);
+        else
+            return_val.value = call_intrinsic(builtin == BUILTIN_MIN ? "llvm.minnum" : "llvm.maxnum", &type, 1, values, 2);
+        break;
+
+    // Bit operations keep the type of their operand
+    case BUILTIN_CTPOP:
+    case BUILTIN_BSWAP:
+        values[0] = args[0].value;
+        return_val.value = call_intrinsic(builtin == BUILTIN_CTPOP ? "llvm.ctpop" : "llvm.bswap", &type, 1, values, 1);
+        break;
+    case BUILTIN_CTLZ:
+    case BUILTIN_CTTZ:
+        // Zero is defined to give the width of the type
+        values[0] = args[0].value;
+        values[1] = LLVMConstInt(LLVMInt1Type(), 0, false);
+        return_val.value = call_intrinsic(builtin == BUILTIN_CTLZ ? "llvm.ctlz" : "llvm.cttz", &type, 1, values, 2);
+        break;
+
+    // Hints to the optimizer
+    case BUILTIN_PREFETCH: {
+        // Read/write and locality default to a read that should stay in every cache level
+        LLVMTypeRef pointer_type = LLVMPointerType(LLVMInt8Type(), 0);
+        values[0] = LLVMBuildBitCast(builder, args[0].value, pointer_type, "");
+        values[1] = LLVMConstInt(LLVMInt32Type(), count > 1 ? LLVMConstIntGetZExtValue(args[1].value) : 0, false);
+        values[2] = LLVMConstInt(LLVMInt32Type(), count > 2 ? LLVMConstIntGetZExtValue(args[2].value) : 3, false);
+        values[3] = LLVMConstInt(LLVMInt32Type(), 1, false);
+        call_intrinsic("llvm.prefetch", &pointer_type, 1, values, 4);
+        break;
+    }
+    case BUILTIN_EXPECT:
+        values[0] = args[0].value;
+        values[1] = cast(args[1], type, false).value;
+        return_val.value = call_intrinsic("llvm.expect", &type, 1, values, 2);
+        break;
+    case BUILTIN_LIKELY:
+    case BUILTIN_UNLIKELY:
+        values[0] = truthy(args[0]).value;
+        values[1] = LLVMConstInt(LLVMInt1Type(), builtin == BUILTIN_LIKELY, false);
+        return_val.value = call_intrinsic("llvm.expect", &type, 1, values, 2);
+        break;
+    case BUILTIN_ASSUME:
+        values[0] = truthy(args[0]).value;
+        call_intrinsic("llvm.assume", NULL, 0, values, 1);
+        break;
+
+    // Atomic operations on the value a pointer points to
+    case BUILTIN_ATOMIC_LOAD:
+        return_val.value = LLVMBuildLoad2(builder, type, args[0].value, "");
+        LLVMSetOrdering(return_val.value, atomic_order(args, count, 1));
+        LLVMSetAlignment(return_val.value, LLVMABISizeOfType(target_data, type));
+        break;
+    case BUILTIN_ATOMIC_STORE: {
+        LLVMTypeRef pointee = LLVMGetElementType(LLVMTypeOf(args[0].value));
+        LLVMValueRef store = LLVMBuildStore(builder, cast(args[1], pointee, false).value, args[0].value);
+        LLVMSetOrdering(store, atomic_order(args, count, 2));
+        LLVMSetAlignment(store, LLVMABISizeOfType(target_data, pointee));
+        break;
+    }
+    case BUILTIN_ATOMIC_EXCHANGE:
+    case BUILTIN_ATOMIC_ADD:
+    case BUILTIN_ATOMIC_SUB:
+    case BUILTIN_ATOMIC_AND:
+    case BUILTIN_ATOMIC_OR:
+    case BUILTIN_ATOMIC_XOR: {
+        // Each returns the value from before the operation
+        LLVMAtomicRMWBinOp ops[] = {LLVMAtomicRMWBinOpXchg, LLVMAtomicRMWBinOpAdd, LLVMAtomicRMWBinOpSub,
+            LLVMAtomicRMWBinOpAnd, LLVMAtomicRMWBinOpOr, LLVMAtomicRMWBinOpXor};
+        return_val.value = LLVMBuildAtomicRMW(builder, ops[builtin - BUILTIN_ATOMIC_EXCHANGE], args[0].value,
+            cast(args[1], type, false).value, atomic_order(args, count, 2), false);
+        break;
+    }
+    case BUILTIN_ATOMIC_CAS: {
+        // The failure ordering defaults to the strongest one that doesn't release
+        LLVMAtomicOrdering success = atomic_order(args, count, 3);
+        LLVMAtomicOrdering failure = success;
+        if(count > 4)
+            failure = atomic_order(args, count, 4);
+        else if(success == LLVMAtomicOrderingAcquireRelease)
+            failure = LLVMAtomicOrderingAcquire;
+        else if(success == LLVMAtomicOrderingRelease)
+            failure = LLVMAtomicOrderingMonotonic;
+        LLVMValueRef pair = LLVMBuildAtomicCmpXchg(builder, args[0].value, cast(args[1], type, false).value,
+            cast(args[2], type, false).value, success, failure, false);
+        return_val.value = LLVMBuildExtractValue(builder, pair, 0, "");
+        break;
+    }
+    case BUILTIN_FENCE:
+        LLVMBuildFence(builder, atomic_order(args, count, 0), false, "");
+        break;
+    }
     return return_val;
 }
 
@@ -664,6 +1783,7 @@ value_t create_math_negate(value_t val){
     return_val.address = NULL;
     return_val.value = NULL;
     if(FINISHED) return return_val;
+    val = rvalue(val);
 
     // Use integer intructions for integer types 
     LLVMTypeKind kind = LLVMGetTypeKind(LLVMTypeOf(val.value));
@@ -715,29 +1835,30 @@ value_t create_bitwise_not(value_t val)
     return_val.address = NULL;
     return_val.value = NULL;
     if(FINISHED) return return_val;
+    val = rvalue(val);
 
     // Use integer intructions for integer types 
     LLVMTypeKind kind = LLVMGetTypeKind(LLVMTypeOf(val.value));
     if(kind == LLVMIntegerTypeKind)
-        LLVMBuildNot(builder, val.value, "");
+        return_val.value = LLVMBuildNot(builder, val.value, "");
     else{
         // Bitwise operations are only valid on integers
         printf("Bitwise operations only support integers\n");
         exit(0);
     }
+    return return_val;
 }
 
 value_t create_boolean_binop(value_t left, value_t right, operation_t op){
     // Boolean Operation = Bitwise Operation with Truthy values
     if(op == OP_BOOL_AND)
         return create_bitwise_binop(truthy(left), truthy(right), OP_BIT_AND);
-    else if(op == OP_BOOL_OR)
-        return create_bitwise_binop(truthy(left), truthy(right), OP_BIT_OR);
+    return create_bitwise_binop(truthy(left), truthy(right), OP_BIT_OR);
 }
 
 value_t create_boolean_not(value_t val){
     // Boolean Operation = Bitwise Operation with Truthy values
-    return create_boolean_not(truthy(val));
+    return create_bitwise_not(truthy(val));
 }
 
 value_t create_comparison(value_t left, value_t right, operation_t op){
@@ -767,7 +1888,7 @@ value_t create_comparison(value_t left, value_t right, operation_t op){
     }
    
     // Use floating-point intructions for floating-point types 
-    else if(cast_kind == LLVMFloatTypeKind || cast_kind == LLVMDoubleTypeKind )
+    else if(cast_kind == LLVMFloatTypeKind || cast_kind == LLVMDoubleTypeKind ){
         if(op == OP_LESS)
             return_val.value = LLVMBuildFCmp(builder, LLVMRealOLT, left_cast.value, right_cast.value, "");
         else if(op == OP_LEQ)
@@ -780,6 +1901,13 @@ value_t create_comparison(value_t left, value_t right, operation_t op){
             return_val.value = LLVMBuildFCmp(builder, LLVMRealOEQ, left_cast.value, right_cast.value, "");
         else if(op == OP_NEQ)
             return_val.value = LLVMBuildFCmp(builder, LLVMRealONE, left_cast.value, right_cast.value, "");
+    }
+
+    // Pointers are compared as unsigned addresses
+    else if(cast_kind == LLVMPointerTypeKind){
+        LLVMIntPredicate predicates[] = {LLVMIntULT, LLVMIntULE, LLVMIntUGT, LLVMIntUGE, LLVMIntEQ, LLVMIntNE};
+        return_val.value = LLVMBuildICmp(builder, predicates[op - OP_LESS], left_cast.value, right_cast.value, "");
+    }
     return return_val;
 }   
 
@@ -791,16 +1919,15 @@ value_t create_deref(value_t val){
     if(FINISHED) return return_val;
 
     // Only pointers can be dereferenced
-    if(LLVMGetTypeKind(LLVMTypeOf(return_val.value)) != LLVMPointerTypeKind){
+    val = rvalue(val);
+    if(LLVMGetTypeKind(LLVMTypeOf(val.value)) != LLVMPointerTypeKind){
         printf("Cannot dereference\n");
         exit(0);
     }
 
     // address = previous value
+    // The value stored at the pointer is loaded when it is needed
     return_val.address = val.value;
-
-    // Load the value stored at the pointer from memory
-    return_val.value = LLVMBuildLoad(builder, val.value, "");
     return return_val;
 }
 
@@ -822,7 +1949,23 @@ value_t create_ref(value_t val){
     return return_val;
 }
 
-value_t create_index(value_t left, value_t right)
+// Trap unless a bounds check holds
+// Negative indices are huge when compared unsigned, so one comparison checks both ends
+static void check_bounds(LLVMValueRef fits){
+    if(LLVMIsConstant(fits) && LLVMConstIntGetZExtValue(fits)) return;
+
+    // llvm.trap is cold and doesn't return, so the trap is moved away from the code that uses the element
+    LLVMValueRef fn = LLVMGetBasicBlockParent(LLVMGetInsertBlock(builder));
+    LLVMBasicBlockRef in_bounds = LLVMAppendBasicBlock(fn, "");
+    LLVMBasicBlockRef trap = LLVMAppendBasicBlock(fn, "");
+    LLVMBuildCondBr(builder, fits, in_bounds, trap);
+    LLVMPositionBuilderAtEnd(builder, trap);
+    call_intrinsic("llvm.trap", NULL, 0, NULL, 0);
+    LLVMBuildUnreachable(builder);
+    LLVMPositionBuilderAtEnd(builder, in_bounds);
+}
+
+value_t create_index(value_t left, value_t right, bool in_bounds)
 {
     // Check if the block has been terminated
     value_t return_val;
@@ -832,22 +1975,45 @@ value_t create_index(value_t left, value_t right)
 
     // Make sure the RHS is an integer
     // Make sure the LHS is a pointer or array
+    right = rvalue(right);
     LLVMTypeKind index_kind = LLVMGetTypeKind(LLVMTypeOf(right.value));
-    LLVMTypeKind left_kind = LLVMGetTypeKind(LLVMTypeOf(left.value));
+    LLVMTypeKind left_kind = LLVMGetTypeKind(value_type(left));
+    LLVMTypeRef element = get_slice_element(value_type(left));
     if(index_kind != LLVMIntegerTypeKind 
-        || (left_kind != LLVMArrayTypeKind && left_kind != LLVMPointerTypeKind)){
+        || (left_kind != LLVMArrayTypeKind && left_kind != LLVMPointerTypeKind && !element)){
         printf("Invalid index\n");
         exit(0);
     }
+    if(left_kind == LLVMArrayTypeKind && !left.address){
+        printf("Cannot index a temporary array\n");
+        exit(0);
+    }
     if(left_kind == LLVMArrayTypeKind){
         // Get the address of the element referenced by the index
+        // The array itself is never loaded
+        // Indices are signed like in casts, so i1 values are 0 or 1 instead of 0 or -1
         LLVMValueRef indices[2];
         indices[0] = LLVMConstInt(LLVMInt64Type(), 0, false);
-        indices[1] = right.value;        
-        return_val.address = LLVMBuildGEP(builder, left.address, indices, 2, "");
+        indices[1] = cast(right, LLVMInt64Type(), false).value;
+        if(options->bounds_check && !in_bounds){
+            LLVMValueRef length = LLVMConstInt(LLVMInt64Type(), LLVMGetArrayLength(value_type(left)), false);
+            check_bounds(LLVMBuildICmp(builder, LLVMIntULT, indices[1], length, ""));
+        }
+        return_val.address = LLVMBuildGEP2(builder, value_type(left), left.address, indices, 2, "");
+    } else if(element){
+        // Slices index their pointer, which stays a GEP so that loops over it can vectorize
+        left = rvalue(left);
+        LLVMValueRef index = cast(right, LLVMInt64Type(), false).value;
+        LLVMValueRef first = LLVMBuildExtractValue(builder, left.value, 0, "");
+        if(options->bounds_check && !in_bounds){
+            LLVMValueRef length = LLVMBuildExtractValue(builder, left.value, 1, "");
+            check_bounds(LLVMBuildICmp(builder, LLVMIntULT, index, length, ""));
+        }
+        return_val.address = LLVMBuildInBoundsGEP2(builder, element, first, &index, 1, "");
     } else{
         // Implement Pointer Arithmetic 
         // pointer + sizeof(*pointer * index)
+        left = rvalue(left);
         LLVMValueRef int_ptr = LLVMBuildPtrToInt(builder, left.value, LLVMInt64Type(), "");
         LLVMValueRef size = LLVMSizeOf(LLVMGetElementType(LLVMTypeOf(left.value)));
         size = LLVMBuildSExtOrBitCast(builder, size, LLVMTypeOf(right.value), "");
@@ -857,8 +2023,56 @@ value_t create_index(value_t left, value_t right)
         return_val.address = LLVMBuildIntToPtr(builder, change, LLVMTypeOf(left.value), "");
     }
 
-    // Load the value from the address
-    return_val.value = LLVMBuildLoad(builder, return_val.address, "");
+    // The element is loaded when it is needed
+    return return_val;
+}
+
+value_t create_slice(value_t val, value_t *low, value_t *high){
+    // Check if the block has been terminated
+    value_t return_val;
+    return_val.address = NULL;
+    return_val.value = NULL;
+    if(FINISHED) return return_val;
+
+    // Find the first element and the length of what is sliced
+    // Pointers don't know their length, so they can only be sliced up to an explicit end
+    LLVMTypeRef i64 = LLVMInt64Type();
+    LLVMTypeRef type = value_type(val);
+    LLVMValueRef first, length = NULL;
+    if(LLVMGetTypeKind(type) == LLVMArrayTypeKind){
+        if(!val.address){
+            printf("Cannot slice a temporary array\n");
+            exit(0);
+        }
+        LLVMValueRef indices[2] = {LLVMConstInt(i64, 0, false), LLVMConstInt(i64, 0, false)};
+        first = LLVMBuildInBoundsGEP2(builder, type, val.address, indices, 2, "");
+        length = LLVMConstInt(i64, LLVMGetArrayLength(type), false);
+    } else if(get_slice_element(type)){
+        val = rvalue(val);
+        first = LLVMBuildExtractValue(builder, val.value, 0, "");
+        length = LLVMBuildExtractValue(builder, val.value, 1, "");
+    } else if(LLVMGetTypeKind(type) == LLVMPointerTypeKind && high){
+        first = rvalue(val).value;
+    } else{
+        printf("Can only slice arrays, slices and pointers with an end\n");
+        exit(0);
+    }
+
+    // The bounds default to the whole sequence, and are checked like indices
+    LLVMValueRef start = low ? cast(*low, i64, false).value : LLVMConstInt(i64, 0, false);
+    LLVMValueRef end = high ? cast(*high, i64, false).value : length;
+    if(options->bounds_check){
+        if(high && length)
+            check_bounds(LLVMBuildICmp(builder, LLVMIntULE, end, length, ""));
+        if(low)
+            check_bounds(LLVMBuildICmp(builder, LLVMIntULE, start, end, ""));
+    }
+
+    LLVMTypeRef element = LLVMGetElementType(LLVMTypeOf(first));
+    LLVMValueRef slice = LLVMGetUndef(get_slice_type(element));
+    slice = LLVMBuildInsertValue(builder, slice, LLVMBuildInBoundsGEP2(builder, element, first, &start, 1, ""), 0, "");
+    slice = LLVMBuildInsertValue(builder, slice, LLVMBuildSub(builder, end, start, ""), 1, "");
+    return_val.value = slice;
     return return_val;
 }
 
@@ -870,33 +2084,146 @@ value_t create_dot(value_t left, char* name){
     if(FINISHED) return return_val;
 
     // Make sure the LHS of the dot operator is a struct
-    LLVMTypeRef struct_type = LLVMTypeOf(left.value);
+    LLVMTypeRef struct_type = value_type(left);
     if(LLVMGetTypeKind(struct_type) != LLVMStructTypeKind){
         printf("Can only dot structs\n");
         exit(0);
     }
 
-    // Try to find the structure type in the aggregate list
-    agg_list_t *current = structs;
-    while(current){
-        if(current->type == struct_type){
-            // Try to find the field that matches the dot operator RHS
-            for(int i = 0; i<current->components.id_list.length; i++){
-                if(strcmp(name, current->components.id_list.ids[i]) == 0){
-                    // If possible, store the address of the structure as well
-                    if(left.address){
-                        return_val.address = LLVMBuildStructGEP2(builder, struct_type, left.address, i, "");
-                    }
-                    return_val.value = LLVMBuildExtractValue(builder, left.value, i, "");
-                }
-            }
-        }
-        current = current->next;
+    // Find the field that matches the dot operator RHS
+    agg_list_t *agg = get_struct(struct_type);
+    uint32_t field;
+    if(!agg || !get_index_map(&agg->fields, name, &field)){
+        printf("Couldn't find field %s\n", name);
+        exit(0);
+    }
+
+    // Fields can be moved by padding or reordering
+    uint32_t index = agg->indices[field];
+    if(left.address){
+        // Only the field is loaded (lazily) instead of the whole structure
+        return_val.address = LLVMBuildStructGEP2(builder, struct_type, left.address, index, "");
+    } else{
+        return_val.value = LLVMBuildExtractValue(builder, left.value, index, "");
     }
-    free(name);
     return return_val;
 }
 
+// Bump allocate from the newest chunk of a region, and only call the runtime when it is full
+static LLVMValueRef region_alloc(LLVMValueRef region, LLVMValueRef size, uint32_t align){
+    LLVMTypeRef i64 = LLVMInt64Type();
+    LLVMTypeRef i8_ptr = LLVMPointerType(LLVMInt8Type(), 0);
+    LLVMValueRef fn = LLVMGetBasicBlockParent(LLVMGetInsertBlock(builder));
+    LLVMValueRef next_address = LLVMBuildStructGEP2(builder, region_type, region, 1, "");
+    LLVMValueRef next = LLVMBuildLoad2(builder, i8_ptr, next_address, "");
+    LLVMValueRef end = LLVMBuildLoad2(builder, i8_ptr, LLVMBuildStructGEP2(builder, region_type, region, 2, ""), "");
+
+    // The padding that aligns the next free byte and the allocation must fit before the end
+    LLVMValueRef offset = LLVMBuildPtrToInt(builder, next, i64, "");
+    LLVMValueRef padding = LLVMBuildAnd(builder, LLVMBuildNeg(builder, offset, ""), LLVMConstInt(i64, align - 1, false), "");
+    LLVMValueRef needed = LLVMBuildAdd(builder, padding, size, "");
+    LLVMValueRef available = LLVMBuildSub(builder, LLVMBuildPtrToInt(builder, end, i64, ""), offset, "");
+    LLVMValueRef fits = LLVMBuildICmp(builder, LLVMIntULE, needed, available, "");
+    LLVMBasicBlockRef bump = LLVMAppendBasicBlock(fn, "");
+    LLVMBasicBlockRef grow = LLVMAppendBasicBlock(fn, "");
+    LLVMBasicBlockRef done = LLVMAppendBasicBlock(fn, "");
+    LLVMBuildCondBr(builder, fits, bump, grow);
+
+    LLVMPositionBuilderAtEnd(builder, bump);
+    LLVMTypeRef i8 = LLVMInt8Type();
+    LLVMValueRef bumped = LLVMBuildGEP2(builder, i8, next, &padding, 1, "");
+    LLVMBuildStore(builder, LLVMBuildGEP2(builder, i8, next, &needed, 1, ""), next_address);
+    LLVMBuildBr(builder, done);
+
+    LLVMPositionBuilderAtEnd(builder, grow);
+    LLVMTypeRef params[3] = {i8_ptr, i64, i64};
+    LLVMValueRef args[3] = {LLVMBuildBitCast(builder, region, i8_ptr, ""), size, LLVMConstInt(i64, align, false)};
+    LLVMValueRef alloc = get_runtime_function("__region_alloc", i8_ptr, params, 3);
+    LLVMValueRef grown = LLVMBuildCall2(builder, LLVMGlobalGetValueType(alloc), alloc, args, 3, "");
+    LLVMBuildBr(builder, done);
+
+    LLVMPositionBuilderAtEnd(builder, done);
+    LLVMValueRef memory = LLVMBuildPhi(builder, i8_ptr, "");
+    LLVMValueRef incoming[2] = {bumped, grown};
+    LLVMBasicBlockRef blocks[2] = {bump, grow};
+    LLVMAddIncoming(memory, incoming, blocks, 2);
+    return memory;
+}
+
+// Take the first item of the free list of a pool, and only call the runtime when it is empty
+static LLVMValueRef pool_alloc(LLVMValueRef pool){
+    LLVMTypeRef i8_ptr = LLVMPointerType(LLVMInt8Type(), 0);
+    LLVMValueRef fn = LLVMGetBasicBlockParent(LLVMGetInsertBlock(builder));
+    LLVMTypeRef type = LLVMGetElementType(LLVMTypeOf(pool));
+    LLVMValueRef free_address = LLVMBuildStructGEP2(builder, type, pool, 0, "");
+    LLVMValueRef item = LLVMBuildLoad2(builder, i8_ptr, free_address, "");
+    LLVMBasicBlockRef reuse = LLVMAppendBasicBlock(fn, "");
+    LLVMBasicBlockRef grow = LLVMAppendBasicBlock(fn, "");
+    LLVMBasicBlockRef done = LLVMAppendBasicBlock(fn, "");
+    LLVMBuildCondBr(builder, LLVMBuildIsNull(builder, item, ""), grow, reuse);
+
+    // Free items store the next free item in their first bytes
+    LLVMPositionBuilderAtEnd(builder, reuse);
+    LLVMValueRef link = LLVMBuildBitCast(builder, item, LLVMPointerType(i8_ptr, 0), "");
+    LLVMBuildStore(builder, LLVMBuildLoad2(builder, i8_ptr, link, ""), free_address);
+    LLVMBuildBr(builder, done);
+
+    LLVMPositionBuilderAtEnd(builder, grow);
+    LLVMValueRef arg = LLVMBuildBitCast(builder, pool, i8_ptr, "");
+    LLVMValueRef alloc = get_runtime_function("__pool_alloc", i8_ptr, &i8_ptr, 1);
+    LLVMValueRef grown = LLVMBuildCall2(builder, LLVMGlobalGetValueType(alloc), alloc, &arg, 1, "");
+    LLVMBuildBr(builder, done);
+
+    LLVMPositionBuilderAtEnd(builder, done);
+    LLVMValueRef memory = LLVMBuildPhi(builder, i8_ptr, "");
+    LLVMValueRef incoming[2] = {item, grown};
+    LLVMBasicBlockRef blocks[2] = {reuse, grow};
+    LLVMAddIncoming(memory, incoming, blocks, 2);
+    return memory;
+}
+
+value_t create_new(LLVMTypeRef type, value_t *count, value_t *allocator){
+    value_t return_val;
+    return_val.address = NULL;
+    return_val.value = NULL;
+    if(FINISHED) return return_val;
+
+    // Allocations are sized with sizeof(), and are not initialized
+    LLVMTypeRef i64 = LLVMInt64Type();
+    LLVMTypeRef i8_ptr = LLVMPointerType(LLVMInt8Type(), 0);
+    LLVMValueRef size = create_sizeof(type).value;
+    if(count)
+        size = LLVMBuildMul(builder, size, cast(*count, i64, false).value, "");
+    LLVMValueRef memory;
+    if(!allocator){
+        LLVMValueRef alloc = get_runtime_function("__new", i8_ptr, &i64, 1);
+        memory = LLVMBuildCall2(builder, LLVMGlobalGetValueType(alloc), alloc, &size, 1, "");
+    } else if(get_pool_element(value_type(*allocator)))
+        memory = pool_alloc(allocator->address);
+    else
+        memory = region_alloc(allocator->address, size, type_alignment(type));
+    return_val.value = LLVMBuildBitCast(builder, memory, LLVMPointerType(type, 0), "");
+    return return_val;
+}
+
+void create_delete(value_t pointer, value_t *pool){
+    if(FINISHED) return;
+    LLVMTypeRef i8_ptr = LLVMPointerType(LLVMInt8Type(), 0);
+    LLVMValueRef item = LLVMBuildBitCast(builder, rvalue(pointer).value, i8_ptr, "");
+    if(!pool){
+        LLVMValueRef release = get_runtime_function("__delete", LLVMVoidType(), &i8_ptr, 1);
+        LLVMBuildCall2(builder, LLVMGlobalGetValueType(release), release, &item, 1, "");
+        return;
+    }
+
+    // Push the item onto the free list of the pool
+    LLVMTypeRef type = value_type(*pool);
+    LLVMValueRef free_address = LLVMBuildStructGEP2(builder, type, pool->address, 0, "");
+    LLVMValueRef link = LLVMBuildBitCast(builder, item, LLVMPointerType(i8_ptr, 0), "");
+    LLVMBuildStore(builder, LLVMBuildLoad2(builder, i8_ptr, free_address, ""), link);
+    LLVMBuildStore(builder, item, free_address);
+}
+
 value_t create_sizeof(LLVMTypeRef type){
     // Check if the block has been terminated
     value_t return_val;
@@ -909,27 +2236,96 @@ value_t create_sizeof(LLVMTypeRef type){
     return return_val;
 }
 
-void generate(char* llvm_dir, char* input_file, char* output_file, int scheck, int rcheck){
+void generate_initialize(){
+    // Target the host so that struct layouts match C
+    if(target_machine) return;
+    char* LLVMError;
+    LLVMInitializeNativeTarget();
+    LLVMInitializeNativeAsmPrinter();
+    target_triple = LLVMGetDefaultTargetTriple();
+    LLVMTargetRef target;
+    if(LLVMGetTargetFromTriple(target_triple, &target, &LLVMError)){
+        printf("%s\n", LLVMError);
+        exit(0);
+    }
+    target_machine = LLVMCreateTargetMachine(target, target_triple, "", "", LLVMCodeGenLevelDefault, LLVMRelocDefault, LLVMCodeModelDefault);
+    target_data = LLVMCreateTargetDataLayout(target_machine);
+}
+
+// Run the standard LLVM pipeline for the level of -O, like opt does
+static void optimize_module(){
+    LLVMPassManagerBuilderRef pass_builder = LLVMPassManagerBuilderCreate();
+    LLVMPassManagerBuilderSetOptLevel(pass_builder, options->opt_level);
+    if(options->opt_level > 1)
+        LLVMPassManagerBuilderUseInlinerWithThreshold(pass_builder, options->opt_level > 2 ? 250 : 225);
+    LLVMPassManagerRef function_passes = LLVMCreateFunctionPassManagerForModule(module);
+    LLVMPassManagerRef module_passes = LLVMCreatePassManager();
+
+    // Cost models of the inliner and vectorizers come from the target
+    LLVMAddAnalysisPasses(target_machine, function_passes);
+    LLVMAddAnalysisPasses(target_machine, module_passes);
+    LLVMPassManagerBuilderPopulateFunctionPassManager(pass_builder, function_passes);
+    LLVMPassManagerBuilderPopulateModulePassManager(pass_builder, module_passes);
+    LLVMInitializeFunctionPassManager(function_passes);
+    for(LLVMValueRef fn = LLVMGetFirstFunction(module); fn; fn = LLVMGetNextFunction(fn))
+        LLVMRunFunctionPassManager(function_passes, fn);
+    LLVMFinalizeFunctionPassManager(function_passes);
+    LLVMRunPassManager(module_passes, module);
+    LLVMDisposePassManager(function_passes);
+    LLVMDisposePassManager(module_passes);
+    LLVMPassManagerBuilderDispose(pass_builder);
+}
+
+// -O also sets the level of the code generator, which needs a target machine of its own
+static LLVMTargetMachineRef level_machine(){
+    if(options->opt_level < 0) return target_machine;
+    LLVMCodeGenOptLevel levels[4] = {LLVMCodeGenLevelNone, LLVMCodeGenLevelLess, LLVMCodeGenLevelDefault, LLVMCodeGenLevelAggressive};
+    return LLVMCreateTargetMachine(LLVMGetTargetMachineTarget(target_machine), target_triple, "", "",
+        levels[options->opt_level], LLVMRelocDefault, LLVMCodeModelDefault);
+}
+
+void generate(char* llvm_dir, char* input_file, char* output_file, options_t *opts){
     // Keep track of LLVM errors
     char* LLVMError;
+    options = opts;
 
     // Create the LLVM Module and Instruction Builder
     module = LLVMModuleCreateWithName("");
     builder = LLVMCreateBuilder();
-
-    // Create global scope
-    create_scope();
-
-    // Start tokenizing and parsing
-    yyin = fopen(input_file, "r");
-    if(!yyin){
+    generate_initialize();
+    LLVMSetTarget(module, target_triple);
+    LLVMSetModuleDataLayout(module, target_data);
+    abi_initialize(target_data, target_triple);
+
+    // Describe the source file if debug info was requested
+    if(options->debug)
+        debug_initialize(module, builder, target_data, input_file);
+    if(options->coverage)
+        coverage_initialize(module, builder, input_file);
+    if(options->stats)
+        stats_initialize(module, builder, options->stats);
+    comptime_initialize(module, builder, target_data, options->comptime_seconds, options->comptime_megabytes);
+
+    // Parse the whole program into an AST
+    if(!lexer_open(input_file, options->simd_lexer, options->lexer_thread)){
         printf("Invalid source file!\n");
         exit(0);
     }
-    yyparse();
+    if(options->tokens){
+        lexer_dump(options->tokens);
+        return;
+    }
+    if(yyparse()) exit(0);
 
-    // End global scope
+    // Check the program, then generate code in the global scope
+    sema_program(ast_program);
+    // Compile-time code runs last, since it can call any const function and use the coverage counters
+    create_scope();
+    codegen_program(ast_program);
+    coverage_finalize();
+    codegen_comptime();
     finish_scope();
+    debug_finalize();
 
     // Verify that LLVM IR is correct
     LLVMVerifyModule(module, LLVMPrintMessageAction, &LLVMError);
@@ -937,21 +2333,41 @@ void generate(char* llvm_dir, char* input_file, char* output_file, int scheck, i
         LLVMDisposeMessage(LLVMError);
         LLVMError = NULL;
     }
-    
+    stats_count(false);
+    if(options->opt_level >= 0){
+        optimize_module();
+        stats_count(true);
+    }
+    LLVMTargetMachineRef machine = level_machine();
+    stats_finalize(machine);
+
     // Write LLVM IR/Bitcode to the correct files
-    if(rcheck){
+    if(options->rcheck){
         LLVMPrintModuleToFile(module, output_file, &LLVMError);
         if(LLVMError){ 
             LLVMDisposeMessage(LLVMError);
             LLVMError = NULL;
         }
+    } else if(options->in_process){
+        // Workers of a compile server already have the target, so they don't need to start llc
+        LLVMCodeGenFileType file_type = options->scheck ? LLVMAssemblyFile : LLVMObjectFile;
+        if(LLVMTargetMachineEmitToFile(machine, module, output_file, file_type, &LLVMError)){
+            printf("%s\n", LLVMError);
+            LLVMDisposeMessage(LLVMError);
+            LLVMError = NULL;
+        }
     } else{
-        // Create temporary bitcode
-        LLVMWriteBitcodeToFile(module, "temp.bc");
+        // Create temporary bitcode next to the output, so that compiles running at once don't share it
+        char* temp = malloc(strlen(output_file) + 9);
+        sprintf(temp, "%s.temp.bc", output_file);
+        LLVMWriteBitcodeToFile(module, temp);
 
         // Call llc command 
-        strcat(llvm_dir, "/llc temp.bc ");
-        if(scheck) {
+        strcat(llvm_dir, "/llc ");
+        strcat(llvm_dir, temp);
+        if(options->opt_level >= 0)
+            sprintf(llvm_dir + strlen(llvm_dir), " -O%d", options->opt_level);
+        if(options->scheck) {
             strcat(llvm_dir, " --filetype=asm -o ");
         } else {
             strcat(llvm_dir, " --filetype=obj -o ");
@@ -961,10 +2377,14 @@ void generate(char* llvm_dir, char* input_file, char* output_file, int scheck, i
         system(llvm_dir);
         
         // Delete temporary bitcode file
-        remove("temp.bc");
+        remove(temp);
+        free(temp);
     }
     
     // Cleanup
+    if(machine != target_machine)
+        LLVMDisposeTargetMachine(machine);
+    ast_free_all();
     LLVMDisposeBuilder(builder);
     LLVMDisposeModule(module);
 }
\ No newline at end of file
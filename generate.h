@@ -5,8 +5,16 @@
 #include <llvm-c/Core.h>
 #include <llvm-c/BitWriter.h>
 #include <llvm-c/Analysis.h>
+#include <llvm-c/Target.h>
+#include <llvm-c/TargetMachine.h>
+#include "ast.h"
 #include "parse.h"
 #include "table.h"  
+#include "debug.h"
+#include "coverage.h"
+#include "stats.h"
+#include "llvm_ext.h"
+#include "abi.h"
 
 // Store state of each conditional
 typedef struct cond_stack {
@@ -16,15 +24,58 @@ typedef struct cond_stack {
     bool eliminate_done;
 } cond_stack_t;
 
+// Store each region or pool that is freed when its scope ends
+typedef struct allocator_stack {
+    struct allocator_stack *prev;
+    LLVMValueRef address;
+    bool is_pool;
+    table_t *scope;
+} allocator_stack_t;
+
 // Store state of each loop
+// Switches are also kept on this stack so that break can leave them
 typedef struct loop_stack {
     struct loop_stack *prev;
     char* label;
     LLVMBasicBlockRef condition;
-    LLVMBasicBlockRef body;
+    LLVMBasicBlockRef body;     // For switches, the target of the default case
     LLVMBasicBlockRef end;
+    LLVMValueRef dispatch;      // The switch instruction (NULL for loops)
+    LLVMBasicBlockRef header;   // Where a for loop compares its counter with the length
+    LLVMValueRef index;         // Counter of a for loop, which its condition block increments
+    allocator_stack_t *allocators; // Regions and pools from outside the loop, which break and continue keep
 } loop_stack_t;
 
+// Store a variable that the body of a parallel loop uses from the function around it
+// Reductions get a private copy in every chunk that is combined into the shared variable at the end
+typedef struct capture {
+    char* name;
+    LLVMTypeRef type;
+    operation_t op;
+    bool is_reduction;
+    bool is_byref;
+    LLVMValueRef shared;    // Address of the shared variable inside the outlined body
+    LLVMValueRef private;   // Address of the private copy of a reduction
+} capture_t;
+
+// Store state of each parallel loop
+// The body is generated in an outlined function, then the function around it continues
+typedef struct parallel_stack {
+    struct parallel_stack *prev;
+    LLVMValueRef function;
+    LLVMValueRef env;       // Structure of captured addresses in the function around the loop
+    LLVMValueRef start;
+    LLVMValueRef end;
+    capture_t *captures;
+    uint32_t count;
+    LLVMBasicBlockRef block;
+    table_t *symbol_table;
+    cond_stack_t *cond;
+    loop_stack_t *loop;
+    allocator_stack_t *allocator;
+    abi_function_t *abi;
+} parallel_stack_t;
+
 // Store each typedef
 typedef struct type_list {
     struct type_list *next;
@@ -33,49 +84,132 @@ typedef struct type_list {
 } type_list_t;
 
 // Store information for each structure
+// Structures are kept in a hash table keyed by their LLVM type
 typedef struct agg_list {
     struct agg_list *next;
     LLVMTypeRef type;
     type_id_list_t components;
+    index_map_t fields; // Component name -> component number
+    uint32_t *indices;  // LLVM element index of each component
+    uint32_t align;     // Alignment of the whole structure
+    bool packed;
 } agg_list_t;
 
-// Different Types of Operations
-typedef enum operation{
-    OP_ADD,
-    OP_SUB,
-    OP_MUL,
-    OP_DIV,
-    OP_MOD,
-    OP_BIT_AND,
-    OP_BIT_OR,
-    OP_BIT_XOR,
-    OP_BIT_NOT,
-    OP_LSHIFT,
-    OP_RSHIFT,
-    OP_BOOL_AND,
-    OP_BOOL_OR,
-    OP_BOOL_NOT,
-    OP_LESS,
-    OP_LEQ,
-    OP_GREATER,
-    OP_GEQ,
-    OP_EQ,
-    OP_NEQ 
-} operation_t;
+// Store the pool type of each element type
+typedef struct pool_list {
+    struct pool_list *next;
+    LLVMTypeRef element;
+    LLVMTypeRef type;
+} pool_list_t;
+
+// Store the slice type of each element type
+typedef struct slice_list {
+    struct slice_list *next;
+    LLVMTypeRef element;
+    LLVMTypeRef type;
+} slice_list_t;
+
+// Store the global of each string literal, so that identical literals share it
+typedef struct string_list {
+    struct string_list *next;
+    char* str;
+    LLVMValueRef global;
+} string_list_t;
+
+// Command line options that affect code generation
+typedef struct options {
+    int scheck;
+    int rcheck;
+    bool dump_layout;
+    bool reorder_fields;
+    bool debug;
+    bool instrument_functions;
+    bool coverage;
+    bool bounds_check;  // Trap on array indices outside of [N]T, unless sema proved them in bounds
+    bool in_process;    // Emit objects with the target machine instead of starting llc
+    int opt_level;      // Level of -O, or -1 to only let llc optimize at its default level
+    uint32_t comptime_seconds;      // Limits on evaluating comptime expressions
+    uint32_t comptime_megabytes;
+    char* stats;        // File to write IR and code size statistics to, as JSON
+    bool simd_lexer;    // Lex with the hand-written lexer instead of flex
+    char* tokens;       // File to list the tokens in, instead of compiling
+    bool lexer_thread;  // Lex on another thread, while the parser builds the AST
+} options_t;
+
+// Whether a returned call can reuse the stack frame of its caller
+typedef enum tail_call {
+    TAIL_NONE,
+    TAIL_ALLOWED,
+    TAIL_REQUIRED
+} tail_call_t;
+
+// Built-in functions that are lowered to LLVM intrinsics
+typedef enum builtin {
+    BUILTIN_MEMCPY,
+    BUILTIN_MEMMOVE,
+    BUILTIN_MEMSET,
+    BUILTIN_SQRT,
+    BUILTIN_FMA,
+    BUILTIN_FABS,
+    BUILTIN_MIN,
+    BUILTIN_MAX,
+    BUILTIN_CTPOP,
+    BUILTIN_CTLZ,
+    BUILTIN_CTTZ,
+    BUILTIN_BSWAP,
+    BUILTIN_PREFETCH,
+    BUILTIN_EXPECT,
+    BUILTIN_LIKELY,
+    BUILTIN_UNLIKELY,
+    BUILTIN_ASSUME,
+    BUILTIN_ATOMIC_LOAD,
+    BUILTIN_ATOMIC_STORE,
+    BUILTIN_ATOMIC_CAS,
+    BUILTIN_ATOMIC_EXCHANGE,
+    BUILTIN_ATOMIC_ADD,
+    BUILTIN_ATOMIC_SUB,
+    BUILTIN_ATOMIC_AND,
+    BUILTIN_ATOMIC_OR,
+    BUILTIN_ATOMIC_XOR,
+    BUILTIN_FENCE
+} builtin_t;
 
 // Create a struct type
-void create_struct(char* name, type_id_list_t *content);
+void create_struct(char* name, struct_def_t *def);
+
+// Look up the information of a struct type
+agg_list_t *get_struct(LLVMTypeRef type);
+
+// Get the alignment of a type (including explicitly aligned structs)
+uint32_t type_alignment(LLVMTypeRef type);
 
 // Create/find type defintions
 void create_type(char* name, LLVMTypeRef type);
 LLVMTypeRef get_type(char* name, bool error);
 
+// Get the type of regions, or of the pools of an element type
+LLVMTypeRef get_region_type();
+LLVMTypeRef get_pool_type(LLVMTypeRef element);
+LLVMTypeRef get_slice_type(LLVMTypeRef element);
+LLVMTypeRef get_slice_element(LLVMTypeRef type);
+
+// Get the element type of a pool type, or NULL for any other type
+LLVMTypeRef get_pool_element(LLVMTypeRef type);
+
+// Check whether a type is a region or pool
+bool is_allocator(LLVMTypeRef type);
+
+// Declare a function from the runtime library
+LLVMValueRef get_runtime_function(char* name, LLVMTypeRef return_type, LLVMTypeRef *params, unsigned count);
+
 // Create/finish function declarations
 void create_function(char* name, LLVMTypeRef return_type, arg_def_t *args, bool is_definition);
 void finish_function();
 
 // Create local/global variable declarations
-void create_declaration(LLVMTypeRef type, value_id_list_t *list, bool is_local);
+// Globals can be thread-local or constant, and local regions and pools are freed when their scope ends
+// Globals without an initializer start as zero
+void create_declaration(LLVMTypeRef type, value_id_list_t *list, bool is_local, bool is_thread_local, bool is_constant);
 
 // Create/end each variable scope
 void create_scope();
@@ -90,10 +224,34 @@ void finish_if();
 void create_while(char* label);
 void create_while_condition(value_t condition);
 void finish_while();
+void create_for(char* label, char* name, value_t sequence);
+void finish_for();
+
+// Create/end each parallel loop
+// The runtime calls the outlined body with chunks of [start, end) on a pool of threads
+void create_parallel(char* index, value_t start, value_t end, capture_t *captures, uint32_t count);
+void finish_parallel();
+
+// Create/end each switch
+// Cases fall through to the next case unless they break
+void create_switch(value_t value, char* label, bool has_default);
+void create_case();
+void add_case_range(int64_t low, int64_t high);
+void create_default();
+void finish_switch();
 
 // Create break/continue statement
 void create_break_continue(char* label, bool is_break);
-void create_return(value_t val);
+
+// Create return statement
+// A returned call can be marked as a tail call, or required to be one
+void create_return(value_t val, tail_call_t tail);
+
+// Get the type of a value, even if it hasn't been loaded yet
+LLVMTypeRef value_type(value_t val);
+
+// Load a value from its address if it is only an lvalue so far
+value_t rvalue(value_t val);
 
 // Check if a value is truthy
 value_t truthy(value_t val);
@@ -103,15 +261,23 @@ value_t cast(value_t val, LLVMTypeRef type, bool is_explicit);
 LLVMTypeRef implicit_cast(value_t lhs, value_t rhs, value_t *l_cast, value_t *r_cast);
 
 // Create constants of different types
-value_t create_int_constant(int64_t val);
-value_t create_fp_constant(double val);
+value_t create_int_constant(int64_t val, LLVMTypeRef type);
+value_t create_fp_constant(double val, LLVMTypeRef type);
 value_t create_string_constant(char* str);
 
+// Create an array or structure from its elements or fields in source order, where missing values are zero
+// Initializers that are constant become constants, which locals copy from read-only data
+value_t create_initializer(LLVMTypeRef type, value_t *values, unsigned count);
+
 // Create an assignment
 value_t create_assignment(value_t left, value_t right);
 
-// Create a function call
-value_t create_call(value_t function, parse_list_t values);
+// Create a function call, lowering the arguments and return value for the C ABI
+// Aggregate arguments can be passed as lvalues so that byval doesn't need another copy
+value_t create_call(value_t function, value_t *values, unsigned count);
+
+// Call a built-in function with the arguments and result type checked by sema
+value_t create_builtin(builtin_t builtin, value_t *args, unsigned count, LLVMTypeRef type);
 
 // Arithmetic Operators
 value_t create_math_binop(value_t left, value_t right, operation_t op);
@@ -133,18 +299,29 @@ value_t create_ref(value_t val);
 value_t create_deref(value_t left);
 
 // Indexing Operator
-value_t create_index(value_t left, value_t right);
+value_t create_index(value_t left, value_t right, bool in_bounds);
+value_t create_slice(value_t val, value_t *low, value_t *high);
 
 // Dot Operator
 value_t create_dot(value_t left, char* name);
 
+// Allocate one value, or count values, from a region, a pool, or the heap (NULL)
+value_t create_new(LLVMTypeRef type, value_t *count, value_t *allocator);
+
+// Free a value to a pool, or to the heap (NULL)
+void create_delete(value_t pointer, value_t *pool);
+
 // sizeof() operator
 value_t create_sizeof(LLVMTypeRef type);
 
 // Look up identifier in the symbol table
 value_t get_identifier(char* id);
 
+// Initialize the target once per process
+// A compile server does this before forking its workers, which then reuse it
+void generate_initialize();
+
 // Generate LLVM Code
-void generate(char* llvm_dir, char* input_file, char* output_file, int scheck, int rcheck);
+void generate(char* llvm_dir, char* input_file, char* output_file, options_t *opts);
 
 #endif
\ No newline at end of file
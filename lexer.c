@@ -0,0 +1,684 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <llvm-c/Core.h>
+#include "bison.tab.h"
+#include "flex.l.h"
+#include "table.h"
+#include "lexer.h"
+#ifdef __SSE2__
+#include <immintrin.h>
+#endif
+
+// Store the value and location of the last token, which lexer_token() gives to the parser
+// flex.l writes them instead of yylval and yylloc, so that it can run on another thread
+YYSTYPE lexer_value;
+YYLTYPE lexer_location;
+
+// Store the source and the state of the hand-written lexer
+bool lexer_simd = false;
+bool lexer_avx2 = false;
+char* lexer_source;
+char* lexer_end;
+char* lexer_position;
+size_t lexer_size;
+int lexer_line = 1;
+int lexer_column = 1;
+
+// Interned names, so that each identifier is allocated once however often it appears
+// Only the thread that lexes uses the table, and the names are never freed
+char** intern_table;
+uint32_t intern_capacity;
+uint32_t intern_count;
+
+char* lexer_intern(const char* name, size_t length){
+    // Keep the table at most half full, so that probes stay short
+    if(intern_count * 2 >= intern_capacity){
+        uint32_t capacity = intern_capacity ? intern_capacity * 2 : 1024;
+        char** table = calloc(capacity, sizeof(char*));
+        for(uint32_t i = 0; i<intern_capacity; i++){
+            if(!intern_table[i]) continue;
+            uint32_t bucket = hash_name(intern_table[i]) & (capacity - 1);
+            while(table[bucket]) bucket = (bucket + 1) & (capacity - 1);
+            table[bucket] = intern_table[i];
+        }
+        free(intern_table);
+        intern_table = table;
+        intern_capacity = capacity;
+    }
+
+    uint32_t bucket = hash_name_length(name, length) & (intern_capacity - 1);
+    while(intern_table[bucket]){
+        if(strncmp(intern_table[bucket], name, length) == 0 && intern_table[bucket][length] == 0)
+            return intern_table[bucket];
+        bucket = (bucket + 1) & (intern_capacity - 1);
+    }
+    intern_count++;
+    return intern_table[bucket] = strndup(name, length);
+}
+
+// Every rule of flex.l that is a name, in the same order
+static keyword_t keywords[] = {
+    {"bool", BOOL, 0}, {"i8", I8, 0}, {"i16", I16, 0}, {"i32", I32, 0}, {"i64", I64, 0},
+    {"f32", F32, 0}, {"f64", F64, 0}, {"struct", STRUCT, 0}, {"packed", PACKED, 0},
+    {"align", ALIGN, 0}, {"reorder", REORDER, 0}, {"if", IF, 0}, {"else", ELSE, 0},
+    {"while", WHILE, 0}, {"switch", SWITCH, 0}, {"case", CASE, 0}, {"default", DEFAULT, 0},
+    {"break", BREAK, 0}, {"continue", CONTINUE, 0}, {"return", RETURN, 0}, {"tail", TAIL, 0},
+    {"typedef", TYPEDEF, 0}, {"as", AS, 0}, {"fn", FN, 0}, {"const", CONST, 0},
+    {"comptime", COMPTIME, 0}, {"decl", DECL, 0}, {"threadlocal", THREADLOCAL, 0},
+    {"parallel", PARALLEL, 0}, {"for", FOR, 0}, {"reduce", REDUCE, 0}, {"region", REGION, 0},
+    {"pool", POOL, 0}, {"new", NEW, 0}, {"delete", DELETE, 0}, {"in", IN, 0},
+    {"sizeof", SIZEOF, 0}, {"null", INT_LITERAL, 0}, {"false", INT_LITERAL, 0}, {"true", INT_LITERAL, 1}
+};
+#define KEYWORD_COUNT (sizeof(keywords) / sizeof(keyword_t))
+
+// Number of buckets in the keyword hash table
+#define KEYWORD_BUCKETS 128
+keyword_t *keyword_table[KEYWORD_BUCKETS];
+
+// Perfect hash of the keywords, which mixes the length with the first two and last two characters
+// The multiplier was found by a search, so that every keyword gets a bucket of its own
+static uint32_t keyword_hash(const char* name, size_t length){
+    uint64_t key = (uint64_t)(unsigned char)name[0] | (uint64_t)(unsigned char)name[1] << 8
+        | (uint64_t)(unsigned char)name[length - 2] << 16 | (uint64_t)(unsigned char)name[length - 1] << 24
+        | (uint64_t)length << 32;
+    return (key * 0x0deb5f364c2569c5ULL) >> 57;
+}
+
+static void keyword_initialize(){
+    for(uint32_t i = 0; i<KEYWORD_COUNT; i++){
+        uint32_t bucket = keyword_hash(keywords[i].name, strlen(keywords[i].name));
+        if(keyword_table[bucket]){
+            printf("Keywords %s and %s have the same hash\n", keyword_table[bucket]->name, keywords[i].name);
+            exit(0);
+        }
+        keyword_table[bucket] = &keywords[i];
+    }
+}
+
+// Read the whole file, followed by zeros that stop every scan
+static bool simd_open(char* input_file){
+    FILE *fp = fopen(input_file, "r");
+    if(!fp) return false;
+    fseek(fp, 0, SEEK_END);
+    lexer_size = ftell(fp);
+    fseek(fp, 0, SEEK_SET);
+    lexer_source = malloc(lexer_size + LEXER_PADDING);
+    if(fread(lexer_source, 1, lexer_size, fp) != lexer_size){
+        fclose(fp);
+        return false;
+    }
+    fclose(fp);
+    memset(lexer_source + lexer_size, 0, LEXER_PADDING);
+    lexer_end = lexer_source + lexer_size;
+    lexer_position = lexer_source;
+    keyword_initialize();
+#ifdef __SSE2__
+    lexer_avx2 = __builtin_cpu_supports("avx2");
+#endif
+    return true;
+}
+
+static bool is_digit(char c){
+    return c >= '0' && c <= '9';
+}
+
+static bool is_word(char c){
+    return is_digit(c) || (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_';
+}
+
+#ifdef __SSE2__
+// Find the bytes of a class in a block of 16 bytes, or 32 with AVX2, as a bit mask
+// Bytes above 127 are negative in the signed comparisons, so they are never in a range
+static uint32_t space_mask_sse2(const char* p){
+    __m128i block = _mm_loadu_si128((const __m128i*)p);
+    __m128i space = _mm_or_si128(
+        _mm_or_si128(_mm_cmpeq_epi8(block, _mm_set1_epi8(' ')), _mm_cmpeq_epi8(block, _mm_set1_epi8('\t'))),
+        _mm_or_si128(_mm_cmpeq_epi8(block, _mm_set1_epi8('\r')), _mm_cmpeq_epi8(block, _mm_set1_epi8('\n'))));
+    return _mm_movemask_epi8(space);
+}
+
+// Setting 0x20 makes upper case letters lower case, and keeps every other byte out of a-z
+static uint32_t word_mask_sse2(const char* p){
+    __m128i block = _mm_loadu_si128((const __m128i*)p);
+    __m128i lower = _mm_or_si128(block, _mm_set1_epi8(0x20));
+    __m128i letter = _mm_and_si128(_mm_cmpgt_epi8(lower, _mm_set1_epi8('a' - 1)), _mm_cmplt_epi8(lower, _mm_set1_epi8('z' + 1)));
+    __m128i digit = _mm_and_si128(_mm_cmpgt_epi8(block, _mm_set1_epi8('0' - 1)), _mm_cmplt_epi8(block, _mm_set1_epi8('9' + 1)));
+    __m128i word = _mm_or_si128(_mm_or_si128(letter, digit), _mm_cmpeq_epi8(block, _mm_set1_epi8('_')));
+    return _mm_movemask_epi8(word);
+}
+
+// Zero bytes are always found, since the source is followed by them
+static uint32_t byte_mask_sse2(const char* p, char first, char second){
+    __m128i block = _mm_loadu_si128((const __m128i*)p);
+    __m128i found = _mm_or_si128(
+        _mm_or_si128(_mm_cmpeq_epi8(block, _mm_set1_epi8(first)), _mm_cmpeq_epi8(block, _mm_set1_epi8(second))),
+        _mm_cmpeq_epi8(block, _mm_setzero_si128()));
+    return _mm_movemask_epi8(found);
+}
+
+__attribute__((target("avx2")))
+static uint32_t space_mask_avx2(const char* p){
+    __m256i block = _mm256_loadu_si256((const __m256i*)p);
+    __m256i space = _mm256_or_si256(
+        _mm256_or_si256(_mm256_cmpeq_epi8(block, _mm256_set1_epi8(' ')), _mm256_cmpeq_epi8(block, _mm256_set1_epi8('\t'))),
+        _mm256_or_si256(_mm256_cmpeq_epi8(block, _mm256_set1_epi8('\r')), _mm256_cmpeq_epi8(block, _mm256_set1_epi8('\n'))));
+    return _mm256_movemask_epi8(space);
+}
+
+__attribute__((target("avx2")))
+static uint32_t word_mask_avx2(const char* p){
+    __m256i block = _mm256_loadu_si256((const __m256i*)p);
+    __m256i lower = _mm256_or_si256(block, _mm256_set1_epi8(0x20));
+    __m256i letter = _mm256_and_si256(_mm256_cmpgt_epi8(lower, _mm256_set1_epi8('a' - 1)), _mm256_cmpgt_epi8(_mm256_set1_epi8('z' + 1), lower));
+    __m256i digit = _mm256_and_si256(_mm256_cmpgt_epi8(block, _mm256_set1_epi8('0' - 1)), _mm256_cmpgt_epi8(_mm256_set1_epi8('9' + 1), block));
+    __m256i word = _mm256_or_si256(_mm256_or_si256(letter, digit), _mm256_cmpeq_epi8(block, _mm256_set1_epi8('_')));
+    return _mm256_movemask_epi8(word);
+}
+
+__attribute__((target("avx2")))
+static uint32_t byte_mask_avx2(const char* p, char first, char second){
+    __m256i block = _mm256_loadu_si256((const __m256i*)p);
+    __m256i found = _mm256_or_si256(
+        _mm256_or_si256(_mm256_cmpeq_epi8(block, _mm256_set1_epi8(first)), _mm256_cmpeq_epi8(block, _mm256_set1_epi8(second))),
+        _mm256_cmpeq_epi8(block, _mm256_setzero_si256()));
+    return _mm256_movemask_epi8(found);
+}
+
+__attribute__((target("avx2")))
+static int count_newlines_avx2(const char* p, const char* end){
+    int count = 0;
+    for(; p + 32 <= end; p += 32)
+        count += __builtin_popcount(_mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i*)p), _mm256_set1_epi8('\n'))));
+    for(; p < end; p++)
+        count += *p == '\n';
+    return count;
+}
+
+// Find the first byte that isn't whitespace
+static char* skip_space(char* p){
+    uint32_t mask;
+    if(lexer_avx2){
+        while((mask = ~space_mask_avx2(p)) == 0) p += 32;
+    } else{
+        while((mask = ~space_mask_sse2(p) & 0xFFFF) == 0) p += 16;
+    }
+    return p + __builtin_ctz(mask);
+}
+
+// Find the first byte that can't be part of an identifier
+static char* skip_word(char* p){
+    uint32_t mask;
+    if(lexer_avx2){
+        while((mask = ~word_mask_avx2(p)) == 0) p += 32;
+    } else{
+        while((mask = ~word_mask_sse2(p) & 0xFFFF) == 0) p += 16;
+    }
+    return p + __builtin_ctz(mask);
+}
+
+// Find the first of two bytes, or a zero byte
+static char* find_byte(char* p, char first, char second){
+    uint32_t mask;
+    if(lexer_avx2){
+        while((mask = byte_mask_avx2(p, first, second)) == 0) p += 32;
+    } else{
+        while((mask = byte_mask_sse2(p, first, second)) == 0) p += 16;
+    }
+    return p + __builtin_ctz(mask);
+}
+
+// Count the line feeds in a range, which is how flex counts lines
+static int count_newlines(const char* p, const char* end){
+    if(lexer_avx2) return count_newlines_avx2(p, end);
+    int count = 0;
+    for(; p + 16 <= end; p += 16)
+        count += __builtin_popcount(_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)p), _mm_set1_epi8('\n'))));
+    for(; p < end; p++)
+        count += *p == '\n';
+    return count;
+}
+#else
+// Without SSE2, the same scans go one byte at a time
+static char* skip_space(char* p){
+    while(*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n') p++;
+    return p;
+}
+
+static char* skip_word(char* p){
+    while(is_word(*p)) p++;
+    return p;
+}
+
+static char* find_byte(char* p, char first, char second){
+    while(*p && *p != first && *p != second) p++;
+    return p;
+}
+
+static int count_newlines(const char* p, const char* end){
+    int count = 0;
+    for(; p < end; p++)
+        count += *p == '\n';
+    return count;
+}
+#endif
+
+// Find the first of two bytes before the end of the source, which may contain zero bytes
+static char* find_before_end(char* p, char first, char second){
+    p = find_byte(p, first, second);
+    while(*p == 0 && p < lexer_end)
+        p = find_byte(p + 1, first, second);
+    return p;
+}
+
+// Set the location of a token of length bytes at p, like YY_USER_ACTION in flex.l
+static int lexer_emit(char* p, size_t length, int token){
+    lexer_location.first_line = lexer_location.last_line = lexer_line;
+    lexer_location.first_column = lexer_column;
+    lexer_location.last_column = lexer_column + length - 1;
+    lexer_column += length;
+    lexer_position = p + length;
+    return token;
+}
+
+// Powers of ten that doubles represent exactly
+static const double exact_powers[] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+// Parse [0-9]+ as an integer, or [0-9]*\.[0-9]+ as a double, without sscanf
+static int lexer_number(char* p){
+    char* q = p;
+    uint64_t value = 0;
+    bool overflow = false;
+    for(; is_digit(*q); q++){
+        if(value > (uint64_t)(INT64_MAX - (*q - '0')) / 10) overflow = true;
+        else value = value * 10 + (*q - '0');
+    }
+    if(*q != '.' || !is_digit(q[1])){
+        // Like strtol, integers that don't fit are the largest one
+        lexer_value.literal = (int_literal_t){overflow ? INT64_MAX : (int64_t)value, 0, false};
+        return lexer_emit(p, q - p, INT_LITERAL);
+    }
+
+    // A double divided by an exact power of ten is rounded correctly, like strtod
+    // The digits have to fit in the 53 bits of a double for that, otherwise strtod parses them
+    int fraction = 0;
+    for(q++; is_digit(*q); q++, fraction++){
+        if(value > (UINT64_C(1) << 53) / 10) overflow = true;
+        else value = value * 10 + (*q - '0');
+    }
+    if(overflow || value > (UINT64_C(1) << 53) || fraction > 22){
+        char end = *q;
+        *q = 0;
+        lexer_value.fp_literal = strtod(p, NULL);
+        *q = end;
+    } else{
+        lexer_value.fp_literal = (double)value / exact_powers[fraction];
+    }
+    return lexer_emit(p, q - p, FP_LITERAL);
+}
+
+static bool is_hex_digit(char c){
+    return is_digit(c) || (c >= 'a' && c <= 'f') || (c >= 'A' && c <= 'F');
+}
+
+int lexer_integer(const char* text, size_t length){
+    // The suffix is the type of the literal
+    static const char* suffixes[] = {"i8", "i16", "i32", "i64"};
+    static const uint32_t widths[] = {8, 16, 32, 64};
+    uint32_t width = 0;
+    for(uint32_t i = 0; i<4 && !width; i++){
+        size_t suffix_length = strlen(suffixes[i]);
+        if(length > suffix_length && memcmp(text + length - suffix_length, suffixes[i], suffix_length) == 0){
+            width = widths[i];
+            length -= suffix_length;
+        }
+    }
+
+    // Underscores can be anywhere after the first digit, or after the prefix
+    uint64_t base = 10;
+    size_t start = 0;
+    if(length > 2 && text[0] == '0' && (text[1] == 'x' || text[1] == 'X')) base = 16, start = 2;
+    else if(length > 2 && text[0] == '0' && (text[1] == 'b' || text[1] == 'B')) base = 2, start = 2;
+    else if(!is_digit(text[0])) return 0;
+    uint64_t value = 0;
+    bool overflow = false, has_digit = false;
+    for(size_t i = start; i<length; i++){
+        char c = text[i];
+        if(c == '_') continue;
+        uint64_t digit;
+        if(base == 16 && is_hex_digit(c)) digit = is_digit(c) ? c - '0' : (c | 0x20) - 'a' + 10;
+        else if(base == 10 && is_digit(c)) digit = c - '0';
+        else if(base == 2 && (c == '0' || c == '1')) digit = c - '0';
+        else return 0;
+        if(value > (UINT64_MAX - digit) / base) overflow = true;
+        else value = value * base + digit;
+        has_digit = true;
+    }
+    if(!has_digit) return 0;
+
+    // Decimal literals that don't fit are the largest one, like strtol
+    // Hexadecimal and binary literals are bit patterns, so they can set the sign bit, of i64 or of a narrower type
+    if(base == 10 && (overflow || value > INT64_MAX)) value = INT64_MAX;
+    else if(overflow) value = UINT64_MAX;
+    lexer_value.literal = (int_literal_t){(int64_t)value, width, base != 10};
+    return width ? SUFFIX_LITERAL : INT_LITERAL;
+}
+
+// Identifiers are [a-zA-Z0-9_]+, so digits followed by letters are one too, unless they are an integer literal
+static int lexer_word(char* p){
+    char* q = skip_word(p);
+    size_t length = q - p;
+    if(is_digit(*p)){
+        char* digits = p;
+        while(is_digit(*digits)) digits++;
+        if(digits == q) return lexer_number(p);
+        int token = lexer_integer(p, length);
+        if(token) return lexer_emit(p, length, token);
+    } else if(length >= 2 && length <= KEYWORD_LENGTH){
+        keyword_t *keyword = keyword_table[keyword_hash(p, length)];
+        if(keyword && strncmp(keyword->name, p, length) == 0 && keyword->name[length] == 0){
+            if(keyword->token == INT_LITERAL)
+                lexer_value.literal = (int_literal_t){keyword->value, 0, false};
+            return lexer_emit(p, length, keyword->token);
+        }
+    }
+    lexer_value.str = lexer_intern(p, length);
+    return lexer_emit(p, length, ID);
+}
+
+// Get the next token from the source, matching the rules of flex.l
+static int simd_token(){
+    char* p = lexer_position;
+    for(;;){
+        // Whitespace restarts the column after its last line feed
+        if(*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n'){
+            char* q = skip_space(p);
+            int newlines = count_newlines(p, q);
+            if(newlines){
+                char* line = q;
+                while(line[-1] != '\n') line--;
+                lexer_line += newlines;
+                lexer_column = q - line + 1;
+            } else{
+                lexer_column += q - p;
+            }
+            p = q;
+            continue;
+        }
+
+        // Comments restart the column after each line break, including carriage returns
+        if(p[0] == '/' && p[1] == '/'){
+            char* q = find_before_end(p + 2, '\r', '\n');
+            if(q >= lexer_end){
+                p = lexer_end;
+                continue;
+            }
+            if(*q == '\n') lexer_line++;
+            lexer_column = 1;
+            p = q + 1;
+            continue;
+        }
+        if(p[0] == '/' && p[1] == '*'){
+            char* q = find_before_end(p + 2, '*', '*');
+            while(q < lexer_end && q[1] != '/')
+                q = find_before_end(q + 1, '*', '*');
+            char* end = q < lexer_end ? q + 2 : lexer_end;
+            char* line = end;
+            while(line > p + 2 && line[-1] != '\n' && line[-1] != '\r') line--;
+            lexer_line += count_newlines(p, end);
+            lexer_column = line > p + 2 ? end - line + 1 : lexer_column + (end - p);
+            p = end;
+            continue;
+        }
+        if(p >= lexer_end){
+            lexer_position = p;
+            return 0;
+        }
+
+        switch(*p){
+        case ':': return lexer_emit(p, 1, COLON);
+        case '*': return lexer_emit(p, 1, ASTERISK);
+        case '[': return lexer_emit(p, 1, L_SQUARE);
+        case ']': return lexer_emit(p, 1, R_SQUARE);
+        case '(': return lexer_emit(p, 1, L_PAREN);
+        case ')': return lexer_emit(p, 1, R_PAREN);
+        case '{': return lexer_emit(p, 1, L_CURLY);
+        case '}': return lexer_emit(p, 1, R_CURLY);
+        case ',': return lexer_emit(p, 1, COMMA);
+        case ';': return lexer_emit(p, 1, SEMICOLON);
+        case '+': return lexer_emit(p, 1, ADD);
+        case '/': return lexer_emit(p, 1, DIV);
+        case '%': return lexer_emit(p, 1, MOD);
+        case '^': return lexer_emit(p, 1, BIT_XOR);
+        case '~': return lexer_emit(p, 1, BIT_NOT);
+        case '-': return p[1] == '>' ? lexer_emit(p, 2, ARROW) : lexer_emit(p, 1, SUB);
+        case '=': return p[1] == '=' ? lexer_emit(p, 2, EQ) : lexer_emit(p, 1, ASSIGN);
+        case '!': return p[1] == '=' ? lexer_emit(p, 2, NEQ) : lexer_emit(p, 1, BOOL_NOT);
+        case '&': return p[1] == '&' ? lexer_emit(p, 2, BOOL_AND) : lexer_emit(p, 1, BIT_AND);
+        case '|': return p[1] == '|' ? lexer_emit(p, 2, BOOL_OR) : lexer_emit(p, 1, BIT_OR);
+        case '<':
+            if(p[1] == '<') return lexer_emit(p, 2, LSHIFT);
+            return p[1] == '=' ? lexer_emit(p, 2, LEQ) : lexer_emit(p, 1, LESS);
+        case '>':
+            if(p[1] == '>') return lexer_emit(p, 2, RSHIFT);
+            return p[1] == '=' ? lexer_emit(p, 2, GEQ) : lexer_emit(p, 1, GREATER);
+        case '.':
+            if(p[1] == '.' && p[2] == '.') return lexer_emit(p, 3, ELLIPSES);
+            if(is_digit(p[1])) return lexer_number(p);
+            return lexer_emit(p, 1, DOT);
+        case '"': {
+            // flex counts the lines of a token before its location is set, so strings are on their last line
+            char* q = find_before_end(p + 1, '"', '"');
+            if(q >= lexer_end) break;
+            lexer_line += count_newlines(p, q);
+            lexer_value.str = translate_special_chars(p + 1, q - p - 1);
+            return lexer_emit(p, q - p + 1, STR_LITERAL);
+        }
+        case '@': {
+            if(!is_word(p[1]) || is_digit(p[1])) break;
+            char* q = skip_word(p + 1);
+            lexer_value.str = lexer_intern(p + 1, q - p - 1);
+            return lexer_emit(p, q - p, BUILTIN);
+        }
+        default:
+            if(is_word(*p)) return lexer_word(p);
+        }
+
+        // flex echoes bytes that no rule matches, and goes on
+        putchar(*p);
+        lexer_column++;
+        p++;
+    }
+}
+
+// A token with its value and location
+typedef struct lexer_record {
+    int token;
+    YYSTYPE value;
+    YYLTYPE location;
+} lexer_record_t;
+
+// Number of tokens in the queue from the lexer thread to the parser
+#define LEXER_QUEUE 4096
+
+// Each side shares its index once per batch of tokens, and before it waits
+#define LEXER_BATCH 64
+
+// A single-producer, single-consumer queue of tokens, which doesn't lock
+// Each side only writes its own index, and keeps the last index of the other side it read
+// The two sides are on different cache lines, so that they don't take the line from each other
+typedef struct lexer_queue {
+    struct {
+        atomic_uint head;       // Tokens written, which the parser can read
+        uint32_t position;      // Tokens written, including the ones not shared yet
+        uint32_t tail;
+    } __attribute__((aligned(64))) lexer;
+    struct {
+        atomic_uint tail;       // Tokens read, whose records the lexer can reuse
+        uint32_t position;
+        uint32_t head;
+    } __attribute__((aligned(64))) parser;
+    lexer_record_t records[LEXER_QUEUE];
+} lexer_queue_t;
+
+bool lexer_threaded = false;
+lexer_queue_t *lexer_queue;
+pthread_t lexer_thread;
+
+// Spin for a while, then let the other thread run, which it has to when both share a core
+static void queue_wait(uint32_t *spins){
+#if defined(__x86_64__) || defined(__i386__)
+    if(++*spins < 100){
+        _mm_pause();
+        return;
+    }
+#endif
+    sched_yield();
+}
+
+static void queue_push(lexer_record_t *record){
+    lexer_queue_t *queue = lexer_queue;
+    uint32_t position = queue->lexer.position;
+    if(position - queue->lexer.tail == LEXER_QUEUE){
+        atomic_store_explicit(&queue->lexer.head, position, memory_order_release);
+        uint32_t spins = 0;
+        while(position - (queue->lexer.tail = atomic_load_explicit(&queue->parser.tail, memory_order_acquire)) == LEXER_QUEUE)
+            queue_wait(&spins);
+    }
+    queue->records[position % LEXER_QUEUE] = *record;
+    queue->lexer.position = ++position;
+    if(position % LEXER_BATCH == 0 || record->token == 0)
+        atomic_store_explicit(&queue->lexer.head, position, memory_order_release);
+}
+
+static void queue_pop(lexer_record_t *record){
+    lexer_queue_t *queue = lexer_queue;
+    uint32_t position = queue->parser.position;
+    if(position == queue->parser.head){
+        atomic_store_explicit(&queue->parser.tail, position, memory_order_release);
+        uint32_t spins = 0;
+        while(position == (queue->parser.head = atomic_load_explicit(&queue->lexer.head, memory_order_acquire)))
+            queue_wait(&spins);
+    }
+    *record = queue->records[position % LEXER_QUEUE];
+    queue->parser.position = ++position;
+    if(position % LEXER_BATCH == 0)
+        atomic_store_explicit(&queue->parser.tail, position, memory_order_release);
+}
+
+// Lex the whole source on its own thread, ending with token 0
+static void* lexer_run(void* arg){
+    (void)arg;
+    lexer_record_t record;
+    do{
+        record.token = lexer_simd ? simd_token() : yylex();
+        record.value = lexer_value;
+        record.location = lexer_location;
+        queue_push(&record);
+    } while(record.token);
+    return NULL;
+}
+
+bool lexer_open(char* input_file, bool simd, bool threaded){
+    lexer_simd = simd;
+    if(!simd){
+        yyin = fopen(input_file, "r");
+        if(!yyin) return false;
+    } else if(!simd_open(input_file)){
+        return false;
+    }
+
+    // The lexer thread starts right away, and the parser waits for its first tokens
+    lexer_threaded = threaded;
+    if(threaded){
+        lexer_queue = calloc(1, sizeof(lexer_queue_t));
+        if(pthread_create(&lexer_thread, NULL, lexer_run, NULL)){
+            printf("Could not start the lexer thread\n");
+            exit(0);
+        }
+    }
+    return true;
+}
+
+int lexer_token(){
+    if(!lexer_threaded){
+        int token = lexer_simd ? simd_token() : yylex();
+        yylval = lexer_value;
+        yylloc = lexer_location;
+        return token;
+    }
+
+    // The parser doesn't ask for more tokens after the end, but the end is returned again if it does
+    if(!lexer_queue) return 0;
+    lexer_record_t record;
+    queue_pop(&record);
+    yylval = record.value;
+    yylloc = record.location;
+    if(record.token == 0){
+        pthread_join(lexer_thread, NULL);
+        free(lexer_queue);
+        lexer_queue = NULL;
+    }
+    return record.token;
+}
+
+// Write a string with the bytes that would break the list escaped
+static void write_escaped(FILE *fp, char* str){
+    for(; *str; str++){
+        if(*str == '\\') fputs("\\\\", fp);
+        else if(*str < ' ' || *str == 127) fprintf(fp, "\\x%02x", (unsigned char)*str);
+        else fputc(*str, fp);
+    }
+}
+
+void lexer_dump(char* output_file){
+    uint32_t count = 0, capacity = 1024;
+    lexer_record_t *records = malloc(sizeof(lexer_record_t) * capacity);
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    int token;
+    while((token = lexer_token())){
+        if(count == capacity){
+            capacity *= 2;
+            records = realloc(records, sizeof(lexer_record_t) * capacity);
+        }
+        records[count].token = token;
+        records[count].value = yylval;
+        records[count].location = yylloc;
+        count++;
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    printf("Lexed %u tokens in %.3fs\n", count, (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9);
+
+    FILE *fp = fopen(output_file, "w");
+    if(!fp){
+        printf("Could not write tokens to %s\n", output_file);
+        exit(0);
+    }
+    for(uint32_t i = 0; i<count; i++){
+        lexer_record_t *record = &records[i];
+        fprintf(fp, "%d:%d-%d %s", record->location.first_line, record->location.first_column,
+            record->location.last_column, token_name(record->token));
+        if(record->token == ID || record->token == BUILTIN || record->token == STR_LITERAL){
+            fputc(' ', fp);
+            write_escaped(fp, record->value.str);
+        } else if(record->token == INT_LITERAL){
+            fprintf(fp, " %ld", record->value.literal.value);
+        } else if(record->token == SUFFIX_LITERAL){
+            fprintf(fp, " %ld i%u", record->value.literal.value, record->value.literal.width);
+        } else if(record->token == FP_LITERAL){
+            fprintf(fp, " %.17g", record->value.fp_literal);
+        }
+        fputc('\n', fp);
+    }
+    fclose(fp);
+    free(records);
+}
@@ -0,0 +1,43 @@
+#ifndef LEXER_H
+#define LEXER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+// Bytes of zeros after the source, so that the scanner can load whole vectors past its end
+#define LEXER_PADDING 64
+
+// Identifiers are at most this long to be keywords (threadlocal)
+#define KEYWORD_LENGTH 11
+
+// A keyword, or a name that stands for a literal, and the token that it is
+typedef struct keyword {
+    const char* name;
+    int token;
+    int value;      // Value of INT_LITERAL tokens
+} keyword_t;
+
+// Open the source file for flex, or read all of it for the hand-written lexer
+// With threaded, a thread lexes the whole file into a queue that lexer_token() reads
+// Returns false if the file couldn't be read
+bool lexer_open(char* input_file, bool simd, bool threaded);
+
+// Get the next token, with its value in yylval and its location in yylloc (0 at the end)
+// Both lexers return the same tokens, so the parser doesn't know which one it uses
+int lexer_token();
+
+// Parse an integer literal: decimal, hexadecimal after 0x or binary after 0b, with _ between digits
+// and an optional suffix of i8, i16, i32 or i64, setting the value of the token
+// Returns INT_LITERAL, SUFFIX_LITERAL, or 0 if the text isn't an integer literal
+int lexer_integer(const char* text, size_t length);
+
+// Get the one copy of a name, allocating it the first time it is seen
+char* lexer_intern(const char* name, size_t length);
+
+// Lex the whole file, print how long it took, then write each token and its location
+void lexer_dump(char* output_file);
+
+// Name of a token, as declared in bison.y
+const char* token_name(int token);
+
+#endif
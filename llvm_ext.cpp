@@ -0,0 +1,18 @@
+#include <llvm/IR/Instructions.h>
+#include <llvm/IR/Metadata.h>
+#include "llvm_ext.h"
+
+void set_musttail(LLVMValueRef call){
+    llvm::unwrap<llvm::CallInst>(call)->setTailCallKind(llvm::CallInst::TCK_MustTail);
+}
+
+void set_loop_metadata(LLVMValueRef branch){
+    // Loop metadata is a distinct node whose first operand refers to itself
+    llvm::Instruction *inst = llvm::unwrap<llvm::Instruction>(branch);
+    llvm::LLVMContext &context = inst->getContext();
+    llvm::Metadata *progress = llvm::MDNode::get(context, llvm::MDString::get(context, "llvm.loop.mustprogress"));
+    llvm::Metadata *operands[2] = {nullptr, progress};
+    llvm::MDNode *loop = llvm::MDNode::getDistinct(context, operands);
+    loop->replaceOperandWith(0, loop);
+    inst->setMetadata(llvm::LLVMContext::MD_loop, loop);
+}
@@ -0,0 +1,21 @@
+#ifndef LLVM_EXT_H
+#define LLVM_EXT_H
+
+#include <llvm-c/Core.h>
+
+// Parts of the LLVM C++ API that the C API of LLVM 14 doesn't expose
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Require a call to reuse the stack frame of its caller
+void set_musttail(LLVMValueRef call);
+
+// Mark the back edge of a loop that always makes progress, so that it may be vectorized or removed
+void set_loop_metadata(LLVMValueRef branch);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -1,8 +1,10 @@
 #include "generate.h"
+#include "server.h"
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
 #include <unistd.h>
+#include <getopt.h>
 void error(char *message)
 {
     printf("%s\n", message);
@@ -15,11 +17,40 @@ void help()
     printf("-S: Output Assembly\n");
     printf("-r: Output LLVM IR\n");
     printf("-o <file>: Output file\n");
+    printf("-g: Generate debug info\n");
+    printf("-O<0-3>: Optimize the LLVM IR and the machine code at this level\n");
+    printf("-f reorder-fields: Reorder struct fields to minimize padding\n");
+    printf("-f instrument-functions: Profile calls and cycles of each function (link with libruntime.a)\n");
+    printf("-f coverage: Count executions of each branch and loop (link with libruntime.a)\n");
+    printf("-f bounds-check: Trap on indices outside of fixed-size arrays\n");
+    printf("-f simd-lexer: Lex with the hand-written SSE2/AVX2 lexer instead of flex\n");
+    printf("-f lexer-thread: Lex on a thread of its own, which passes tokens to the parser through a queue\n");
+    printf("--dump-layout: Display the offsets and padding of each struct\n");
+    printf("--comptime-seconds <n>: Time limit of compile-time evaluation (default: 10)\n");
+    printf("--comptime-memory <MB>: Memory limit of compile-time evaluation (default: 1024)\n");
+    printf("--stats <file>: Write the IR counts and code size of each function as JSON\n");
+    printf("--tokens <file>: Only lex the source, and list its tokens with their locations\n");
+    printf("--server <socket>: Stay resident and compile commands sent to a Unix domain socket\n");
+    printf("--workers <n>: Number of commands the server compiles at once (default: one per core)\n");
+    printf("OUT_SERVER=<socket>: Send the command to a compile server instead of compiling it\n");
     printf("-h: Display command line information\n");
     exit(0);
 }
 
-int main(int argc, char **argv)
+// Store what one command line asks for
+typedef struct command
+{
+    char *input;
+    char *output;
+    options_t options;
+    char *server;
+    long workers;
+} command_t;
+
+// Directory of the LLVM tools, which is only looked up once per process
+char llvm_path[1024];
+
+void find_llvm()
 {
     FILE *fp;
     // Find LLVM directory
@@ -31,46 +62,149 @@ int main(int argc, char **argv)
     }
 
     // Get LLVM bin and remove newline
-    char path[1024];
-    fgets(path, 1024, fp);
-    path[strlen(path)-1] = 0;
-
-    char *output="a.o";
-    char *flags;
+    fgets(llvm_path, 1024, fp);
+    llvm_path[strlen(llvm_path)-1] = 0;
+    pclose(fp);
+}
 
-    //boolean for flags
-    int scheck = 0;
-    int ocheck = 0;
-    int rcheck = 0;
+void parse_command(int argc, char **argv, command_t *command)
+{
+    //long options that don't have a short form
+    static struct option long_options[] = {
+        {"dump-layout", no_argument, NULL, 'L'},
+        {"server", required_argument, NULL, 'V'},
+        {"workers", required_argument, NULL, 'W'},
+        {"comptime-seconds", required_argument, NULL, 'T'},
+        {"comptime-memory", required_argument, NULL, 'M'},
+        {"stats", required_argument, NULL, 'J'},
+        {"tokens", required_argument, NULL, 'K'},
+        {NULL, 0, NULL, 0}
+    };
+    memset(command, 0, sizeof(command_t));
+    command->output = "a.o";
+    command->options.comptime_seconds = 10;
+    command->options.comptime_megabytes = 1024;
+    command->options.opt_level = -1;
 
     int opt;
-    //getopt parses command line arguments
-    while ((opt = getopt(argc, argv, "So:hr")) != -1)
+    //getopt starts over, since server workers parse a command line of their own
+    optind = 0;
+    while ((opt = getopt_long(argc, argv, "So:hrgf:O:", long_options, NULL)) != -1)
     {
         switch (opt)
         {
         case 'S':
-            scheck = 1;
+            command->options.scheck = 1;
             break;
         case 'o':
-            ocheck = 1;
-            output= strdup(optarg);
+            command->output = strdup(optarg);
             break;
         case 'h':
             help();
             break;
         case 'r':
-            rcheck=1;
+            command->options.rcheck=1;
+            break;
+        case 'g':
+            command->options.debug = true;
+            break;
+        case 'O':
+            if (strlen(optarg) != 1 || optarg[0] < '0' || optarg[0] > '3')
+            {
+                printf("Unknown optimization level -O%s\n", optarg);
+                help();
+            }
+            command->options.opt_level = optarg[0] - '0';
+            break;
+        case 'f':
+            if (strcmp(optarg, "reorder-fields") == 0)
+                command->options.reorder_fields = true;
+            else if (strcmp(optarg, "instrument-functions") == 0)
+                command->options.instrument_functions = true;
+            else if (strcmp(optarg, "coverage") == 0)
+                command->options.coverage = true;
+            else if (strcmp(optarg, "bounds-check") == 0)
+                command->options.bounds_check = true;
+            else if (strcmp(optarg, "simd-lexer") == 0)
+                command->options.simd_lexer = true;
+            else if (strcmp(optarg, "lexer-thread") == 0)
+                command->options.lexer_thread = true;
+            else
+            {
+                printf("Unknown feature -f%s\n", optarg);
+                help();
+            }
+            break;
+        case 'L':
+            command->options.dump_layout = true;
+            break;
+        case 'V':
+            command->server = strdup(optarg);
+            break;
+        case 'W':
+            command->workers = atol(optarg);
+            break;
+        case 'T':
+            command->options.comptime_seconds = atol(optarg);
+            break;
+        case 'M':
+            command->options.comptime_megabytes = atol(optarg);
+            break;
+        case 'J':
+            command->options.stats = strdup(optarg);
+            break;
+        case 'K':
+            command->options.tokens = strdup(optarg);
             break;
         default:
             printf("Invalid Command. Use the following commands:");
             help();
         }
     }
-    pclose(fp);
-    if(optind >= argc || argv[optind]==NULL || (scheck & rcheck)){
+    if (command->server)
+        return;
+    if(optind >= argc || argv[optind]==NULL || (command->options.scheck & command->options.rcheck)){
         help();
     }
-    printf("%s\n", path);
-    generate(path, argv[optind], output, scheck, rcheck);
-}
\ No newline at end of file
+    command->input = argv[optind];
+}
+
+// Compile a command line that a client sent to the server
+void compile_request(int argc, char **argv)
+{
+    command_t command;
+    parse_command(argc, argv, &command);
+    if (command.server)
+        error("A compile server cannot be started through another one");
+    command.options.in_process = true;
+    printf("%s\n", llvm_path);
+    generate(llvm_path, command.input, command.output, &command.options);
+}
+
+int main(int argc, char **argv)
+{
+    // getopt reorders the arguments, so keep them in order for the server
+    char **args = malloc(sizeof(char*) * (argc + 1));
+    memcpy(args, argv, sizeof(char*) * (argc + 1));
+    command_t command;
+    parse_command(argc, argv, &command);
+
+    // The server initializes LLVM once, then forks a worker for each command
+    if (command.server)
+    {
+        find_llvm();
+        generate_initialize();
+        if (command.workers < 1)
+            command.workers = sysconf(_SC_NPROCESSORS_ONLN);
+        serve(command.server, command.workers, compile_request);
+    }
+
+    // A client only sends its command, without looking up or initializing LLVM
+    char *server = getenv("OUT_SERVER");
+    if (server)
+        return send_request(server, argc, args);
+
+    find_llvm();
+    printf("%s\n", llvm_path);
+    generate(llvm_path, command.input, command.output, &command.options);
+}
@@ -65,6 +65,22 @@ void insert_value_id_list(value_id_list_t *list, LLVMValueRef value, char* id){
     insert_parse_list(&list->value_list, value, PL_VALUE);
 }
 
+// Initialize a struct_def with no fields or attributes
+void initialize_struct_def(struct_def_t *def){
+    initialize_type_id_list(&def->fields);
+    def->field_aligns = NULL;
+    def->align = 0;
+    def->packed = false;
+    def->reorder = false;
+}
+
+// Insert a field and its alignment into a struct_def
+void insert_struct_def(struct_def_t *def, LLVMTypeRef type, char* id, uint32_t align){
+    insert_type_id_list(&def->fields, type, id);
+    def->field_aligns = realloc(def->field_aligns, sizeof(uint32_t) * def->fields.id_list.length);
+    def->field_aligns[def->fields.id_list.length - 1] = align;
+}
+
 // Create a value_id_list with an extra boolean flag for vargs
 void create_arg_def(arg_def_t *def, type_id_list_t *list, bool varg){
     def->varg = varg;
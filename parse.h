@@ -39,6 +39,15 @@ typedef struct value_id_list{
     parse_list_t value_list;
 } value_id_list_t;
 
+// Structure for the fields and attributes of a struct definition
+typedef struct struct_def {
+    type_id_list_t fields;
+    uint32_t *field_aligns; // align(N) of each field, 0 if unspecified
+    uint32_t align;         // align(N) of the struct, 0 if unspecified
+    bool packed;
+    bool reorder;
+} struct_def_t;
+
 // Structure to declare parameters of functions
 typedef struct arg_def {
     type_id_list_t list;
@@ -57,6 +66,10 @@ void insert_type_id_list(type_id_list_t *list, LLVMTypeRef type, char* id);
 void initialize_value_id_list(value_id_list_t *list);
 void insert_value_id_list(value_id_list_t *list, LLVMValueRef value, char* id);
 
+// Initialization/Insertion into struct_def
+void initialize_struct_def(struct_def_t *def);
+void insert_struct_def(struct_def_t *def, LLVMTypeRef type, char* id, uint32_t align);
+
 // Initialization of arg_def
 void create_arg_def(arg_def_t *def, type_id_list_t *list, bool varg);
 
@@ -0,0 +1,120 @@
+// Runtime for new/delete, regions and pools
+// The compiler inlines the common cases, so these are only called to get more memory
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+
+#define FIRST_CHUNK 4096
+#define LARGEST_CHUNK (1 << 20) // Chunks stop doubling at this size, unless one value needs more
+#define FIRST_ITEMS 64
+
+// Chunks of memory that a region or pool owns, newest first
+// The memory is right after the header, which keeps the alignment of malloc
+typedef struct chunk {
+    struct chunk* prev;
+    size_t size;
+} __attribute__((aligned(16))) chunk_t;
+
+// Matches the region type of the compiler
+typedef struct region {
+    chunk_t* chunks;
+    char* next;
+    char* end;
+} region_t;
+
+// Matches the pool types of the compiler
+// Free items store the next free item in their first bytes
+typedef struct pool {
+    void* free;
+    chunk_t* chunks;
+    char* next;
+    char* end;
+    uint64_t size;
+    uint64_t align;
+} pool_t;
+
+static void* check(void* memory){
+    if(!memory){
+        fprintf(stderr, "Out of memory\n");
+        exit(1);
+    }
+    return memory;
+}
+
+static chunk_t* add_chunk(chunk_t** chunks, size_t size){
+    chunk_t* chunk = check(malloc(sizeof(chunk_t) + size));
+    chunk->prev = *chunks;
+    chunk->size = size;
+    *chunks = chunk;
+    return chunk;
+}
+
+static void free_chunks(chunk_t* chunk){
+    while(chunk){
+        chunk_t* prev = chunk->prev;
+        free(chunk);
+        chunk = prev;
+    }
+}
+
+// Get the size of the next chunk, which is twice the size of the last one
+static size_t next_chunk_size(chunk_t* last, size_t first, size_t needed){
+    size_t size = last ? last->size * 2 : first;
+    if(size > LARGEST_CHUNK) size = last->size > LARGEST_CHUNK ? last->size : LARGEST_CHUNK;
+    return size < needed ? needed : size;
+}
+
+void* __new(uint64_t size){
+    return check(malloc(size ? size : 1));
+}
+
+void __delete(void* memory){
+    free(memory);
+}
+
+// Called when the newest chunk of a region doesn't have room
+void* __region_alloc(region_t* region, uint64_t size, uint64_t align){
+    // Values that are much bigger than a chunk get their own, so the rest of the newest chunk isn't wasted
+    size_t needed = size + align;
+    if(region->chunks && needed > LARGEST_CHUNK / 4){
+        chunk_t* chunk = add_chunk(&region->chunks->prev, needed);
+        uintptr_t start = (uintptr_t)(chunk + 1);
+        return (void*)((start + align - 1) & ~(uintptr_t)(align - 1));
+    }
+    chunk_t* chunk = add_chunk(&region->chunks, next_chunk_size(region->chunks, FIRST_CHUNK, needed));
+    uintptr_t start = ((uintptr_t)(chunk + 1) + align - 1) & ~(uintptr_t)(align - 1);
+    region->next = (char*)(start + size);
+    region->end = (char*)(chunk + 1) + chunk->size;
+    return (void*)start;
+}
+
+// Free every chunk at the end of the scope of a region, and leave it empty
+void __region_free(region_t* region){
+    free_chunks(region->chunks);
+    region->chunks = NULL;
+    region->next = NULL;
+    region->end = NULL;
+}
+
+// Called when the free list of a pool is empty
+void* __pool_alloc(pool_t* pool){
+    if(pool->next == pool->end){
+        size_t size = next_chunk_size(pool->chunks, FIRST_ITEMS * pool->size, pool->size + pool->align);
+        chunk_t* chunk = add_chunk(&pool->chunks, size);
+        uintptr_t start = ((uintptr_t)(chunk + 1) + pool->align - 1) & ~(uintptr_t)(pool->align - 1);
+        pool->next = (char*)start;
+        pool->end = (char*)start + ((uintptr_t)(chunk + 1) + size - start) / pool->size * pool->size;
+    }
+    void* item = pool->next;
+    pool->next += pool->size;
+    return item;
+}
+
+// Free every chunk at the end of the scope of a pool, and leave it empty
+void __pool_destroy(pool_t* pool){
+    free_chunks(pool->chunks);
+    pool->free = NULL;
+    pool->chunks = NULL;
+    pool->next = NULL;
+    pool->end = NULL;
+}
@@ -0,0 +1,127 @@
+// Runtime for -fcoverage
+// Collects the block counters of every module and writes them to a file at exit
+// Each thread counts in its own copy of the counters, which is added to the totals of the module
+// when the thread exits, or at exit for the threads that are still running
+//
+// File format (little-endian):
+//   "OUTCOV1\0"
+//   u32 module count
+//   for each module: u32 path length, path bytes, u32 counter count,
+//                    then for each counter: u32 line, u32 column, u32 kind, u64 count
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <pthread.h>
+
+// The counters of one compiled module
+typedef struct coverage_module {
+    struct coverage_module* next;
+    uint64_t* totals;
+    uint32_t* records; // (line, column, kind) per counter
+    uint32_t count;
+    const char* file;
+} coverage_module_t;
+
+// The counters of one module on one thread
+// Threads are in a list of every thread, and in a list of their own for when they exit
+typedef struct coverage_thread {
+    struct coverage_thread* next;
+    struct coverage_thread* prev;
+    struct coverage_thread* same_thread;
+    uint64_t* counters;
+    coverage_module_t* module;
+} coverage_thread_t;
+
+static coverage_module_t* modules = NULL;
+static coverage_thread_t* threads = NULL;
+static pthread_mutex_t modules_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_key_t thread_key;
+
+// Add the counters of a thread to the totals of its module, and forget them
+// Threads that are still running when the totals are written are merged early, and not again
+// Called with modules_lock held
+static void merge_thread(coverage_thread_t* thread){
+    if(!thread->counters) return;
+    for(uint32_t i = 0; i<thread->module->count; i++)
+        thread->module->totals[i] += thread->counters[i];
+    if(thread->prev) thread->prev->next = thread->next;
+    else threads = thread->next;
+    if(thread->next) thread->next->prev = thread->prev;
+    thread->counters = NULL;
+}
+
+static void thread_exit(void* value){
+    pthread_mutex_lock(&modules_lock);
+    for(coverage_thread_t* thread = value; thread; ){
+        coverage_thread_t* next = thread->same_thread;
+        merge_thread(thread);
+        free(thread);
+        thread = next;
+    }
+    pthread_mutex_unlock(&modules_lock);
+}
+
+static void write_coverage(){
+    char* path = getenv("COVERAGE_OUTPUT");
+    FILE* out = fopen(path ? path : "coverage.out", "wb");
+    if(!out){
+        perror("coverage");
+        return;
+    }
+
+    pthread_mutex_lock(&modules_lock);
+    while(threads) merge_thread(threads);
+    uint32_t module_count = 0;
+    for(coverage_module_t* current = modules; current; current = current->next)
+        module_count++;
+    fwrite("OUTCOV1", 1, 8, out);
+    fwrite(&module_count, sizeof(uint32_t), 1, out);
+    for(coverage_module_t* current = modules; current; current = current->next){
+        uint32_t length = strlen(current->file);
+        fwrite(&length, sizeof(uint32_t), 1, out);
+        fwrite(current->file, 1, length, out);
+        fwrite(&current->count, sizeof(uint32_t), 1, out);
+        for(uint32_t i = 0; i<current->count; i++){
+            fwrite(&current->records[i * 3], sizeof(uint32_t), 3, out);
+            fwrite(&current->totals[i], sizeof(uint64_t), 1, out);
+        }
+    }
+    pthread_mutex_unlock(&modules_lock);
+    fclose(out);
+}
+
+void __coverage_register(uint64_t* totals, uint32_t* records, uint32_t count, const char* file){
+    coverage_module_t* module = malloc(sizeof(coverage_module_t));
+    module->totals = totals;
+    module->records = records;
+    module->count = count;
+    module->file = file;
+
+    pthread_mutex_lock(&modules_lock);
+    if(!modules){
+        pthread_key_create(&thread_key, thread_exit);
+        atexit(write_coverage);
+    }
+    module->next = modules;
+    modules = module;
+    pthread_mutex_unlock(&modules_lock);
+}
+
+// Called by each thread the first time it runs a function of a module, with its counters for that module
+void __coverage_thread(uint64_t* counters, uint64_t* totals){
+    coverage_thread_t* thread = malloc(sizeof(coverage_thread_t));
+    thread->counters = counters;
+    thread->same_thread = pthread_getspecific(thread_key);
+    pthread_setspecific(thread_key, thread);
+
+    pthread_mutex_lock(&modules_lock);
+    thread->module = modules;
+    while(thread->module->totals != totals)
+        thread->module = thread->module->next;
+    thread->prev = NULL;
+    thread->next = threads;
+    if(threads) threads->prev = thread;
+    threads = thread;
+    pthread_mutex_unlock(&modules_lock);
+}
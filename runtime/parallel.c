@@ -0,0 +1,222 @@
+// Runtime for parallel for loops
+// A pool of worker threads splits ranges of iterations lazily and steals ranges from each other
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+#define MAX_WORKERS 256
+#define DEQUE_SIZE 64
+#define CHUNKS_PER_WORKER 16 // The smallest chunk is this fraction of the share of each worker
+
+// Outlined body of a loop, called with the captured variables and a chunk of iterations
+typedef void (*body_t)(void* env, int64_t start, int64_t end);
+
+typedef struct range {
+    int64_t start;
+    int64_t end;
+} range_t;
+
+// Ranges that a worker has split off and not started yet
+// The owner pushes and pops at the bottom, and thieves take the oldest (biggest) range from the top
+typedef struct worker {
+    atomic_flag lock;
+    uint32_t top;
+    uint32_t bottom;
+    range_t ranges[DEQUE_SIZE];
+    uint32_t id;
+    uint32_t seed;
+} __attribute__((aligned(64))) worker_t;
+
+static worker_t* workers = NULL;
+static uint32_t worker_count = 1;
+static pthread_once_t pool_once = PTHREAD_ONCE_INIT;
+
+// Workers sleep until the generation changes, then help with the new loop
+static pthread_mutex_t pool_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t pool_wake = PTHREAD_COND_INITIALIZER;
+static uint64_t generation = 0;
+
+// Only one loop runs on the pool at a time
+static pthread_mutex_t loop_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_mutex_t reduce_lock = PTHREAD_MUTEX_INITIALIZER;
+static body_t loop_body;
+static void* loop_env;
+static int64_t loop_grain;
+static atomic_int_fast64_t loop_remaining;  // Iterations that haven't finished
+static atomic_uint loop_active;             // Workers that haven't left the loop
+
+// Loops nested in the body of another loop run on the thread that reaches them
+static __thread bool in_loop = false;
+
+static inline void relax(){
+#if defined(__x86_64__) || defined(__i386__)
+    _mm_pause();
+#else
+    sched_yield();
+#endif
+}
+
+static inline void lock_worker(worker_t* worker){
+    while(atomic_flag_test_and_set_explicit(&worker->lock, memory_order_acquire)) relax();
+}
+
+static inline void unlock_worker(worker_t* worker){
+    atomic_flag_clear_explicit(&worker->lock, memory_order_release);
+}
+
+static bool push(worker_t* worker, range_t range){
+    lock_worker(worker);
+    bool has_room = worker->bottom - worker->top < DEQUE_SIZE;
+    if(has_room) worker->ranges[worker->bottom++ % DEQUE_SIZE] = range;
+    unlock_worker(worker);
+    return has_room;
+}
+
+static bool pop(worker_t* worker, range_t* range){
+    lock_worker(worker);
+    bool found = worker->bottom != worker->top;
+    if(found) *range = worker->ranges[--worker->bottom % DEQUE_SIZE];
+    unlock_worker(worker);
+    return found;
+}
+
+static bool take(worker_t* victim, range_t* range){
+    lock_worker(victim);
+    bool found = victim->bottom != victim->top;
+    if(found) *range = victim->ranges[victim->top++ % DEQUE_SIZE];
+    unlock_worker(victim);
+    return found;
+}
+
+static bool is_empty(worker_t* worker){
+    lock_worker(worker);
+    bool empty = worker->bottom == worker->top;
+    unlock_worker(worker);
+    return empty;
+}
+
+// Try every other worker once, starting from a random one so thieves spread out
+static bool steal(worker_t* self, range_t* range){
+    self->seed ^= self->seed << 13;
+    self->seed ^= self->seed >> 17;
+    self->seed ^= self->seed << 5;
+    uint32_t first = self->seed % worker_count;
+    for(uint32_t i = 0; i<worker_count; i++){
+        worker_t* victim = &workers[(first + i) % worker_count];
+        if(victim != self && take(victim, range)) return true;
+    }
+    return false;
+}
+
+// Run a range one chunk at a time
+// Lazy binary splitting: the second half is only split off when nothing is left for thieves to take
+static void run_range(worker_t* self, range_t range){
+    while(range.start < range.end){
+        int64_t length = range.end - range.start;
+        if(length > 2 * loop_grain && is_empty(self)){
+            range_t half = {range.start + length / 2, range.end};
+            if(push(self, half)) range.end = half.start;
+        }
+        int64_t stop = range.end - range.start > loop_grain ? range.start + loop_grain : range.end;
+        loop_body(loop_env, range.start, stop);
+        atomic_fetch_sub_explicit(&loop_remaining, stop - range.start, memory_order_release);
+        range.start = stop;
+    }
+}
+
+// Work on the current loop until every iteration has finished
+static void run_loop(worker_t* self){
+    range_t range;
+    while(atomic_load_explicit(&loop_remaining, memory_order_acquire) > 0){
+        if(pop(self, &range) || steal(self, &range))
+            run_range(self, range);
+        else
+            relax();
+    }
+}
+
+static void* worker_main(void* arg){
+    worker_t* self = arg;
+    uint64_t seen = 0;
+    in_loop = true;
+    for(;;){
+        pthread_mutex_lock(&pool_lock);
+        while(generation == seen) pthread_cond_wait(&pool_wake, &pool_lock);
+        seen = generation;
+        pthread_mutex_unlock(&pool_lock);
+        run_loop(self);
+        atomic_fetch_sub_explicit(&loop_active, 1, memory_order_release);
+    }
+    return NULL;
+}
+
+// Start one worker per core, or PARALLEL_THREADS workers, including the thread that runs the loop
+static void create_pool(){
+    char* threads = getenv("PARALLEL_THREADS");
+    long count = threads ? atol(threads) : sysconf(_SC_NPROCESSORS_ONLN);
+    if(count < 1) count = 1;
+    if(count > MAX_WORKERS) count = MAX_WORKERS;
+    workers = aligned_alloc(64, sizeof(worker_t) * count);
+    for(uint32_t i = 0; i<count; i++){
+        atomic_flag_clear(&workers[i].lock);
+        workers[i].top = workers[i].bottom = 0;
+        workers[i].id = i;
+        workers[i].seed = 2654435761u * (i + 1);
+    }
+    worker_count = count;
+    for(uint32_t i = 1; i<count; i++){
+        pthread_t thread;
+        if(pthread_create(&thread, NULL, worker_main, &workers[i]) != 0){
+            fprintf(stderr, "Couldn't start parallel worker threads\n");
+            exit(1);
+        }
+        pthread_detach(thread);
+    }
+}
+
+void __parallel_for(body_t body, void* env, int64_t start, int64_t end){
+    if(start >= end) return;
+    pthread_once(&pool_once, create_pool);
+    if(in_loop || worker_count == 1 || end - start < 2){
+        body(env, start, end);
+        return;
+    }
+
+    // The calling thread becomes the first worker, and starts with the whole range
+    pthread_mutex_lock(&loop_lock);
+    in_loop = true;
+    loop_body = body;
+    loop_env = env;
+    loop_grain = (end - start) / (worker_count * CHUNKS_PER_WORKER);
+    if(loop_grain < 1) loop_grain = 1;
+    atomic_store(&loop_remaining, end - start);
+    atomic_store(&loop_active, worker_count - 1);
+    push(&workers[0], (range_t){start, end});
+    pthread_mutex_lock(&pool_lock);
+    generation++;
+    pthread_cond_broadcast(&pool_wake);
+    pthread_mutex_unlock(&pool_lock);
+    run_loop(&workers[0]);
+
+    // Every worker must leave before the next loop can reuse the pool
+    while(atomic_load_explicit(&loop_active, memory_order_acquire)) relax();
+    in_loop = false;
+    pthread_mutex_unlock(&loop_lock);
+}
+
+// Reductions combine the result of each chunk while holding this lock
+void __parallel_lock(){
+    pthread_mutex_lock(&reduce_lock);
+}
+
+void __parallel_unlock(){
+    pthread_mutex_unlock(&reduce_lock);
+}
@@ -0,0 +1,215 @@
+// Runtime for -finstrument-functions
+// Keeps per-thread call counts and cycle totals, then prints a report at exit
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <pthread.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#else
+#include <time.h>
+#endif
+
+#define INITIAL_RECORDS 1024
+#define INITIAL_FRAMES 256
+
+// Totals for one function on one thread
+typedef struct record {
+    void* function;
+    const char* name;
+    uint64_t calls;
+    uint64_t inclusive;
+    uint64_t exclusive;
+    uint64_t depth; // Active calls, so recursion isn't counted twice inclusively
+} record_t;
+
+// One active call on the shadow stack
+typedef struct frame {
+    record_t* record;
+    uint64_t start;
+    uint64_t children;
+} frame_t;
+
+// All of the profiling state of one thread
+typedef struct thread_profile {
+    struct thread_profile* next;
+    record_t* records;
+    uint32_t capacity;
+    uint32_t length;
+    frame_t* frames;
+    uint32_t frame_capacity;
+    uint32_t frame_length;
+    uint64_t mismatched; // Exits of a function other than the one on top of the shadow stack
+} thread_profile_t;
+
+static __thread thread_profile_t* profile = NULL;
+static thread_profile_t* profiles = NULL;
+static pthread_mutex_t profiles_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static inline uint64_t read_cycles(){
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000 + now.tv_nsec;
+#endif
+}
+
+static void print_report();
+
+// Create the buffers of the current thread and register them for the report
+static thread_profile_t* create_profile(){
+    thread_profile_t* current = calloc(1, sizeof(thread_profile_t));
+    current->capacity = INITIAL_RECORDS;
+    current->records = calloc(current->capacity, sizeof(record_t));
+    current->frame_capacity = INITIAL_FRAMES;
+    current->frames = malloc(sizeof(frame_t) * current->frame_capacity);
+
+    pthread_mutex_lock(&profiles_lock);
+    if(!profiles) atexit(print_report);
+    current->next = profiles;
+    profiles = current;
+    pthread_mutex_unlock(&profiles_lock);
+    return current;
+}
+
+static inline uint32_t hash_function(void* function, uint32_t capacity){
+    uint64_t key = (uint64_t)(uintptr_t)function;
+    key ^= key >> 33;
+    key *= 0xff51afd7ed558ccdull;
+    key ^= key >> 33;
+    return (uint32_t)key & (capacity - 1);
+}
+
+// Double the size of the record table, rehashing every record
+static void grow_records(thread_profile_t* current){
+    record_t* old = current->records;
+    uint32_t old_capacity = current->capacity;
+    current->capacity *= 2;
+    current->records = calloc(current->capacity, sizeof(record_t));
+    for(uint32_t i = 0; i<old_capacity; i++){
+        if(!old[i].function) continue;
+        uint32_t slot = hash_function(old[i].function, current->capacity);
+        while(current->records[slot].function)
+            slot = (slot + 1) & (current->capacity - 1);
+        current->records[slot] = old[i];
+    }
+    // Active frames point into the old table
+    for(uint32_t i = 0; i<current->frame_length; i++){
+        void* function = current->frames[i].record->function;
+        uint32_t slot = hash_function(function, current->capacity);
+        while(current->records[slot].function != function)
+            slot = (slot + 1) & (current->capacity - 1);
+        current->frames[i].record = &current->records[slot];
+    }
+    free(old);
+}
+
+static inline record_t* find_record(thread_profile_t* current, void* function, const char* name){
+    uint32_t slot = hash_function(function, current->capacity);
+    while(current->records[slot].function && current->records[slot].function != function)
+        slot = (slot + 1) & (current->capacity - 1);
+    record_t* record = &current->records[slot];
+    if(!record->function){
+        // Keep the table at most half full
+        if((current->length + 1) * 2 > current->capacity){
+            grow_records(current);
+            return find_record(current, function, name);
+        }
+        record->function = function;
+        record->name = name;
+        current->length++;
+    }
+    return record;
+}
+
+void __instrument_enter(void* function, const char* name){
+    thread_profile_t* current = profile;
+    if(!current) current = profile = create_profile();
+    record_t* record = find_record(current, function, name);
+    record->calls++;
+    record->depth++;
+
+    if(current->frame_length == current->frame_capacity){
+        current->frame_capacity *= 2;
+        current->frames = realloc(current->frames, sizeof(frame_t) * current->frame_capacity);
+    }
+    frame_t* frame = &current->frames[current->frame_length++];
+    frame->record = record;
+    frame->children = 0;
+    // Read the clock last so the hook's own work is mostly excluded
+    frame->start = read_cycles();
+}
+
+void __instrument_exit(void* function){
+    uint64_t end = read_cycles();
+    thread_profile_t* current = profile;
+    if(!current || current->frame_length == 0) return;
+
+    // An exit without its enter, like after a longjmp, still pops a frame, so the times after it are off
+    frame_t* frame = &current->frames[--current->frame_length];
+    if(frame->record->function != function) current->mismatched++;
+    uint64_t elapsed = end - frame->start;
+    record_t* record = frame->record;
+    record->exclusive += elapsed - frame->children;
+    if(--record->depth == 0)
+        record->inclusive += elapsed;
+    if(current->frame_length)
+        current->frames[current->frame_length - 1].children += elapsed;
+}
+
+// Sort by exclusive cycles, highest first
+static int compare_records(const void* a, const void* b){
+    const record_t* left = a;
+    const record_t* right = b;
+    if(left->exclusive == right->exclusive) return 0;
+    return left->exclusive < right->exclusive ? 1 : -1;
+}
+
+// Merge every thread's records and print them, hottest first
+static void print_report(){
+    uint32_t capacity = 64, length = 0;
+    record_t* merged = malloc(sizeof(record_t) * capacity);
+    uint64_t total = 0, mismatched = 0;
+
+    pthread_mutex_lock(&profiles_lock);
+    for(thread_profile_t* current = profiles; current; current = current->next){
+        mismatched += current->mismatched;
+        for(uint32_t i = 0; i<current->capacity; i++){
+            record_t* record = &current->records[i];
+            if(!record->function) continue;
+            uint32_t j = 0;
+            while(j < length && merged[j].function != record->function) j++;
+            if(j == length){
+                if(length == capacity){
+                    capacity *= 2;
+                    merged = realloc(merged, sizeof(record_t) * capacity);
+                }
+                merged[length] = *record;
+                merged[length].calls = merged[length].inclusive = merged[length].exclusive = 0;
+                length++;
+            }
+            merged[j].calls += record->calls;
+            merged[j].inclusive += record->inclusive;
+            merged[j].exclusive += record->exclusive;
+            total += record->exclusive;
+        }
+    }
+    pthread_mutex_unlock(&profiles_lock);
+
+    qsort(merged, length, sizeof(record_t), compare_records);
+    FILE* out = stderr;
+    char* path = getenv("PROFILE_OUTPUT");
+    if(path && !(out = fopen(path, "w"))) out = stderr;
+    fprintf(out, "%12s %16s %16s %7s %12s  %s\n", "calls", "inclusive", "exclusive", "excl%", "excl/call", "function");
+    for(uint32_t i = 0; i<length; i++){
+        fprintf(out, "%12lu %16lu %16lu %6.2f%% %12lu  %s\n", merged[i].calls, merged[i].inclusive, merged[i].exclusive,
+            total ? 100.0 * merged[i].exclusive / total : 0.0, merged[i].exclusive / merged[i].calls, merged[i].name);
+    }
+    if(mismatched)
+        fprintf(out, "%lu exits didn't match the function on top of the shadow stack, so the times above are off\n", mismatched);
+    if(out != stderr) fclose(out);
+    free(merged);
+}
@@ -0,0 +1,1729 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include "sema.h"
+#include "generate.h"
+
+// Store the state of the type checker
+sema_scope_t *sema_scope = NULL;
+sema_loop_t *sema_loop = NULL;
+sema_parallel_t *sema_parallel = NULL;
+ast_node_t *sema_current_function = NULL;
+ast_node_t *sema_tail_return = NULL;
+ast_node_t *sema_comptime = NULL;
+sema_bounds_t *sema_bounds = NULL;
+
+// Copies of generic code are added to the end of the program, and declared in the outermost scope
+ast_node_t *sema_program_head = NULL;
+ast_node_t *sema_program_tail = NULL;
+sema_scope_t *sema_globals = NULL;
+sema_instance_t *sema_instances = NULL;
+
+void sema_error(ast_node_t *node, const char* format, ...){
+    va_list args;
+    printf("%u:%u: ", node->line, node->column);
+    va_start(args, format);
+    vprintf(format, args);
+    va_end(args);
+    printf("\n");
+    exit(0);
+}
+
+static void sema_push_scope(){
+    sema_scope_t *scope = calloc(1, sizeof(sema_scope_t));
+    scope->prev = sema_scope;
+    sema_scope = scope;
+}
+
+static void sema_pop_scope(){
+    sema_scope_t *prev = sema_scope->prev;
+    for(int i = 0; i<SEMA_BUCKETS; i++){
+        while(sema_scope->symbols[i]){
+            sema_symbol_t *next = sema_scope->symbols[i]->next;
+            free(sema_scope->symbols[i]);
+            sema_scope->symbols[i] = next;
+        }
+    }
+    free(sema_scope);
+    sema_scope = prev;
+}
+
+static sema_symbol_t *sema_lookup(char* name){
+    uint32_t bucket = hash_name(name) & (SEMA_BUCKETS - 1);
+    for(sema_scope_t *scope = sema_scope; scope; scope = scope->prev){
+        for(sema_symbol_t *symbol = scope->symbols[bucket]; symbol; symbol = symbol->next){
+            if(strcmp(symbol->name, name) == 0) return symbol;
+        }
+    }
+    return NULL;
+}
+
+static sema_symbol_t *sema_declare(ast_node_t *node, char* name, LLVMTypeRef type, bool is_function){
+    // Functions can be declared more than once, but only with the same type
+    uint32_t bucket = hash_name(name) & (SEMA_BUCKETS - 1);
+    for(sema_symbol_t *symbol = sema_scope->symbols[bucket]; symbol; symbol = symbol->next){
+        if(strcmp(symbol->name, name) != 0) continue;
+        if(is_function && symbol->is_function){
+            if(symbol->type != type)
+                sema_error(node, "Function %s redeclared with a different type", name);
+            return symbol;
+        }
+        sema_error(node, "Identifier %s already defined", name);
+    }
+    sema_symbol_t *symbol = malloc(sizeof(sema_symbol_t));
+    symbol->name = name;
+    symbol->type = type;
+    symbol->is_function = is_function;
+    symbol->is_local = sema_scope->prev != NULL;
+    symbol->is_constant = false;
+    symbol->declaration = node;
+    symbol->definition = NULL;
+    symbol->next = sema_scope->symbols[bucket];
+    sema_scope->symbols[bucket] = symbol;
+    return symbol;
+}
+
+// Create the function type of a function definition or function pointer type
+static LLVMTypeRef sema_function_type(ast_node_t *node){
+    LLVMTypeRef return_type = node->left ? sema_type(node->left) : LLVMVoidType();
+    if(is_allocator(return_type))
+        sema_error(node->left, "Cannot return a region or pool");
+    uint32_t length = ast_length(node->list);
+    LLVMTypeRef *params = malloc(sizeof(LLVMTypeRef) * (length ? length : 1));
+    uint32_t i = 0;
+    for(ast_node_t *param = node->list; param; param = param->next){
+        params[i] = sema_type(param->kind == AST_PARAM ? param->left : param);
+        if(is_allocator(params[i++]))
+            sema_error(param, "Regions and pools can only be passed by reference");
+    }
+    LLVMTypeRef type = LLVMFunctionType(return_type, params, length, node->flags & AST_VARG);
+    free(params);
+    return type;
+}
+
+static ast_node_t *find_generic(ast_kind_t kind, const char* name);
+static ast_node_t *sema_instantiate(ast_node_t *generic, LLVMTypeRef *types);
+
+// Resolve a generic structure with type arguments to the copy for those types
+static LLVMTypeRef sema_generic_type(ast_node_t *node){
+    ast_node_t *generic = find_generic(AST_STRUCT, node->name);
+    if(!generic)
+        sema_error(node, "%s is not a generic structure", node->name);
+    uint32_t count = ast_length(generic->right);
+    if(ast_length(node->list) != count)
+        sema_error(node, "%s takes %u type arguments", node->name, count);
+    LLVMTypeRef *types = malloc(sizeof(LLVMTypeRef) * count);
+    uint32_t i = 0;
+    for(ast_node_t *arg = node->list; arg; arg = arg->next)
+        types[i++] = sema_type(arg);
+    ast_node_t *instance = sema_instantiate(generic, types);
+    free(types);
+    return get_type(instance->name, true);
+}
+
+LLVMTypeRef sema_type(ast_node_t *node){
+    // Primitive types are set by the parser and other types are only resolved once
+    if(node->type) return node->type;
+    if(node->kind == AST_TYPE_NAME && node->list){
+        node->type = sema_generic_type(node);
+    } else if(node->kind == AST_TYPE_NAME){
+        node->type = get_type(node->name, false);
+        if(!node->type && find_generic(AST_STRUCT, node->name))
+            sema_error(node, "Generic structure %s needs type arguments", node->name);
+        if(!node->type)
+            sema_error(node, "Couldn't find type %s", node->name);
+    } else if(node->kind == AST_TYPE_POINTER){
+        node->type = LLVMPointerType(sema_type(node->left), 0);
+    } else if(node->kind == AST_TYPE_ARRAY){
+        node->type = LLVMArrayType(sema_type(node->left), node->int_value);
+        if(is_allocator(node->left->type))
+            sema_error(node, "Cannot make an array of regions or pools");
+    } else if(node->kind == AST_TYPE_FUNCTION){
+        node->type = LLVMPointerType(sema_function_type(node), 0);
+    } else if(node->kind == AST_TYPE_REGION){
+        node->type = get_region_type();
+    } else if(node->kind == AST_TYPE_SLICE){
+        node->type = get_slice_type(sema_type(node->left));
+        if(is_allocator(node->left->type))
+            sema_error(node, "Cannot make a slice of regions or pools");
+    } else if(node->kind == AST_TYPE_POOL){
+        node->type = get_pool_type(sema_type(node->left));
+        if(is_allocator(node->left->type))
+            sema_error(node, "Pools cannot hold regions or pools");
+    }
+    return node->type;
+}
+
+bool sema_can_cast(LLVMTypeRef from, LLVMTypeRef to, bool is_explicit){
+    // Mirrors the conversions that cast() can generate
+    if(from == to) return true;
+    LLVMTypeKind from_kind = LLVMGetTypeKind(from);
+    LLVMTypeKind to_kind = LLVMGetTypeKind(to);
+    bool from_int = from_kind == LLVMIntegerTypeKind;
+    bool from_fp = from_kind == LLVMFloatTypeKind || from_kind == LLVMDoubleTypeKind;
+    bool from_pointer = from_kind == LLVMPointerTypeKind;
+    if(to_kind == LLVMIntegerTypeKind){
+        unsigned width = LLVMGetIntTypeWidth(to);
+        if(width == 1) return from_int || from_fp || from_pointer;
+        if(from_int) return LLVMGetIntTypeWidth(from) < width || is_explicit;
+        if(from_kind == LLVMFloatTypeKind) return width > 32 || is_explicit;
+        if(from_kind == LLVMDoubleTypeKind || from_pointer) return is_explicit;
+    } else if(to_kind == LLVMFloatTypeKind){
+        if(from_int) return LLVMGetIntTypeWidth(from) < 32 || is_explicit;
+        return from_kind == LLVMDoubleTypeKind;
+    } else if(to_kind == LLVMDoubleTypeKind){
+        return from_int || from_kind == LLVMFloatTypeKind;
+    } else if(to_kind == LLVMPointerTypeKind){
+        if(from_int) return true;
+        if(from_pointer) return is_explicit;
+    }
+    return false;
+}
+
+// Check whether a value fits in an integer type, which is signed like every integer type
+// i1 only holds 0 and 1, which are false and true
+static bool fits_integer(int64_t value, unsigned width){
+    if(width == 1) return value == 0 || value == 1;
+    if(width >= 64) return true;
+    return value >= -(INT64_C(1) << (width - 1)) && value < (INT64_C(1) << (width - 1));
+}
+
+// Hexadecimal and binary literals are bit patterns, so they fit when they fit the unsigned range of the type instead
+// That is the same at every width: 0xFF is -1 in i8, and 0xFFFF_FFFF_FFFF_FFFF is -1 in i64
+static bool fits_literal(ast_node_t *node, unsigned width){
+    if(!(node->flags & AST_BITS)) return fits_integer(node->int_value, width);
+    return width >= 64 || (uint64_t)node->int_value < (UINT64_C(1) << width);
+}
+
+// Report a literal that doesn't fit, in the base it was written in
+static void literal_error(ast_node_t *node, unsigned width){
+    if(node->flags & AST_BITS)
+        sema_error(node, "0x%lx doesn't fit in i%u", node->int_value, width);
+    sema_error(node, "%ld doesn't fit in i%u", node->int_value, width);
+}
+
+// Integer constants without a suffix, and floating-point literals, are untyped until they are used
+// Without a context integers are i32, or i64 if their value doesn't fit in i32, and floating-point literals are f64
+static LLVMTypeRef untyped_type(int64_t value){
+    return value >= INT32_MIN && value <= INT32_MAX ? LLVMInt32Type() : LLVMInt64Type();
+}
+
+// Give an untyped constant the type its context needs, so that it isn't cast
+// Integer types need the value to fit, pointers can only be null, and floating-point types take any value
+// Otherwise the constant keeps its type, so operators widen to it, and implicit casts to the context fail
+static void sema_retype(ast_node_t *node, LLVMTypeRef type){
+    if(!(node->flags & AST_UNTYPED)) return;
+    LLVMTypeKind kind = LLVMGetTypeKind(type);
+    if(node->kind == AST_FP){
+        if(kind == LLVMFloatTypeKind || kind == LLVMDoubleTypeKind) node->type = type;
+    } else if((kind == LLVMIntegerTypeKind && fits_literal(node, LLVMGetIntTypeWidth(type)))
+        || (kind == LLVMPointerTypeKind && node->int_value == 0)
+        || kind == LLVMFloatTypeKind || kind == LLVMDoubleTypeKind)
+        node->type = type;
+}
+
+// Fold an operation whose operands are untyped constants into another untyped constant
+// Operations that overflow 64 bits, divide by zero or shift too far are left to run in the type of their operands
+static void sema_fold(ast_node_t *node){
+    ast_node_t *left = node->left, *right = node->right;
+    if(!(left->flags & AST_UNTYPED) || (right && !(right->flags & AST_UNTYPED))) return;
+
+    // A negative floating-point literal becomes one literal, and nothing else is folded in floating point
+    if(node->kind == AST_NEGATE && left->kind == AST_FP){
+        node->kind = AST_FP;
+        node->fp_value = -left->fp_value;
+        node->flags |= AST_UNTYPED;
+        return;
+    }
+    if(left->kind == AST_FP || (right && right->kind == AST_FP)) return;
+    int64_t a = left->int_value, b = right ? right->int_value : 0, result = 0;
+    bool overflow = false;
+    if(node->kind == AST_NEGATE) overflow = __builtin_sub_overflow(0, a, &result);
+    else if(node->kind == AST_BIT_NOT) result = ~a;
+    else switch(node->op){
+    case OP_ADD: overflow = __builtin_add_overflow(a, b, &result); break;
+    case OP_SUB: overflow = __builtin_sub_overflow(a, b, &result); break;
+    case OP_MUL: overflow = __builtin_mul_overflow(a, b, &result); break;
+    case OP_DIV:
+    case OP_MOD:
+        overflow = b == 0 || (a == INT64_MIN && b == -1);
+        if(!overflow) result = node->op == OP_DIV ? a / b : a % b;
+        break;
+    case OP_BIT_AND: result = a & b; break;
+    case OP_BIT_OR: result = a | b; break;
+    case OP_BIT_XOR: result = a ^ b; break;
+    case OP_LSHIFT:
+    case OP_RSHIFT:
+        overflow = b < 0 || b >= 64;
+        if(!overflow) result = node->op == OP_LSHIFT ? (int64_t)((uint64_t)a << b) : a >> b;
+        break;
+    default: return;
+    }
+    if(overflow) return;
+    node->int_value = result;
+    node->type = untyped_type(result);
+    node->flags |= AST_UNTYPED;
+}
+
+static void sema_check_cast(ast_node_t *node, LLVMTypeRef from, LLVMTypeRef to, bool is_explicit){
+    if(node->flags & AST_UNTYPED){
+        sema_retype(node, to);
+        from = node->type;
+        if(!is_explicit && node->kind != AST_FP && from != to && LLVMGetTypeKind(to) == LLVMIntegerTypeKind)
+            literal_error(node, LLVMGetIntTypeWidth(to));
+    }
+    if(sema_can_cast(from, to, is_explicit)) return;
+    char* from_name = LLVMPrintTypeToString(from);
+    char* to_name = LLVMPrintTypeToString(to);
+    sema_error(node, "invalid cast from %s to %s", from_name, to_name);
+}
+
+static void sema_check_truthy(ast_node_t *node, LLVMTypeRef type){
+    LLVMTypeKind kind = LLVMGetTypeKind(type);
+    if(kind != LLVMIntegerTypeKind && kind != LLVMFloatTypeKind
+        && kind != LLVMDoubleTypeKind && kind != LLVMPointerTypeKind)
+        sema_error(node, "Cannot check truthiness of this type");
+}
+
+static bool is_number(LLVMTypeRef type){
+    LLVMTypeKind kind = LLVMGetTypeKind(type);
+    return kind == LLVMIntegerTypeKind || kind == LLVMFloatTypeKind || kind == LLVMDoubleTypeKind;
+}
+
+// Find the type both operands are converted to, following implicit_cast()
+static LLVMTypeRef sema_implicit_cast(ast_node_t *node, ast_node_t *left_node, ast_node_t *right_node){
+    // An untyped constant takes the type of the other operand
+    if((left_node->flags & AST_UNTYPED) && !(right_node->flags & AST_UNTYPED))
+        sema_retype(left_node, right_node->type);
+    else if((right_node->flags & AST_UNTYPED) && !(left_node->flags & AST_UNTYPED))
+        sema_retype(right_node, left_node->type);
+    LLVMTypeRef left = left_node->type;
+    LLVMTypeRef right = right_node->type;
+    if(left == right) return left;
+
+    // Iterate down the implicit type hierarchy
+    LLVMTypeRef hierarchy[] = {LLVMDoubleType(), LLVMInt64Type(), LLVMFloatType(),
+        LLVMInt32Type(), LLVMInt16Type(), LLVMInt8Type(), LLVMInt1Type()};
+    for(int i = 0; i<sizeof(hierarchy) / sizeof(LLVMTypeRef); i++){
+        if(left == hierarchy[i]){
+            sema_check_cast(right_node, right, left, false);
+            return left;
+        } else if(right == hierarchy[i]){
+            sema_check_cast(left_node, left, right, false);
+            return right;
+        }
+    }
+    sema_error(node, "Operands have incompatible types");
+    return NULL;
+}
+
+// Check that a global is initialized with a value that is known at compile time
+static bool is_constant(ast_node_t *node){
+    if(node->flags & AST_UNTYPED) return true;
+    if(node->kind == AST_INT || node->kind == AST_FP || node->kind == AST_SIZEOF || node->kind == AST_COMPTIME
+        || node->kind == AST_STRING) return true;
+    if(node->kind == AST_NEGATE || node->kind == AST_CAST) return is_constant(node->left);
+    if(node->kind == AST_INITIALIZER){
+        for(ast_node_t *value = node->list; value; value = value->next){
+            if(!is_constant(value)) return false;
+        }
+        return true;
+    }
+    if(node->kind == AST_IDENTIFIER){
+        sema_symbol_t *symbol = sema_lookup(node->name);
+        return symbol && symbol->is_function;
+    }
+    return false;
+}
+
+// Check whether code runs at compile time, inside a comptime expression or a const fn
+static bool in_const_code(){
+    return sema_comptime || (sema_current_function && (sema_current_function->flags & AST_CONST));
+}
+
+// Compile-time code only computes values, so it can't use the runtime library
+static void sema_check_runtime(ast_node_t *node, const char* action){
+    if(sema_comptime)
+        sema_error(node, "Cannot %s at compile time", action);
+    if(sema_current_function && (sema_current_function->flags & AST_CONST))
+        sema_error(node, "const fn %s cannot %s", sema_current_function->name, action);
+}
+
+// Check that a value written to, or passed by reference, isn't part of a constant
+static void sema_check_writable(ast_node_t *node){
+    while(node->kind == AST_DOT || (node->kind == AST_INDEX && LLVMGetTypeKind(node->left->type) == LLVMArrayTypeKind))
+        node = node->left;
+    if(node->kind != AST_IDENTIFIER) return;
+    sema_symbol_t *symbol = sema_lookup(node->name);
+    if(symbol && symbol->is_constant)
+        sema_error(node, "Cannot change %s, which is constant", node->name);
+}
+
+// Compile-time values are copied out of the compiler, so they can't point into it
+static bool has_pointer(LLVMTypeRef type){
+    LLVMTypeKind kind = LLVMGetTypeKind(type);
+    if(kind == LLVMPointerTypeKind) return true;
+    if(kind == LLVMArrayTypeKind) return has_pointer(LLVMGetElementType(type));
+    if(kind == LLVMStructTypeKind){
+        for(uint32_t i = 0; i<LLVMCountStructElementTypes(type); i++){
+            if(has_pointer(LLVMStructGetTypeAtIndex(type, i))) return true;
+        }
+    }
+    return false;
+}
+
+static LLVMTypeRef sema_expression(ast_node_t *node);
+static void sema_switch(ast_node_t *node);
+static void sema_tail_call(ast_node_t *node);
+static void sema_parallel_for(ast_node_t *node);
+
+// Check whether an lvalue is stored in the stack frame of the current function
+static bool is_local(ast_node_t *node){
+    while(node->kind == AST_DOT
+        || (node->kind == AST_INDEX && LLVMGetTypeKind(node->left->type) == LLVMArrayTypeKind))
+        node = node->left;
+    if(node->kind != AST_IDENTIFIER) return false;
+    return sema_lookup(node->name)->is_local && !(node->flags & AST_BYREF);
+}
+
+// Mark a local whose address is taken, and the function it is in
+// Calls can't be tail calls if they might use the stack frame of their caller
+// Loops can't keep indices in bounds with a variable that might change through a pointer
+static void sema_escape(ast_node_t *node){
+    if(!sema_current_function || !is_local(node)) return;
+    sema_current_function->flags |= AST_ESCAPES;
+    while(node->kind != AST_IDENTIFIER)
+        node = node->left;
+    sema_lookup(node->name)->declaration->flags |= AST_ESCAPES;
+}
+
+// Check whether a symbol is declared outside of a parallel loop
+static bool is_outside(sema_parallel_t *parallel, sema_symbol_t *symbol){
+    uint32_t bucket = hash_name(symbol->name) & (SEMA_BUCKETS - 1);
+    for(sema_scope_t *scope = parallel->scope; scope; scope = scope->prev){
+        for(sema_symbol_t *current = scope->symbols[bucket]; current; current = current->next){
+            if(current == symbol) return true;
+        }
+    }
+    return false;
+}
+
+// Capture a local in every parallel loop between its declaration and a use of it
+// The bodies are outlined, so they reach the locals of the function through pointers
+static void sema_capture(sema_symbol_t *symbol, ast_node_t *node){
+    for(sema_parallel_t *parallel = sema_parallel; parallel; parallel = parallel->prev){
+        if(!is_outside(parallel, symbol)) return;
+
+        // Reductions and earlier uses already capture it
+        ast_node_t *capture;
+        for(capture = parallel->node->list; capture; capture = capture->next){
+            if(strcmp(capture->name, symbol->name) == 0) break;
+        }
+        if(capture) continue;
+        capture = ast_create(AST_CAPTURE, node->line, node->column);
+        capture->name = symbol->name;
+        capture->type = symbol->type;
+        if(symbol->declaration->kind == AST_PARAM)
+            capture->flags = symbol->declaration->flags & AST_BYREF;
+        capture->next = parallel->node->list;
+        parallel->node->list = capture;
+    }
+}
+
+int64_t sema_constant(ast_node_t *node){
+    int64_t left, right;
+    switch(node->kind){
+    case AST_INT:
+        return node->int_value;
+    case AST_NEGATE:
+        node->int_value = -sema_constant(node->left);
+        return node->int_value;
+    case AST_BIT_NOT:
+        node->int_value = ~sema_constant(node->left);
+        return node->int_value;
+    case AST_MATH:
+    case AST_BITWISE:
+        left = sema_constant(node->left);
+        right = sema_constant(node->right);
+        if((node->op == OP_DIV || node->op == OP_MOD) && right == 0)
+            sema_error(node, "Division by zero in a constant expression");
+        switch(node->op){
+        case OP_ADD: node->int_value = left + right; break;
+        case OP_SUB: node->int_value = left - right; break;
+        case OP_MUL: node->int_value = left * right; break;
+        case OP_DIV: node->int_value = left / right; break;
+        case OP_MOD: node->int_value = left % right; break;
+        case OP_BIT_AND: node->int_value = left & right; break;
+        case OP_BIT_OR: node->int_value = left | right; break;
+        case OP_BIT_XOR: node->int_value = left ^ right; break;
+        case OP_LSHIFT: node->int_value = left << right; break;
+        case OP_RSHIFT: node->int_value = left >> right; break;
+        default: break;
+        }
+        return node->int_value;
+    default:
+        sema_error(node, "Expected an integer constant");
+        return 0;
+    }
+}
+
+// Find a generic function or structure by name
+static ast_node_t *find_generic(ast_kind_t kind, const char* name){
+    for(ast_node_t *node = sema_program_head; node; node = node->next){
+        if(node->kind == kind && (node->flags & AST_GENERIC) && strcmp(node->name, name) == 0)
+            return node;
+    }
+    return NULL;
+}
+
+// Write a type the way it is written in the source
+static void sema_write_type(char* buffer, size_t size, LLVMTypeRef type){
+    size_t length = strlen(buffer);
+    char* end = buffer + length;
+    size -= length;
+    LLVMTypeKind kind = LLVMGetTypeKind(type);
+    if(kind == LLVMIntegerTypeKind){
+        if(LLVMGetIntTypeWidth(type) == 1) snprintf(end, size, "bool");
+        else snprintf(end, size, "i%u", LLVMGetIntTypeWidth(type));
+    } else if(kind == LLVMFloatTypeKind){
+        snprintf(end, size, "f32");
+    } else if(kind == LLVMDoubleTypeKind){
+        snprintf(end, size, "f64");
+    } else if(kind == LLVMArrayTypeKind){
+        snprintf(end, size, "[%u]", LLVMGetArrayLength(type));
+        sema_write_type(end, size, LLVMGetElementType(type));
+    } else if(get_slice_element(type)){
+        snprintf(end, size, "[]");
+        sema_write_type(end, size, get_slice_element(type));
+    } else if(kind == LLVMStructTypeKind){
+        snprintf(end, size, "%s", LLVMGetStructName(type));
+    } else if(kind == LLVMPointerTypeKind && LLVMGetTypeKind(LLVMGetElementType(type)) == LLVMFunctionTypeKind){
+        LLVMTypeRef function_type = LLVMGetElementType(type);
+        uint32_t count = LLVMCountParamTypes(function_type);
+        LLVMTypeRef *params = malloc(sizeof(LLVMTypeRef) * (count ? count : 1));
+        LLVMGetParamTypes(function_type, params);
+        snprintf(end, size, "fn(");
+        for(uint32_t i = 0; i<count; i++){
+            if(i > 0) strncat(end, ", ", size - strlen(end) - 1);
+            sema_write_type(end, size, params[i]);
+        }
+        if(LLVMIsFunctionVarArg(function_type))
+            strncat(end, count ? ", ...)" : "...)", size - strlen(end) - 1);
+        else strncat(end, ")", size - strlen(end) - 1);
+        if(LLVMGetTypeKind(LLVMGetReturnType(function_type)) != LLVMVoidTypeKind){
+            strncat(end, " -> ", size - strlen(end) - 1);
+            sema_write_type(end, size, LLVMGetReturnType(function_type));
+        }
+        free(params);
+    } else if(kind == LLVMPointerTypeKind){
+        snprintf(end, size, "*");
+        sema_write_type(end, size, LLVMGetElementType(type));
+    } else{
+        snprintf(end, size, "void");
+    }
+}
+
+// Name a copy of generic code like it is written, such as max<i32> or pair<*i8, f64>
+static char* sema_instance_name(ast_node_t *generic, LLVMTypeRef *types){
+    char name[1024];
+    snprintf(name, sizeof(name), "%s<", generic->name);
+    uint32_t i = 0;
+    for(ast_node_t *param = generic->right; param; param = param->next, i++){
+        if(i > 0) strncat(name, ", ", sizeof(name) - strlen(name) - 1);
+        sema_write_type(name, sizeof(name), types[i]);
+    }
+    strncat(name, ">", sizeof(name) - strlen(name) - 1);
+    return strdup(name);
+}
+
+// Match the type of a parameter against the type of an argument, binding the type parameters it uses
+// Literals only bind type parameters that no other argument binds, so max(x, 1) works for any x
+static void sema_unify(ast_node_t *arg, ast_node_t *generic, ast_node_t *node, LLVMTypeRef type, LLVMTypeRef *bindings, bool is_literal){
+    LLVMTypeKind kind = LLVMGetTypeKind(type);
+    if(node->kind == AST_TYPE_NAME && !node->list){
+        uint32_t i = 0;
+        for(ast_node_t *param = generic->right; param; param = param->next, i++){
+            if(strcmp(param->name, node->name) != 0) continue;
+            if(!bindings[i]) bindings[i] = type;
+            else if(bindings[i] != type && !is_literal){
+                char first[256] = "", second[256] = "";
+                sema_write_type(first, sizeof(first), bindings[i]);
+                sema_write_type(second, sizeof(second), type);
+                sema_error(arg, "Type parameter %s of %s is both %s and %s", param->name, generic->name, first, second);
+            }
+            return;
+        }
+    } else if(node->kind == AST_TYPE_NAME && kind == LLVMStructTypeKind){
+        // A generic structure matches the types that the argument's copy was made for
+        for(sema_instance_t *instance = sema_instances; instance; instance = instance->next){
+            if(instance->generic->kind != AST_STRUCT || strcmp(instance->generic->name, node->name) != 0
+                || get_type(instance->node->name, true) != type) continue;
+            uint32_t i = 0;
+            for(ast_node_t *type_arg = node->list; type_arg; type_arg = type_arg->next, i++)
+                sema_unify(arg, generic, type_arg, instance->types[i], bindings, is_literal);
+            return;
+        }
+    } else if(node->kind == AST_TYPE_POINTER && kind == LLVMPointerTypeKind){
+        sema_unify(arg, generic, node->left, LLVMGetElementType(type), bindings, is_literal);
+    } else if(node->kind == AST_TYPE_ARRAY && kind == LLVMArrayTypeKind){
+        sema_unify(arg, generic, node->left, LLVMGetElementType(type), bindings, is_literal);
+    } else if(node->kind == AST_TYPE_SLICE && get_slice_element(type)){
+        sema_unify(arg, generic, node->left, get_slice_element(type), bindings, is_literal);
+    } else if(node->kind == AST_TYPE_FUNCTION && kind == LLVMPointerTypeKind
+        && LLVMGetTypeKind(LLVMGetElementType(type)) == LLVMFunctionTypeKind){
+        LLVMTypeRef function_type = LLVMGetElementType(type);
+        uint32_t count = LLVMCountParamTypes(function_type);
+        if(count != ast_length(node->list)) return;
+        LLVMTypeRef *params = malloc(sizeof(LLVMTypeRef) * (count ? count : 1));
+        LLVMGetParamTypes(function_type, params);
+        uint32_t i = 0;
+        for(ast_node_t *param = node->list; param; param = param->next)
+            sema_unify(arg, generic, param, params[i++], bindings, is_literal);
+        if(node->left)
+            sema_unify(arg, generic, node->left, LLVMGetReturnType(function_type), bindings, is_literal);
+        free(params);
+    }
+    // Other mismatches are reported when the arguments are checked against the copy
+}
+
+static bool is_literal(ast_node_t *node){
+    return node->flags & AST_UNTYPED;
+}
+
+// Infer the type parameters of a generic function from the arguments of a call, then call the copy for them
+// Returns the type of each argument, since the arguments are only checked once
+static LLVMTypeRef *sema_generic_call(ast_node_t *node, ast_node_t *generic){
+    uint32_t length = ast_length(node->list);
+    if(length < ast_length(generic->list))
+        sema_error(node, "Incorrect number of parameters");
+    LLVMTypeRef *types = malloc(sizeof(LLVMTypeRef) * (length ? length : 1));
+    uint32_t i = 0;
+    for(ast_node_t *arg = node->list; arg; arg = arg->next)
+        types[i++] = sema_expression(arg);
+
+    uint32_t count = ast_length(generic->right);
+    LLVMTypeRef *bindings = calloc(count, sizeof(LLVMTypeRef));
+    for(int pass = 0; pass<2; pass++){
+        ast_node_t *param = generic->list;
+        i = 0;
+        for(ast_node_t *arg = node->list; arg && param; arg = arg->next, param = param->next, i++){
+            if(is_literal(arg) != (pass == 1)) continue;
+            // Untyped integer constants bind type parameters to i64
+            ast_node_t *type = (param->flags & AST_BYREF) ? param->left->left : param->left;
+            LLVMTypeRef arg_type = types[i];
+            if(pass == 1 && LLVMGetTypeKind(arg_type) == LLVMIntegerTypeKind) arg_type = LLVMInt64Type();
+            sema_unify(arg, generic, type, arg_type, bindings, pass == 1);
+        }
+    }
+    i = 0;
+    for(ast_node_t *param = generic->right; param; param = param->next, i++){
+        if(!bindings[i])
+            sema_error(node, "Couldn't infer type parameter %s of %s", param->name, generic->name);
+    }
+    node->left->name = sema_instantiate(generic, bindings)->name;
+    free(bindings);
+    return types;
+}
+
+static void sema_call(ast_node_t *node){
+    // Generic functions are called through the copy for the types of the arguments
+    LLVMTypeRef *arg_types = NULL;
+    if(node->left->kind == AST_IDENTIFIER){
+        sema_symbol_t *symbol = sema_lookup(node->left->name);
+        if(symbol && symbol->is_function && (symbol->declaration->flags & AST_GENERIC))
+            arg_types = sema_generic_call(node, symbol->declaration);
+    }
+
+    // Compile-time code can only call const functions, by name
+    if(in_const_code()){
+        sema_symbol_t *symbol = node->left->kind == AST_IDENTIFIER ? sema_lookup(node->left->name) : NULL;
+        if(!symbol || !symbol->is_function || !(symbol->declaration->flags & AST_CONST))
+            sema_error(node, "Only const functions can be called at compile time");
+    }
+
+    // Make sure the callee is a function pointer
+    LLVMTypeRef pointer_type = sema_expression(node->left);
+    if(LLVMGetTypeKind(pointer_type) != LLVMPointerTypeKind
+        || LLVMGetTypeKind(LLVMGetElementType(pointer_type)) != LLVMFunctionTypeKind)
+        sema_error(node, "Not a callable function");
+    LLVMTypeRef function_type = LLVMGetElementType(pointer_type);
+
+    // Check the number of arguments and the type of each fixed argument
+    uint32_t num_params = LLVMCountParamTypes(function_type);
+    uint32_t length = ast_length(node->list);
+    bool varg = LLVMIsFunctionVarArg(function_type);
+    if((!varg && length != num_params) || (varg && length < num_params))
+        sema_error(node, "Incorrect number of parameters");
+    LLVMTypeRef *params = malloc(sizeof(LLVMTypeRef) * (num_params ? num_params : 1));
+    LLVMGetParamTypes(function_type, params);
+
+    // Functions that are called by name can take references
+    ast_node_t *param = NULL;
+    if(node->left->kind == AST_IDENTIFIER){
+        sema_symbol_t *symbol = sema_lookup(node->left->name);
+        if(symbol->is_function) param = symbol->declaration->list;
+    }
+    uint32_t i = 0;
+    for(ast_node_t *arg = node->list; arg; arg = arg->next, i++){
+        LLVMTypeRef type = arg_types ? arg_types[i] : sema_expression(arg);
+        if(param && (param->flags & AST_BYREF)){
+            if(!(arg->flags & AST_LVALUE))
+                sema_error(arg, "Can only pass variables by reference");
+            sema_check_writable(arg);
+            if(type != LLVMGetElementType(params[i]))
+                sema_error(arg, "Reference to %s needs a value of the same type", param->name);
+            sema_escape(arg);
+            arg->flags |= AST_PASS_ADDRESS;
+        } else if(i < num_params)
+            sema_check_cast(arg, type, params[i], false);
+        else if(LLVMGetTypeKind(type) == LLVMVoidTypeKind)
+            sema_error(arg, "Cannot pass a void value");
+        else if(is_allocator(type))
+            sema_error(arg, "Regions and pools can only be passed by reference");
+        if(param) param = param->next;
+    }
+    free(params);
+    free(arg_types);
+    node->type = LLVMGetReturnType(function_type);
+}
+
+// Name and number of arguments of each builtin_t
+// Arguments from first_order on are memory orders
+typedef struct builtin_info {
+    const char* name;
+    uint32_t min_args;
+    uint32_t max_args;
+    uint32_t first_order;
+} builtin_info_t;
+
+static const builtin_info_t builtins[] = {
+    {"memcpy", 3, 3, 3}, {"memmove", 3, 3, 3}, {"memset", 3, 3, 3},
+    {"sqrt", 1, 1, 1}, {"fma", 3, 3, 3}, {"fabs", 1, 1, 1}, {"min", 2, 2, 2}, {"max", 2, 2, 2},
+    {"ctpop", 1, 1, 1}, {"ctlz", 1, 1, 1}, {"cttz", 1, 1, 1}, {"bswap", 1, 1, 1},
+    {"prefetch", 1, 3, 3}, {"expect", 2, 2, 2}, {"likely", 1, 1, 1}, {"unlikely", 1, 1, 1}, {"assume", 1, 1, 1},
+    {"atomic_load", 1, 2, 1}, {"atomic_store", 2, 3, 2}, {"atomic_cas", 3, 5, 3}, {"atomic_exchange", 2, 3, 2},
+    {"atomic_add", 2, 3, 2}, {"atomic_sub", 2, 3, 2}, {"atomic_and", 2, 3, 2}, {"atomic_or", 2, 3, 2},
+    {"atomic_xor", 2, 3, 2}, {"fence", 0, 1, 0}
+};
+
+// Names of the memory orders, which are written like identifiers
+static const char* order_names[] = {"relaxed", "acquire", "release", "acq_rel", "seq_cst"};
+static const LLVMAtomicOrdering orders[] = {LLVMAtomicOrderingMonotonic, LLVMAtomicOrderingAcquire,
+    LLVMAtomicOrderingRelease, LLVMAtomicOrderingAcquireRelease, LLVMAtomicOrderingSequentiallyConsistent};
+
+// Replace a memory order with its LLVMAtomicOrdering as an integer constant
+static void sema_order(ast_node_t *node){
+    uint32_t i;
+    for(i = 0; node->kind == AST_IDENTIFIER && i<sizeof(orders) / sizeof(LLVMAtomicOrdering); i++){
+        if(strcmp(node->name, order_names[i]) == 0) break;
+    }
+    if(node->kind != AST_IDENTIFIER || i == sizeof(orders) / sizeof(LLVMAtomicOrdering))
+        sema_error(node, "Expected relaxed, acquire, release, acq_rel or seq_cst");
+    node->kind = AST_INT;
+    node->int_value = orders[i];
+    node->type = LLVMInt8Type();
+}
+
+static void sema_check_pointer(ast_node_t *node){
+    if(LLVMGetTypeKind(node->type) != LLVMPointerTypeKind)
+        sema_error(node, "Expected a pointer");
+}
+
+static void sema_check_integer(ast_node_t *node){
+    if(LLVMGetTypeKind(node->type) != LLVMIntegerTypeKind)
+        sema_error(node, "Expected an integer");
+}
+
+// Atomic operations work on integers of whole bytes, and loads and stores also work on pointers and floats
+static LLVMTypeRef sema_atomic_pointer(ast_node_t *node, bool only_integers){
+    sema_check_pointer(node);
+    LLVMTypeRef type = LLVMGetElementType(node->type);
+    LLVMTypeKind kind = LLVMGetTypeKind(type);
+    if(kind == LLVMIntegerTypeKind && LLVMGetIntTypeWidth(type) >= 8) return type;
+    if(!only_integers && (kind == LLVMPointerTypeKind || kind == LLVMFloatTypeKind || kind == LLVMDoubleTypeKind))
+        return type;
+    sema_error(node, "Atomic operations need a pointer to an integer%s", only_integers ? "" : ", pointer or float");
+    return NULL;
+}
+
+static void sema_builtin(ast_node_t *node){
+    // Look up the builtin by name
+    uint32_t count = sizeof(builtins) / sizeof(builtin_info_t);
+    builtin_t builtin;
+    for(builtin = 0; builtin<count; builtin++){
+        if(strcmp(builtins[builtin].name, node->name) == 0) break;
+    }
+    if(builtin == count)
+        sema_error(node, "Unknown builtin @%s", node->name);
+    node->int_value = builtin;
+
+    // Check the arguments, which can't be void
+    uint32_t length = ast_length(node->list);
+    if(length < builtins[builtin].min_args || length > builtins[builtin].max_args)
+        sema_error(node, "Incorrect number of parameters to @%s", node->name);
+    ast_node_t *args[5];
+    uint32_t i = 0;
+    for(ast_node_t *arg = node->list; arg; arg = arg->next, i++){
+        args[i] = arg;
+        if(i >= builtins[builtin].first_order)
+            sema_order(arg);
+        else if(LLVMGetTypeKind(sema_expression(arg)) == LLVMVoidTypeKind)
+            sema_error(arg, "Cannot pass a void value");
+    }
+
+    switch(builtin){
+    case BUILTIN_MEMCPY:
+    case BUILTIN_MEMMOVE:
+        sema_check_pointer(args[0]);
+        sema_check_pointer(args[1]);
+        sema_check_integer(args[2]);
+        node->type = LLVMVoidType();
+        break;
+    case BUILTIN_MEMSET:
+        sema_check_pointer(args[0]);
+        sema_check_integer(args[1]);
+        sema_check_integer(args[2]);
+        node->type = LLVMVoidType();
+        break;
+    case BUILTIN_SQRT:
+    case BUILTIN_FABS:
+    case BUILTIN_FMA:
+        // Stay in single precision only if every operand is a float
+        node->type = LLVMFloatType();
+        for(i = 0; i<length; i++){
+            if(!is_number(args[i]->type))
+                sema_error(args[i], "Expected a number");
+            if(args[i]->type != LLVMFloatType()) node->type = LLVMDoubleType();
+        }
+        for(i = 0; i<length; i++) sema_check_cast(args[i], args[i]->type, node->type, false);
+        break;
+    case BUILTIN_MIN:
+    case BUILTIN_MAX:
+        node->type = sema_implicit_cast(node, args[0], args[1]);
+        if(!is_number(node->type))
+            sema_error(node, "@%s only supports numbers", node->name);
+        break;
+    case BUILTIN_BSWAP:
+        sema_check_integer(args[0]);
+        if(LLVMGetIntTypeWidth(args[0]->type) % 16 != 0)
+            sema_error(args[0], "@bswap needs an even number of bytes");
+        node->type = args[0]->type;
+        break;
+    case BUILTIN_CTPOP:
+    case BUILTIN_CTLZ:
+    case BUILTIN_CTTZ:
+        sema_check_integer(args[0]);
+        node->type = args[0]->type;
+        break;
+    case BUILTIN_PREFETCH:
+        // Whether the memory is written and how long it stays cached must be constants
+        sema_check_pointer(args[0]);
+        if(length > 1 && (sema_constant(args[1]) < 0 || args[1]->int_value > 1))
+            sema_error(args[1], "Expected 0 (read) or 1 (write)");
+        if(length > 2 && (sema_constant(args[2]) < 0 || args[2]->int_value > 3))
+            sema_error(args[2], "Locality must be between 0 and 3");
+        node->type = LLVMVoidType();
+        break;
+    case BUILTIN_EXPECT:
+        sema_check_integer(args[0]);
+        sema_check_cast(args[1], args[1]->type, args[0]->type, false);
+        node->type = args[0]->type;
+        break;
+    case BUILTIN_LIKELY:
+    case BUILTIN_UNLIKELY:
+        sema_check_truthy(args[0], args[0]->type);
+        node->type = LLVMInt1Type();
+        break;
+    case BUILTIN_ASSUME:
+        sema_check_truthy(args[0], args[0]->type);
+        node->type = LLVMVoidType();
+        break;
+    case BUILTIN_ATOMIC_LOAD:
+        node->type = sema_atomic_pointer(args[0], false);
+        if(length > 1 && (args[1]->int_value == LLVMAtomicOrderingRelease || args[1]->int_value == LLVMAtomicOrderingAcquireRelease))
+            sema_error(args[1], "Loads cannot release");
+        break;
+    case BUILTIN_ATOMIC_STORE:
+        sema_check_cast(args[1], args[1]->type, sema_atomic_pointer(args[0], false), false);
+        if(length > 2 && (args[2]->int_value == LLVMAtomicOrderingAcquire || args[2]->int_value == LLVMAtomicOrderingAcquireRelease))
+            sema_error(args[2], "Stores cannot acquire");
+        node->type = LLVMVoidType();
+        break;
+    case BUILTIN_ATOMIC_CAS:
+        // Returns the old value, which equals the expected value if the swap happened
+        node->type = sema_atomic_pointer(args[0], false);
+        if(LLVMGetTypeKind(node->type) != LLVMIntegerTypeKind && LLVMGetTypeKind(node->type) != LLVMPointerTypeKind)
+            sema_error(args[0], "@atomic_cas needs a pointer to an integer or pointer");
+        sema_check_cast(args[1], args[1]->type, node->type, false);
+        sema_check_cast(args[2], args[2]->type, node->type, false);
+        if(length > 4 && (args[4]->int_value == LLVMAtomicOrderingRelease || args[4]->int_value == LLVMAtomicOrderingAcquireRelease))
+            sema_error(args[4], "The failure order cannot release");
+        break;
+    case BUILTIN_ATOMIC_EXCHANGE:
+    case BUILTIN_ATOMIC_ADD:
+    case BUILTIN_ATOMIC_SUB:
+    case BUILTIN_ATOMIC_AND:
+    case BUILTIN_ATOMIC_OR:
+    case BUILTIN_ATOMIC_XOR:
+        node->type = sema_atomic_pointer(args[0], true);
+        sema_check_cast(args[1], args[1]->type, node->type, false);
+        break;
+    case BUILTIN_FENCE:
+        if(length > 0 && args[0]->int_value == LLVMAtomicOrderingMonotonic)
+            sema_error(args[0], "Fences cannot be relaxed");
+        node->type = LLVMVoidType();
+        break;
+    }
+}
+
+// Check the region or pool that new or delete uses
+static LLVMTypeRef sema_allocator(ast_node_t *node){
+    LLVMTypeRef type = sema_expression(node);
+    if(!is_allocator(type))
+        sema_error(node, "%s is not a region or pool", node->name);
+
+    // Regions and pools aren't thread safe, so each chunk of a parallel loop can only use its own
+    sema_symbol_t *symbol = sema_lookup(node->name);
+    if(sema_parallel && symbol->is_local && is_outside(sema_parallel, symbol))
+        sema_error(node, "Cannot use %s inside a parallel loop", node->name);
+    return type;
+}
+
+static LLVMTypeRef sema_expression(ast_node_t *node){
+    LLVMTypeRef left, right;
+    LLVMTypeKind kind;
+    sema_symbol_t *symbol;
+    agg_list_t *agg;
+    uint32_t field;
+    switch(node->kind){
+    case AST_ASSIGN:
+        left = sema_expression(node->left);
+        right = sema_expression(node->right);
+        if(!(node->left->flags & AST_LVALUE))
+            sema_error(node, "Cannot assign to this value");
+        if(is_allocator(left))
+            sema_error(node, "Cannot assign a region or pool");
+        sema_check_writable(node->left);
+        sema_check_cast(node->right, right, left, false);
+        node->type = node->right->type;
+        break;
+    case AST_MATH:
+        sema_expression(node->left);
+        sema_expression(node->right);
+        node->type = sema_implicit_cast(node, node->left, node->right);
+        if(!is_number(node->type))
+            sema_error(node, "Arithmetic operations only support numbers");
+        sema_fold(node);
+        break;
+    case AST_BITWISE:
+        sema_expression(node->left);
+        sema_expression(node->right);
+        node->type = sema_implicit_cast(node, node->left, node->right);
+        if(LLVMGetTypeKind(node->type) != LLVMIntegerTypeKind)
+            sema_error(node, "Bitwise operations only support integers");
+        sema_fold(node);
+        break;
+    case AST_BOOLEAN:
+        sema_check_truthy(node->left, sema_expression(node->left));
+        sema_check_truthy(node->right, sema_expression(node->right));
+        node->type = LLVMInt1Type();
+        break;
+    case AST_COMPARISON:
+        sema_expression(node->left);
+        sema_expression(node->right);
+        left = sema_implicit_cast(node, node->left, node->right);
+        if(!is_number(left) && LLVMGetTypeKind(left) != LLVMPointerTypeKind)
+            sema_error(node, "Cannot compare values of this type");
+        node->type = LLVMInt1Type();
+        break;
+    case AST_NEGATE:
+        node->type = sema_expression(node->left);
+        if(!is_number(node->type))
+            sema_error(node, "Arithmetic operations only support numbers");
+        sema_fold(node);
+        break;
+    case AST_BIT_NOT:
+        node->type = sema_expression(node->left);
+        if(LLVMGetTypeKind(node->type) != LLVMIntegerTypeKind)
+            sema_error(node, "Bitwise operations only support integers");
+        sema_fold(node);
+        break;
+    case AST_BOOL_NOT:
+        sema_check_truthy(node->left, sema_expression(node->left));
+        node->type = LLVMInt1Type();
+        break;
+    case AST_REF:
+        left = sema_expression(node->left);
+        if(!(node->left->flags & AST_LVALUE))
+            sema_error(node, "Cannot reference");
+        sema_escape(node->left);
+        node->type = LLVMPointerType(left, 0);
+        break;
+    case AST_DEREF:
+        left = sema_expression(node->left);
+        if(LLVMGetTypeKind(left) != LLVMPointerTypeKind)
+            sema_error(node, "Cannot dereference");
+        node->type = LLVMGetElementType(left);
+        node->flags |= AST_LVALUE;
+        break;
+    case AST_CALL:
+        sema_call(node);
+        break;
+    case AST_BUILTIN:
+        sema_builtin(node);
+        break;
+    case AST_CAST:
+        sema_expression(node->left);
+        node->type = sema_type(node->right);
+        sema_retype(node->left, node->type);
+        sema_check_cast(node, node->left->type, node->type, true);
+        break;
+    case AST_DOT:
+        left = sema_expression(node->left);
+        if(LLVMGetTypeKind(left) != LLVMStructTypeKind)
+            sema_error(node, "Can only dot structs");
+        agg = get_struct(left);
+        if(!agg || !get_index_map(&agg->fields, node->name, &field))
+            sema_error(node, "Couldn't find field %s", node->name);
+        node->type = agg->components.type_list.types[field];
+        node->flags |= node->left->flags & AST_LVALUE;
+        break;
+    case AST_INDEX:
+        left = sema_expression(node->left);
+        right = sema_expression(node->right);
+        kind = LLVMGetTypeKind(left);
+        if(LLVMGetTypeKind(right) != LLVMIntegerTypeKind
+            || (kind != LLVMArrayTypeKind && kind != LLVMPointerTypeKind && !get_slice_element(left)))
+            sema_error(node, "Invalid index");
+        if(kind == LLVMArrayTypeKind && !(node->left->flags & AST_LVALUE))
+            sema_error(node, "Cannot index a temporary array");
+        sema_retype(node->right, LLVMInt64Type());
+        node->type = get_slice_element(left) ? get_slice_element(left) : LLVMGetElementType(left);
+        node->flags |= AST_LVALUE;
+        break;
+    case AST_SLICE:
+        // Slices of local arrays point into the stack frame like references do
+        left = sema_expression(node->left);
+        kind = LLVMGetTypeKind(left);
+        if(kind == LLVMArrayTypeKind){
+            if(!(node->left->flags & AST_LVALUE))
+                sema_error(node, "Cannot slice a temporary array");
+            sema_escape(node->left);
+            right = LLVMGetElementType(left);
+        } else if(get_slice_element(left)){
+            right = get_slice_element(left);
+        } else if(kind == LLVMPointerTypeKind && node->body){
+            right = LLVMGetElementType(left);
+        } else{
+            sema_error(node, "Can only slice arrays, slices and pointers with an end");
+        }
+        if(node->right && LLVMGetTypeKind(sema_expression(node->right)) != LLVMIntegerTypeKind)
+            sema_error(node->right, "Slice bounds must be integers");
+        if(node->body && LLVMGetTypeKind(sema_expression(node->body)) != LLVMIntegerTypeKind)
+            sema_error(node->body, "Slice bounds must be integers");
+
+        // Indices and bounds are i64, so constant ones start out as i64
+        if(node->right) sema_retype(node->right, LLVMInt64Type());
+        if(node->body) sema_retype(node->body, LLVMInt64Type());
+        node->type = get_slice_type(right);
+        break;
+    case AST_SIZEOF:
+        sema_type(node->left);
+        node->type = LLVMInt64Type();
+        break;
+    case AST_NEW:
+        // Pools only allocate their own type, one value at a time
+        sema_check_runtime(node, "allocate memory");
+        left = sema_type(node->left);
+        if(LLVMGetTypeKind(left) == LLVMStructTypeKind && LLVMIsOpaqueStruct(left))
+            sema_error(node, "Cannot allocate a value of an incomplete type");
+        if(is_allocator(left))
+            sema_error(node, "Regions and pools can only be local variables");
+        if(node->right && LLVMGetTypeKind(sema_expression(node->right)) != LLVMIntegerTypeKind)
+            sema_error(node->right, "The number of values must be an integer");
+        if(node->body){
+            right = get_pool_element(sema_allocator(node->body));
+            if(right && node->right)
+                sema_error(node, "Pools allocate one value at a time");
+            if(right && right != left)
+                sema_error(node, "Pool %s holds a different type", node->body->name);
+        }
+        node->type = LLVMPointerType(left, 0);
+        break;
+    case AST_IDENTIFIER:
+        symbol = sema_lookup(node->name);
+        if(!symbol)
+            sema_error(node, "Couldn't find identifier %s", node->name);
+        if(symbol->is_function && (symbol->declaration->flags & AST_GENERIC))
+            sema_error(node, "Generic function %s can only be called", node->name);
+        // Compile-time code can only read locals of const functions and constant globals
+        if(!symbol->is_function && !symbol->is_constant){
+            if(sema_comptime)
+                sema_error(node, "%s is not known at compile time", node->name);
+            if(in_const_code() && !symbol->is_local)
+                sema_error(node, "const fn %s cannot use global %s", sema_current_function->name, node->name);
+        }
+        node->type = symbol->type;
+        if(!symbol->is_function) node->flags |= AST_LVALUE;
+        if(symbol->declaration->kind == AST_PARAM && (symbol->declaration->flags & AST_BYREF))
+            node->flags |= AST_BYREF;
+        if(symbol->is_local) sema_capture(symbol, node);
+        break;
+    case AST_COMPTIME:
+        if(in_const_code())
+            sema_error(node, "comptime cannot be used in code that already runs at compile time");
+        sema_comptime = node;
+        node->type = sema_expression(node->left);
+        sema_comptime = NULL;
+        if(LLVMGetTypeKind(node->type) == LLVMVoidTypeKind)
+            sema_error(node, "comptime needs an expression with a value");
+        if(has_pointer(node->type))
+            sema_error(node, "Values computed at compile time cannot contain pointers");
+        break;
+    case AST_INT:
+        // Literals with a suffix have the type the parser gave them
+        if(node->flags & AST_SUFFIX){
+            if(!fits_literal(node, LLVMGetIntTypeWidth(node->type)))
+                literal_error(node, LLVMGetIntTypeWidth(node->type));
+        } else if((node->flags & AST_BITS) && node->int_value < 0){
+            // Bit patterns that set the sign bit of i64 are i64, not small negative numbers
+            node->type = LLVMInt64Type();
+            node->flags |= AST_UNTYPED;
+        } else{
+            node->type = untyped_type(node->int_value);
+            node->flags |= AST_UNTYPED;
+        }
+        break;
+    case AST_FP:
+        node->type = LLVMDoubleType();
+        node->flags |= AST_UNTYPED;
+        break;
+    case AST_STRING:
+        node->type = LLVMPointerType(LLVMInt8Type(), 0);
+        break;
+    default:
+        sema_error(node, "Expected an expression");
+    }
+    return node->type;
+}
+
+// Check each value of an initializer list against the element or field it initializes
+static void sema_initializer(ast_node_t *node, LLVMTypeRef type){
+    agg_list_t *agg = LLVMGetTypeKind(type) == LLVMStructTypeKind ? get_struct(type) : NULL;
+    if(LLVMGetTypeKind(type) != LLVMArrayTypeKind && !agg)
+        sema_error(node, "Initializer lists can only initialize arrays and structures");
+    uint32_t length = agg ? agg->components.type_list.length : LLVMGetArrayLength(type);
+    if(ast_length(node->list) > length)
+        sema_error(node, "Initializer list has %u values, but only %u fit", ast_length(node->list), length);
+    uint32_t i = 0;
+    for(ast_node_t *value = node->list; value; value = value->next, i++){
+        LLVMTypeRef element = agg ? agg->components.type_list.types[i] : LLVMGetElementType(type);
+        if(value->kind == AST_INITIALIZER)
+            sema_initializer(value, element);
+        else
+            sema_check_cast(value, sema_expression(value), element, false);
+    }
+    node->type = type;
+}
+
+static void sema_declaration(ast_node_t *node){
+    LLVMTypeRef type = sema_type(node->left);
+    if(LLVMGetTypeKind(type) == LLVMStructTypeKind && LLVMIsOpaqueStruct(type))
+        sema_error(node, "Cannot declare a variable of an incomplete type");
+    if(is_allocator(type) && !(node->flags & AST_LOCAL))
+        sema_error(node, "Regions and pools can only be local variables");
+    if(is_allocator(type))
+        sema_check_runtime(node, "allocate memory");
+
+    // Each variable is visible to the initializers after it
+    // Constant globals and globals computed at compile time are read-only, so compile-time code can use them
+    for(ast_node_t *declarator = node->list; declarator; declarator = declarator->next){
+        bool is_comptime = declarator->right && declarator->right->kind == AST_COMPTIME && !(node->flags & AST_LOCAL);
+        if(declarator->right){
+            if(is_allocator(type))
+                sema_error(declarator->right, "Regions and pools start empty, and cannot be initialized");
+            if(is_comptime && (node->flags & AST_THREADLOCAL))
+                sema_error(declarator->right, "Thread-local globals cannot be computed at compile time");
+            if(declarator->right->kind == AST_INITIALIZER)
+                sema_initializer(declarator->right, type);
+            else
+                sema_check_cast(declarator->right, sema_expression(declarator->right), type, false);
+            if(!(node->flags & AST_LOCAL) && !is_constant(declarator->right))
+                sema_error(declarator->right, "Global initializers must be constant");
+        } else if(node->flags & AST_CONST)
+            sema_error(declarator, "Constant %s needs an initializer", declarator->name);
+        sema_declare(declarator, declarator->name, type, false)->is_constant = is_comptime || (node->flags & AST_CONST);
+    }
+}
+
+// Find the value of an integer constant, as the type sema gave it sees it
+// Casts zero extend i1 values and sign extend the others
+static bool literal_value(ast_node_t *node, int64_t *value){
+    if((node->kind != AST_INT && !(node->flags & AST_UNTYPED)) || LLVMGetTypeKind(node->type) != LLVMIntegerTypeKind)
+        return false;
+    unsigned width = LLVMGetIntTypeWidth(node->type);
+    if(width == 1 || width >= 64)
+        *value = node->int_value;
+    else
+        *value = (int64_t)((uint64_t)node->int_value << (64 - width)) >> (64 - width);
+    return true;
+}
+
+// Check whether a statement declares or assigns a variable, or is a parallel loop with that index
+static bool writes_variable(ast_node_t *node, char* name){
+    if(!node) return false;
+    if((node->kind == AST_ASSIGN && node->left->kind == AST_IDENTIFIER && strcmp(node->left->name, name) == 0)
+        || ((node->kind == AST_DECLARATOR || node->kind == AST_PARALLEL) && strcmp(node->name, name) == 0))
+        return true;
+    if(writes_variable(node->left, name) || writes_variable(node->right, name)) return true;
+    for(ast_node_t *child = node->body; child; child = child->next){
+        if(writes_variable(child, name)) return true;
+    }
+    for(ast_node_t *child = node->list; child; child = child->next){
+        if(writes_variable(child, name)) return true;
+    }
+    return false;
+}
+
+// Add up how much a loop body increases a variable in one iteration
+// The variable can only be changed by adding a literal, and not in a loop inside the body
+static bool loop_increment(ast_node_t *node, char* name, bool in_loop, int64_t *total){
+    if(!node) return true;
+    int64_t step;
+    if(node->kind == AST_ASSIGN && node->left->kind == AST_IDENTIFIER && strcmp(node->left->name, name) == 0){
+        ast_node_t *value = node->right;
+        if(in_loop || value->kind != AST_MATH || value->op != OP_ADD
+            || value->left->kind != AST_IDENTIFIER || strcmp(value->left->name, name) != 0
+            || !literal_value(value->right, &step) || step < 0)
+            return false;
+        *total += step;
+        return true;
+    }
+    if((node->kind == AST_DECLARATOR || node->kind == AST_PARALLEL) && strcmp(node->name, name) == 0)
+        return false;
+    in_loop = in_loop || node->kind == AST_WHILE || node->kind == AST_FOR || node->kind == AST_PARALLEL;
+    if(!loop_increment(node->left, name, in_loop, total) || !loop_increment(node->right, name, in_loop, total))
+        return false;
+    for(ast_node_t *child = node->body; child; child = child->next){
+        if(!loop_increment(child, name, in_loop, total)) return false;
+    }
+    for(ast_node_t *child = node->list; child; child = child->next){
+        if(!loop_increment(child, name, in_loop, total)) return false;
+    }
+    return true;
+}
+
+// Check whether a statement sets a variable to a literal that isn't negative
+static bool sets_variable(ast_node_t *node, char* name){
+    int64_t value;
+    if(node->kind == AST_ASSIGN && node->left->kind == AST_IDENTIFIER && strcmp(node->left->name, name) == 0)
+        return literal_value(node->right, &value) && value >= 0;
+    if(node->kind != AST_DECLARATION) return false;
+    for(ast_node_t *declarator = node->list; declarator; declarator = declarator->next){
+        if(strcmp(declarator->name, name) == 0)
+            return declarator->right && literal_value(declarator->right, &value) && value >= 0;
+    }
+    return false;
+}
+
+// Remember every index of an array with at least length elements by the variable
+static void find_indices(ast_node_t *node, char* name, int64_t length, ast_node_t *declaration){
+    if(!node) return;
+    if(node->kind == AST_INDEX && node->right->kind == AST_IDENTIFIER && strcmp(node->right->name, name) == 0
+        && LLVMGetTypeKind(node->left->type) == LLVMArrayTypeKind && LLVMGetArrayLength(node->left->type) >= length){
+        sema_bounds_t *bounds = malloc(sizeof(sema_bounds_t));
+        bounds->index = node;
+        bounds->declaration = declaration;
+        bounds->next = sema_bounds;
+        sema_bounds = bounds;
+    }
+    find_indices(node->left, name, length, declaration);
+    find_indices(node->right, name, length, declaration);
+    for(ast_node_t *child = node->body; child; child = child->next)
+        find_indices(child, name, length, declaration);
+    for(ast_node_t *child = node->list; child; child = child->next)
+        find_indices(child, name, length, declaration);
+}
+
+// Find indices that the condition of a while loop in a block keeps in bounds, like a[i] in
+//     i = 0; while(i < N){ a[i]; i = i + 1; }
+// i is a local that starts at a literal that isn't negative, and the body only adds literals to it
+// So 0 <= i < N holds until the first statement of the body that changes i
+// The block is checked after its statements, while the names in it are still declared
+static void sema_bounds_block(ast_node_t *block){
+    for(ast_node_t *loop = block->list; loop; loop = loop->next){
+        ast_node_t *condition = loop->left;
+        int64_t limit, total = 0;
+        if(loop->kind != AST_WHILE || condition->kind != AST_COMPARISON
+            || (condition->op != OP_LESS && condition->op != OP_LEQ)
+            || condition->left->kind != AST_IDENTIFIER || (condition->left->flags & AST_BYREF)
+            || !literal_value(condition->right, &limit))
+            continue;
+        char* name = condition->left->name;
+        sema_symbol_t *symbol = sema_lookup(name);
+        // Chunks of a parallel loop share the locals outside of it
+        if(!symbol->is_local || LLVMGetTypeKind(symbol->type) != LLVMIntegerTypeKind
+            || (sema_parallel && is_outside(sema_parallel, symbol)))
+            continue;
+        if(condition->op == OP_LEQ) limit++;
+
+        // The variable has to start at a literal, and be the one the block has declared so far
+        bool starts = false;
+        for(ast_node_t *statement = block->list; statement != loop; statement = statement->next){
+            if(sets_variable(statement, name)) starts = true;
+            else if(writes_variable(statement, name)) starts = false;
+        }
+        for(ast_node_t *statement = loop->next; statement; statement = statement->next){
+            if(statement->kind == AST_DECLARATION && writes_variable(statement, name)) starts = false;
+        }
+        if(!starts) continue;
+
+        // Adding to the variable can't wrap around before the condition is checked again
+        unsigned width = LLVMGetIntTypeWidth(symbol->type);
+        int64_t max = width >= 64 ? INT64_MAX : (int64_t)((1ULL << (width - 1)) - 1);
+        if(!loop_increment(loop->body, name, false, &total) || limit > max || total > max - limit) continue;
+
+        ast_node_t *statement = loop->body->kind == AST_BLOCK ? loop->body->list : loop->body;
+        for(; statement && !writes_variable(statement, name); statement = statement->next)
+            find_indices(statement, name, limit, symbol->declaration);
+    }
+}
+
+static void sema_statement(ast_node_t *node){
+    LLVMTypeRef return_type, type;
+    sema_loop_t *loop;
+    switch(node->kind){
+    case AST_BLOCK:
+        sema_push_scope();
+        for(ast_node_t *statement = node->list; statement; statement = statement->next)
+            sema_statement(statement);
+        sema_bounds_block(node);
+        sema_pop_scope();
+        break;
+    case AST_DECLARATION:
+        sema_declaration(node);
+        break;
+    case AST_IF:
+        sema_check_truthy(node->left, sema_expression(node->left));
+        sema_statement(node->body);
+        if(node->right) sema_statement(node->right);
+        break;
+    case AST_WHILE:
+        sema_check_truthy(node->left, sema_expression(node->left));
+        loop = malloc(sizeof(sema_loop_t));
+        loop->label = node->name;
+        loop->is_switch = false;
+        loop->is_parallel = false;
+        loop->prev = sema_loop;
+        sema_loop = loop;
+        sema_statement(node->body);
+        sema_loop = loop->prev;
+        free(loop);
+        break;
+    case AST_FOR:
+        // The element is a new variable in a scope around the body
+        type = sema_expression(node->left);
+        if(LLVMGetTypeKind(type) == LLVMArrayTypeKind && (node->left->flags & AST_LVALUE))
+            type = LLVMGetElementType(type);
+        else if(get_slice_element(type))
+            type = get_slice_element(type);
+        else
+            sema_error(node->left, "Can only loop over arrays and slices");
+        loop = malloc(sizeof(sema_loop_t));
+        loop->label = node->name;
+        loop->is_switch = false;
+        loop->is_parallel = false;
+        loop->prev = sema_loop;
+        sema_loop = loop;
+        sema_push_scope();
+        sema_declare(node->list, node->list->name, type, false);
+        sema_statement(node->body);
+        sema_pop_scope();
+        sema_loop = loop->prev;
+        free(loop);
+        break;
+    case AST_PARALLEL:
+        sema_check_runtime(node, "run parallel loops");
+        sema_parallel_for(node);
+        break;
+    case AST_SWITCH:
+        sema_switch(node);
+        break;
+    case AST_BREAK:
+        // Every chunk of a parallel loop runs to its end
+        if(!sema_loop)
+            sema_error(node, "break outside of a loop or switch");
+        for(loop = sema_loop; loop; loop = loop->prev){
+            if(loop->is_parallel)
+                sema_error(node, "Cannot break out of a parallel loop");
+            if(!node->name || (loop->label && strcmp(loop->label, node->name) == 0)) break;
+        }
+        if(node->name && !loop)
+            sema_error(node, "Couldn't find loop %s", node->name);
+        break;
+    case AST_CONTINUE:
+        // Continue ignores switches and goes to the loop around them
+        for(loop = sema_loop; loop; loop = loop->prev){
+            if(node->name && loop->is_parallel)
+                sema_error(node, "Cannot continue a loop outside of a parallel loop");
+            if(node->name && loop->label && strcmp(loop->label, node->name) == 0) break;
+            if(!node->name && !loop->is_switch) break;
+        }
+        if(!loop && node->name)
+            sema_error(node, "Couldn't find loop %s", node->name);
+        if(!loop)
+            sema_error(node, "continue outside of a loop");
+        if(loop->is_switch)
+            sema_error(node, "Cannot continue a switch");
+        break;
+    case AST_RETURN:
+        if(sema_parallel)
+            sema_error(node, "Cannot return from a parallel loop");
+        return_type = LLVMGetReturnType(sema_current_function->type);
+        if(node->flags & AST_TAIL){
+            sema_tail_call(node);
+        } else if(node->left){
+            if(return_type == LLVMVoidType())
+                sema_error(node, "Cannot return a value from a void function");
+            sema_check_cast(node->left, sema_expression(node->left), return_type, false);
+        } else if(return_type != LLVMVoidType()){
+            sema_error(node, "Missing return value");
+        }
+        break;
+    case AST_DELETE:
+        // Regions only free everything at once, at the end of their scope
+        sema_check_runtime(node, "free memory");
+        type = sema_expression(node->left);
+        if(LLVMGetTypeKind(type) != LLVMPointerTypeKind)
+            sema_error(node->left, "Can only delete pointers");
+        if(node->body){
+            return_type = get_pool_element(sema_allocator(node->body));
+            if(!return_type)
+                sema_error(node, "Cannot delete from region %s, which is freed at the end of its scope", node->body->name);
+            if(return_type != LLVMGetElementType(type))
+                sema_error(node, "Pool %s holds a different type", node->body->name);
+        }
+        break;
+    default:
+        sema_expression(node);
+    }
+}
+
+static void sema_tail_call(ast_node_t *node){
+    // The callee must take over the stack frame and return value of this function unchanged
+    ast_node_t *call = node->left;
+    if(call->kind != AST_CALL)
+        sema_error(node, "tail return needs a function call");
+    sema_expression(call);
+    LLVMTypeRef function_type = LLVMGetElementType(call->left->type);
+    if(function_type != sema_current_function->type)
+        sema_error(call, "tail return needs a function with the same type as %s", sema_current_function->name);
+    if(LLVMIsFunctionVarArg(function_type))
+        sema_error(call, "tail return cannot call a variadic function");
+    if(abi_uses_memory(abi_function(function_type)))
+        sema_error(call, "tail return cannot pass or return structures in memory");
+
+    // Regions and pools are freed before returning, but nothing can run after a musttail call
+    for(sema_scope_t *scope = sema_scope; scope->prev; scope = scope->prev){
+        for(int i = 0; i<SEMA_BUCKETS; i++){
+            for(sema_symbol_t *symbol = scope->symbols[i]; symbol; symbol = symbol->next){
+                if(is_allocator(symbol->type) && symbol->declaration->kind != AST_PARAM)
+                    sema_error(node, "tail return cannot be used while region or pool %s is in scope", symbol->name);
+            }
+        }
+    }
+    if(!sema_tail_return) sema_tail_return = node;
+}
+
+static void sema_parallel_for(ast_node_t *node){
+    sema_check_cast(node->left, sema_expression(node->left), LLVMInt64Type(), false);
+    sema_check_cast(node->right, sema_expression(node->right), LLVMInt64Type(), false);
+
+    // Each chunk reduces into a private copy that starts at the identity of the operator
+    for(ast_node_t *reduction = node->list; reduction; reduction = reduction->next){
+        sema_symbol_t *symbol = sema_lookup(reduction->name);
+        if(!symbol || symbol->is_function)
+            sema_error(reduction, "Couldn't find variable %s", reduction->name);
+        if(!is_number(symbol->type))
+            sema_error(reduction, "Can only reduce numbers");
+        if((reduction->op == OP_BIT_AND || reduction->op == OP_BIT_OR || reduction->op == OP_BIT_XOR)
+            && LLVMGetTypeKind(symbol->type) != LLVMIntegerTypeKind)
+            sema_error(reduction, "Bitwise reductions only support integers");
+        for(ast_node_t *other = node->list; other != reduction; other = other->next){
+            if(strcmp(other->name, reduction->name) == 0)
+                sema_error(reduction, "%s is reduced more than once", reduction->name);
+        }
+        reduction->type = symbol->type;
+        if(symbol->declaration->kind == AST_PARAM)
+            reduction->flags |= symbol->declaration->flags & AST_BYREF;
+        if(symbol->is_local) sema_capture(symbol, reduction);
+    }
+
+    // The body can continue to its next iteration, but can't leave the loop
+    sema_parallel_t *parallel = malloc(sizeof(sema_parallel_t));
+    parallel->scope = sema_scope;
+    parallel->node = node;
+    parallel->prev = sema_parallel;
+    sema_parallel = parallel;
+    sema_loop_t *loop = malloc(sizeof(sema_loop_t));
+    loop->label = NULL;
+    loop->is_switch = false;
+    loop->is_parallel = true;
+    loop->prev = sema_loop;
+    sema_loop = loop;
+    sema_push_scope();
+    sema_declare(node, node->name, LLVMInt64Type(), false);
+    sema_statement(node->body);
+    sema_pop_scope();
+    sema_loop = loop->prev;
+    free(loop);
+    sema_parallel = parallel->prev;
+    free(parallel);
+}
+
+// Sort case ranges by their lowest value
+static int compare_ranges(const void* a, const void* b){
+    const case_range_t *left = a;
+    const case_range_t *right = b;
+    if(left->low == right->low) return 0;
+    return left->low < right->low ? -1 : 1;
+}
+
+// Largest number of values a single case range can cover
+#define MAX_CASE_RANGE 65536
+
+// Find the value of a case as the type of the switch sees it
+// Bit patterns like 0xFF in an i8 switch are sign extended, so they are compared and emitted as -1
+static int64_t case_value(ast_node_t *node, unsigned width){
+    int64_t value = sema_constant(node);
+    if(node->kind == AST_INT && (node->flags & AST_BITS) && width > 1 && width < 64 && fits_literal(node, width))
+        node->int_value = value = (int64_t)((uint64_t)value << (64 - width)) >> (64 - width);
+    return value;
+}
+
+static void sema_switch(ast_node_t *node){
+    LLVMTypeRef type = sema_expression(node->left);
+    if(LLVMGetTypeKind(type) != LLVMIntegerTypeKind)
+        sema_error(node->left, "Can only switch on integers");
+    unsigned width = LLVMGetIntTypeWidth(type);
+
+    // Evaluate the values of every case
+    uint32_t count = 0, capacity = 8;
+    case_range_t *ranges = malloc(sizeof(case_range_t) * capacity);
+    bool has_default = false;
+    for(ast_node_t *current = node->list; current; current = current->next){
+        if(current->flags & AST_DEFAULT){
+            if(has_default)
+                sema_error(current, "Multiple default cases");
+            has_default = true;
+        }
+        for(ast_node_t *value = current->list; value; value = value->next){
+            if(count == capacity){
+                capacity *= 2;
+                ranges = realloc(ranges, sizeof(case_range_t) * capacity);
+            }
+            ranges[count].node = value;
+            if(value->kind == AST_RANGE){
+                ranges[count].low = case_value(value->left, width);
+                ranges[count].high = case_value(value->right, width);
+                if(ranges[count].low > ranges[count].high)
+                    sema_error(value, "Empty case range");
+                if(ranges[count].high - ranges[count].low >= MAX_CASE_RANGE)
+                    sema_error(value, "Case range is too large");
+            } else{
+                ranges[count].low = ranges[count].high = case_value(value, width);
+            }
+
+            // Values must fit in the type of the switch as signed values, like literals, so that
+            // -1 and 255 of an i8 switch don't both become the same case
+            if(!fits_integer(ranges[count].low, width) || !fits_integer(ranges[count].high, width))
+                sema_error(value, "Case value doesn't fit in the switch type");
+            count++;
+        }
+    }
+
+    // No value may be matched by more than one case
+    qsort(ranges, count, sizeof(case_range_t), compare_ranges);
+    for(uint32_t i = 1; i<count; i++){
+        if(ranges[i].low <= ranges[i-1].high)
+            sema_error(ranges[i].node, "Duplicate case value");
+    }
+    free(ranges);
+    if(has_default) node->flags |= AST_DEFAULT;
+
+    // All cases share one scope, and break leaves the switch
+    sema_loop_t *loop = malloc(sizeof(sema_loop_t));
+    loop->label = node->name;
+    loop->is_switch = true;
+    loop->is_parallel = false;
+    loop->prev = sema_loop;
+    sema_loop = loop;
+    sema_push_scope();
+    for(ast_node_t *current = node->list; current; current = current->next){
+        for(ast_node_t *statement = current->body; statement; statement = statement->next)
+            sema_statement(statement);
+    }
+    sema_pop_scope();
+    sema_loop = loop->prev;
+    free(loop);
+}
+
+// Find the definition of a structure in the program
+static ast_node_t *find_struct(ast_node_t *program, const char* name){
+    for(ast_node_t *node = program; node; node = node->next){
+        if(node->kind == AST_STRUCT && !(node->flags & AST_OPAQUE) && strcmp(node->name, name) == 0)
+            return node;
+    }
+    return NULL;
+}
+
+static void sema_struct(ast_node_t *program, ast_node_t *node){
+    if(node->flags & AST_RESOLVED) return;
+    if(node->flags & AST_VISITING)
+        sema_error(node, "Structure %s contains itself", node->name);
+    node->flags |= AST_VISITING;
+
+    struct_def_t def;
+    initialize_struct_def(&def);
+    for(ast_node_t *field = node->list; field; field = field->next){
+        // Structures stored by value must be laid out before this one
+        LLVMTypeRef type = sema_type(field->left);
+        if(is_allocator(type))
+            sema_error(field, "Field %s cannot be a region or pool", field->name);
+        LLVMTypeRef element = type;
+        while(LLVMGetTypeKind(element) == LLVMArrayTypeKind)
+            element = LLVMGetElementType(element);
+        if(LLVMGetTypeKind(element) == LLVMStructTypeKind && LLVMIsOpaqueStruct(element)){
+            ast_node_t *definition = find_struct(program, LLVMGetStructName(element));
+            if(!definition)
+                sema_error(field, "Field %s has an incomplete type", field->name);
+            sema_struct(program, definition);
+        }
+        insert_struct_def(&def, type, field->name, field->int_value);
+    }
+    def.align = node->int_value;
+    def.packed = node->flags & AST_PACKED;
+    def.reorder = node->flags & AST_REORDER;
+    create_struct(node->name, &def);
+
+    node->flags &= ~AST_VISITING;
+    node->flags |= AST_RESOLVED;
+}
+
+static ast_node_t *sema_instantiate(ast_node_t *generic, LLVMTypeRef *types){
+    uint32_t count = ast_length(generic->right);
+    for(sema_instance_t *instance = sema_instances; instance; instance = instance->next){
+        if(instance->generic == generic && memcmp(instance->types, types, sizeof(LLVMTypeRef) * count) == 0)
+            return instance->node;
+    }
+
+    // Remember the copy before resolving it, so that it can refer to itself
+    sema_instance_t *instance = malloc(sizeof(sema_instance_t));
+    instance->generic = generic;
+    instance->types = malloc(sizeof(LLVMTypeRef) * count);
+    memcpy(instance->types, types, sizeof(LLVMTypeRef) * count);
+    instance->node = ast_instantiate(generic, types);
+    instance->node->name = sema_instance_name(generic, types);
+    instance->next = sema_instances;
+    sema_instances = instance;
+    sema_program_tail->next = instance->node;
+    sema_program_tail = instance->node;
+
+    ast_node_t *node = instance->node;
+    if(node->kind == AST_STRUCT){
+        create_struct(node->name, NULL);
+        sema_struct(sema_program_head, node);
+    } else{
+        // The body is checked after the functions before it, like the rest of the program
+        sema_scope_t *scope = sema_scope;
+        sema_scope = sema_globals;
+        node->type = sema_function_type(node);
+        sema_symbol_t *symbol = sema_declare(node, node->name, LLVMPointerType(node->type, 0), true);
+        symbol->definition = node;
+        sema_scope = scope;
+    }
+    return node;
+}
+
+void sema_program(ast_node_t *program){
+    ast_node_t *node;
+    sema_push_scope();
+    sema_globals = sema_scope;
+    sema_program_head = program;
+    for(sema_program_tail = program; sema_program_tail && sema_program_tail->next; )
+        sema_program_tail = sema_program_tail->next;
+
+    // Declare every structure first so that they can be used before they are defined
+    // Generic structures are only laid out for the types they are used with
+    for(node = program; node; node = node->next){
+        if(node->kind == AST_STRUCT && !(node->flags & AST_GENERIC)) create_struct(node->name, NULL);
+    }
+    for(node = program; node; node = node->next){
+        if(node->kind == AST_TYPEDEF) create_type(node->name, sema_type(node->left));
+    }
+    for(node = program; node; node = node->next){
+        if(node->kind == AST_STRUCT && !(node->flags & (AST_OPAQUE | AST_GENERIC))) sema_struct(program, node);
+    }
+
+    // Declare every function and global so that they can be used anywhere in the program
+    for(node = program; node; node = node->next){
+        if(node->kind != AST_FUNCTION) continue;
+        if(node->flags & AST_GENERIC){
+            // Generic functions are checked once for each copy, which calls make
+            if(!node->body)
+                sema_error(node, "Generic function %s needs a body", node->name);
+            if(sema_lookup(node->name))
+                sema_error(node, "Identifier %s already defined", node->name);
+            sema_declare(node, node->name, NULL, true);
+            continue;
+        }
+        node->type = sema_function_type(node);
+        sema_symbol_t *symbol = sema_declare(node, node->name, LLVMPointerType(node->type, 0), true);
+        if(node->body && symbol->definition)
+            sema_error(node, "Function %s is already defined", node->name);
+        for(ast_node_t *param = node->list, *first = symbol->declaration->list; param; param = param->next, first = first->next){
+            if((param->flags & AST_BYREF) != (first->flags & AST_BYREF))
+                sema_error(param, "Function %s redeclared with different references", node->name);
+        }
+        if((node->flags & AST_CONST) != (symbol->declaration->flags & AST_CONST))
+            sema_error(node, "Function %s is only const in some declarations", node->name);
+        if(node->body) symbol->definition = node;
+    }
+    for(node = program; node; node = node->next){
+        if(node->kind == AST_FUNCTION && (node->flags & AST_CONST) && !(node->flags & AST_GENERIC)
+            && !sema_lookup(node->name)->definition)
+            sema_error(node, "const fn %s needs a body, so it can run at compile time", node->name);
+    }
+    for(node = program; node; node = node->next){
+        if(node->kind == AST_DECLARATION) sema_declaration(node);
+    }
+
+    // Check the body of each function
+    for(node = program; node; node = node->next){
+        if(node->kind != AST_FUNCTION || !node->body || (node->flags & AST_GENERIC)) continue;
+        sema_current_function = node;
+        sema_push_scope();
+        for(ast_node_t *param = node->list; param; param = param->next){
+            LLVMTypeRef type = param->left->type;
+            if(param->flags & AST_BYREF) type = LLVMGetElementType(type);
+            sema_declare(param, param->name, type, false);
+        }
+        sema_statement(node->body);
+        sema_pop_scope();
+        if(sema_tail_return && (node->flags & AST_ESCAPES))
+            sema_error(sema_tail_return, "tail return in a function that takes the address of a local");
+        sema_tail_return = NULL;
+
+        // Indices stay in bounds if their variable can't change through a pointer
+        while(sema_bounds){
+            sema_bounds_t *bounds = sema_bounds;
+            if(!(bounds->declaration->flags & AST_ESCAPES))
+                bounds->index->flags |= AST_IN_BOUNDS;
+            sema_bounds = bounds->next;
+            free(bounds);
+        }
+    }
+    sema_current_function = NULL;
+    sema_pop_scope();
+}
@@ -0,0 +1,87 @@
+#ifndef SEMA_H
+#define SEMA_H
+
+#include <stdbool.h>
+#include <llvm-c/Core.h>
+#include "ast.h"
+
+// A name visible to the type checker
+typedef struct sema_symbol {
+    struct sema_symbol *next;
+    char* name;
+    LLVMTypeRef type;
+    bool is_function;
+    bool is_local;
+    bool is_constant; // Read-only, and known at compile time
+    ast_node_t *declaration; // First declaration of the name
+    ast_node_t *definition; // Function definition, once its body has been seen
+} sema_symbol_t;
+
+// Number of buckets in the symbol hash table of each scope
+#define SEMA_BUCKETS 64
+
+// Store the names declared in each scope
+// Every function and global is in the outermost scope, so lookups are hashed
+typedef struct sema_scope {
+    struct sema_scope *prev;
+    sema_symbol_t *symbols[SEMA_BUCKETS];
+} sema_scope_t;
+
+// Store the label of each loop or switch that is being checked
+typedef struct sema_loop {
+    struct sema_loop *prev;
+    char* label;
+    bool is_switch;
+    bool is_parallel;
+} sema_loop_t;
+
+// Store each parallel loop that is being checked
+// Locals declared in its scope or the scopes around it are captured by its body
+typedef struct sema_parallel {
+    struct sema_parallel *prev;
+    sema_scope_t *scope;
+    ast_node_t *node;
+} sema_parallel_t;
+
+// Store each copy of a generic function or structure, by the types it was made for
+// Each copy is only made and generated once
+typedef struct sema_instance {
+    struct sema_instance *next;
+    ast_node_t *generic;
+    LLVMTypeRef *types;
+    ast_node_t *node;
+} sema_instance_t;
+
+// Store an array index that is in bounds if its variable can't change through a pointer
+// Whether it can is only known at the end of the function
+typedef struct sema_bounds {
+    struct sema_bounds *next;
+    ast_node_t *index;
+    ast_node_t *declaration;
+} sema_bounds_t;
+
+// Store the values that a case of a switch matches
+typedef struct case_range {
+    int64_t low;
+    int64_t high;
+    ast_node_t *node;
+} case_range_t;
+
+// Report an error at the location of a node and exit
+void sema_error(ast_node_t *node, const char* format, ...);
+
+// Resolve a type node to an LLVM type
+LLVMTypeRef sema_type(ast_node_t *node);
+
+// Evaluate an integer constant expression
+// The value is also stored in the int_value of the node
+int64_t sema_constant(ast_node_t *node);
+
+// Check whether a value of one type can be cast to another
+bool sema_can_cast(LLVMTypeRef from, LLVMTypeRef to, bool is_explicit);
+
+// Resolve every type and check every expression of the program
+// Sets the type of each expression node before code generation
+void sema_program(ast_node_t *program);
+
+#endif
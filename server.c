@@ -0,0 +1,138 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#ifdef __linux__
+#include <sys/prctl.h>
+#endif
+#include "server.h"
+
+// Size of the buffers for requests and output
+#define SERVER_BUFFER 4096
+
+// Open a Unix domain socket at a path
+static int open_socket(char* socket_path, struct sockaddr_un *address){
+    if(strlen(socket_path) >= sizeof(address->sun_path)){
+        printf("Socket path is too long: %s\n", socket_path);
+        exit(1);
+    }
+    memset(address, 0, sizeof(struct sockaddr_un));
+    address->sun_family = AF_UNIX;
+    strcpy(address->sun_path, socket_path);
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if(fd < 0){
+        printf("Couldn't create a socket\n");
+        exit(1);
+    }
+    return fd;
+}
+
+// Read a whole request, which the client ends by shutting down its side
+static void read_request(int fd, request_t *request){
+    size_t length = 0, capacity = SERVER_BUFFER;
+    request->buffer = malloc(capacity);
+    ssize_t count;
+    while((count = read(fd, request->buffer + length, capacity - length - 1)) > 0){
+        length += count;
+        if(length + 1 == capacity){
+            capacity *= 2;
+            request->buffer = realloc(request->buffer, capacity);
+        }
+    }
+    request->buffer[length] = 0;
+
+    // The directory and each argument end with a null character
+    int strings = 0;
+    for(size_t i = 0; i<length; i++)
+        strings += request->buffer[i] == 0;
+    request->argc = strings > 0 ? strings - 1 : 0;
+    request->argv = malloc(sizeof(char*) * (request->argc + 1));
+    request->directory = request->buffer;
+    char* current = request->buffer + strlen(request->buffer) + 1;
+    for(int i = 0; i<request->argc; i++){
+        request->argv[i] = current;
+        current += strlen(current) + 1;
+    }
+    request->argv[request->argc] = NULL;
+}
+
+// Take one request from the socket and compile it
+// The output of the compiler goes back to the client, and the process exits when it is done
+static void run_worker(int listener, compile_fn_t compile){
+#ifdef __linux__
+    // Workers are blocked in accept(), so they must not outlive the server
+    prctl(PR_SET_PDEATHSIG, SIGTERM);
+#endif
+    int fd = accept(listener, NULL, NULL);
+    if(fd < 0) exit(1);
+    close(listener);
+    request_t request;
+    read_request(fd, &request);
+    dup2(fd, STDOUT_FILENO);
+    dup2(fd, STDERR_FILENO);
+    close(fd);
+    if(request.argc < 1 || chdir(request.directory) != 0){
+        printf("Invalid request\n");
+        exit(0);
+    }
+    compile(request.argc, request.argv);
+    exit(0);
+}
+
+static pid_t start_worker(int listener, compile_fn_t compile){
+    pid_t pid = fork();
+    if(pid == 0) run_worker(listener, compile);
+    return pid;
+}
+
+void serve(char* socket_path, uint32_t workers, compile_fn_t compile){
+    struct sockaddr_un address;
+    int listener = open_socket(socket_path, &address);
+    unlink(socket_path);
+    if(bind(listener, (struct sockaddr*)&address, sizeof(address)) != 0 || listen(listener, 128) != 0){
+        printf("Couldn't listen on %s\n", socket_path);
+        exit(1);
+    }
+    printf("Serving on %s with %u workers\n", socket_path, workers);
+    fflush(stdout);
+
+    // Keep the same number of workers waiting for requests
+    for(uint32_t i = 0; i<workers; i++)
+        start_worker(listener, compile);
+    for(;;){
+        if(wait(NULL) > 0)
+            start_worker(listener, compile);
+    }
+}
+
+int send_request(char* socket_path, int argc, char** argv){
+    struct sockaddr_un address;
+    int fd = open_socket(socket_path, &address);
+    if(connect(fd, (struct sockaddr*)&address, sizeof(address)) != 0){
+        printf("Couldn't connect to the compile server on %s\n", socket_path);
+        return 1;
+    }
+
+    // Send the working directory and the arguments, then print the output until the worker exits
+    char directory[SERVER_BUFFER];
+    if(!getcwd(directory, SERVER_BUFFER)){
+        printf("Couldn't get the working directory\n");
+        return 1;
+    }
+    FILE* out = fdopen(dup(fd), "w");
+    fwrite(directory, 1, strlen(directory) + 1, out);
+    for(int i = 0; i<argc; i++)
+        fwrite(argv[i], 1, strlen(argv[i]) + 1, out);
+    fclose(out);
+    shutdown(fd, SHUT_WR);
+    char buffer[SERVER_BUFFER];
+    ssize_t count;
+    while((count = read(fd, buffer, SERVER_BUFFER)) > 0)
+        fwrite(buffer, 1, count, stdout);
+    close(fd);
+    return 0;
+}
@@ -0,0 +1,26 @@
+#ifndef SERVER_H
+#define SERVER_H
+
+#include <stdint.h>
+
+// Compile one command line, in the directory it was run from
+typedef void (*compile_fn_t)(int argc, char** argv);
+
+// Store a command line sent to the server
+// The strings point into the buffer, which holds the directory then each argument
+typedef struct request {
+    char* buffer;
+    char* directory;
+    char** argv;
+    int argc;
+} request_t;
+
+// Serve compile commands on a Unix domain socket until the server is killed
+// Each worker process is forked after LLVM is initialized, takes one request, and is replaced
+void serve(char* socket_path, uint32_t workers, compile_fn_t compile);
+
+// Send a command line to a server and print what it outputs
+// Returns 1 if the server couldn't be reached
+int send_request(char* socket_path, int argc, char** argv);
+
+#endif
@@ -0,0 +1,219 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <llvm-c/Object.h>
+#include "stats.h"
+#include "table.h"
+
+// Number of buckets in the function hash table
+#define STATS_BUCKETS 256
+
+// Store the state needed to count the module
+LLVMModuleRef stats_module = NULL;
+LLVMBuilderRef stats_builder;
+char* stats_file;
+stats_list_t *stats_first = NULL;
+stats_list_t *stats_last = NULL;
+stats_list_t *stats_buckets[STATS_BUCKETS];
+bool stats_optimized = false;
+
+void stats_initialize(LLVMModuleRef module, LLVMBuilderRef builder, char* output_file){
+    stats_module = module;
+    stats_builder = builder;
+    stats_file = output_file;
+}
+
+// Find the statistics of a function, and create them if it wasn't seen yet
+static stats_list_t* stats_find(const char* name, size_t length, bool create){
+    stats_list_t **bucket = &stats_buckets[hash_name_length(name, length) & (STATS_BUCKETS - 1)];
+    for(stats_list_t *current = *bucket; current; current = current->bucket_next)
+        if(strlen(current->name) == length && memcmp(current->name, name, length) == 0)
+            return current;
+    if(!create) return NULL;
+
+    stats_list_t *stats = calloc(1, sizeof(stats_list_t));
+    stats->name = strndup(name, length);
+    stats->bucket_next = *bucket;
+    *bucket = stats;
+    if(stats_last)
+        stats_last->next = stats;
+    else
+        stats_first = stats;
+    stats_last = stats;
+    return stats;
+}
+
+// Find the statistics of the function the builder is positioned in
+static stats_list_t* stats_current(){
+    LLVMBasicBlockRef block = LLVMGetInsertBlock(stats_builder);
+    if(!block) return stats_find("", 0, true);
+    size_t length;
+    const char* name = LLVMGetValueName2(LLVMGetBasicBlockParent(block), &length);
+    return stats_find(name, length, true);
+}
+
+void stats_cast(LLVMValueRef value){
+    if(!stats_module) return;
+    if(LLVMIsConstant(value))
+        stats_current()->folded_casts++;
+    else
+        stats_current()->casts++;
+}
+
+void stats_statement(){
+    if(!stats_module) return;
+    LLVMBasicBlockRef block = LLVMGetInsertBlock(stats_builder);
+    if(block && LLVMGetBasicBlockTerminator(block))
+        stats_current()->dead_statements++;
+}
+
+void stats_count(bool optimized){
+    if(!stats_module) return;
+    stats_optimized = optimized;
+    for(LLVMValueRef fn = LLVMGetFirstFunction(stats_module); fn; fn = LLVMGetNextFunction(fn)){
+        if(LLVMIsDeclaration(fn)) continue;
+        size_t length;
+        const char* name = LLVMGetValueName2(fn, &length);
+        stats_list_t *stats = stats_find(name, length, true);
+        stats_counts_t *counts = optimized ? &stats->after : &stats->before;
+        memset(counts, 0, sizeof(stats_counts_t));
+        if(optimized)
+            stats->has_after = true;
+        else
+            stats->has_before = true;
+
+        for(LLVMBasicBlockRef block = LLVMGetFirstBasicBlock(fn); block; block = LLVMGetNextBasicBlock(block)){
+            counts->blocks++;
+            for(LLVMValueRef inst = LLVMGetFirstInstruction(block); inst; inst = LLVMGetNextInstruction(inst)){
+                // Debug info intrinsics don't become code, so -g doesn't change the counts
+                if(LLVMIsADbgInfoIntrinsic(inst)) continue;
+                counts->instructions++;
+                if(LLVMIsAAllocaInst(inst)) counts->allocas++;
+                else if(LLVMIsALoadInst(inst)) counts->loads++;
+                else if(LLVMIsAStoreInst(inst)) counts->stores++;
+                else if(LLVMIsACallInst(inst)) counts->calls++;
+                else if(LLVMIsACastInst(inst)) counts->casts++;
+            }
+        }
+    }
+}
+
+// Find the size of each function in an object emitted from a copy of the module
+// The code generator changes the IR it runs on, so the module itself isn't emitted
+static void stats_code_size(LLVMTargetMachineRef machine){
+    char* error = NULL;
+    LLVMModuleRef copy = LLVMCloneModule(stats_module);
+    LLVMMemoryBufferRef buffer;
+    if(LLVMTargetMachineEmitToMemoryBuffer(machine, copy, LLVMObjectFile, &error, &buffer)){
+        printf("%s\n", error);
+        LLVMDisposeMessage(error);
+        LLVMDisposeModule(copy);
+        return;
+    }
+    LLVMDisposeModule(copy);
+
+    LLVMBinaryRef binary = LLVMCreateBinary(buffer, LLVMGetGlobalContext(), &error);
+    if(!binary){
+        printf("%s\n", error);
+        LLVMDisposeMessage(error);
+        LLVMDisposeMemoryBuffer(buffer);
+        return;
+    }
+    LLVMSymbolIteratorRef symbol = LLVMObjectFileCopySymbolIterator(binary);
+    for(; !LLVMObjectFileIsSymbolIteratorAtEnd(binary, symbol); LLVMMoveToNextSymbol(symbol)){
+        const char* name = LLVMGetSymbolName(symbol);
+        if(!*name) continue;
+        stats_list_t *stats = stats_find(name, strlen(name), false);
+        if(stats)
+            stats->code_size = LLVMGetSymbolSize(symbol);
+    }
+    LLVMDisposeSymbolIterator(symbol);
+    LLVMDisposeBinary(binary);
+    LLVMDisposeMemoryBuffer(buffer);
+}
+
+// Write a name as a JSON string, which only needs quotes and backslashes escaped
+static void stats_write_name(FILE *fp, char* name){
+    fputc('"', fp);
+    for(; *name; name++){
+        if(*name == '"' || *name == '\\')
+            fputc('\\', fp);
+        fputc(*name, fp);
+    }
+    fputc('"', fp);
+}
+
+static void stats_write_counts(FILE *fp, stats_counts_t *counts, bool has_counts){
+    if(!has_counts){
+        fprintf(fp, "null");
+        return;
+    }
+    fprintf(fp, "{\"blocks\": %u, \"instructions\": %u, \"allocas\": %u, \"loads\": %u, \"stores\": %u, \"calls\": %u, \"casts\": %u}",
+        counts->blocks, counts->instructions, counts->allocas, counts->loads, counts->stores, counts->calls, counts->casts);
+}
+
+static void stats_add_counts(stats_counts_t *total, stats_counts_t *counts){
+    total->blocks += counts->blocks;
+    total->instructions += counts->instructions;
+    total->allocas += counts->allocas;
+    total->loads += counts->loads;
+    total->stores += counts->stores;
+    total->calls += counts->calls;
+    total->casts += counts->casts;
+}
+
+static void stats_write_record(FILE *fp, stats_list_t *stats){
+    fprintf(fp, "\"casts\": %u, \"folded_casts\": %u, \"dead_statements\": %u, \"before\": ",
+        stats->casts, stats->folded_casts, stats->dead_statements);
+    stats_write_counts(fp, &stats->before, stats->has_before);
+    fprintf(fp, ", \"after\": ");
+    stats_write_counts(fp, &stats->after, stats->has_after);
+    fprintf(fp, ", \"code_size\": %lu", stats->code_size);
+}
+
+void stats_finalize(LLVMTargetMachineRef machine){
+    if(!stats_module) return;
+    stats_code_size(machine);
+    FILE *fp = fopen(stats_file, "w");
+    if(!fp){
+        printf("Could not write statistics to %s\n", stats_file);
+        exit(0);
+    }
+
+    // The module totals come first, then every function that has code or counters
+    // Comptime functions are gone after evaluation, so they only have frontend counters
+    stats_list_t total;
+    memset(&total, 0, sizeof(stats_list_t));
+    total.has_before = true;
+    total.has_after = stats_optimized;
+    for(stats_list_t *stats = stats_first; stats; stats = stats->next){
+        total.casts += stats->casts;
+        total.folded_casts += stats->folded_casts;
+        total.dead_statements += stats->dead_statements;
+        stats_add_counts(&total.before, &stats->before);
+        stats_add_counts(&total.after, &stats->after);
+        total.code_size += stats->code_size;
+    }
+    fprintf(fp, "{\n  \"module\": {");
+    stats_write_record(fp, &total);
+    fprintf(fp, "},\n  \"functions\": [");
+    for(stats_list_t *stats = stats_first; stats; stats = stats->next){
+        fprintf(fp, "%s\n    {\"name\": ", stats == stats_first ? "" : ",");
+        stats_write_name(fp, stats->name);
+        fprintf(fp, ", ");
+        stats_write_record(fp, stats);
+        fprintf(fp, "}");
+    }
+    fprintf(fp, "\n  ]\n}\n");
+    fclose(fp);
+
+    while(stats_first){
+        stats_list_t *temp = stats_first;
+        stats_first = stats_first->next;
+        free(temp->name);
+        free(temp);
+    }
+    stats_last = NULL;
+    memset(stats_buckets, 0, sizeof(stats_buckets));
+    stats_module = NULL;
+}
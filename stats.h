@@ -0,0 +1,48 @@
+#ifndef STATS_H
+#define STATS_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <llvm-c/Core.h>
+#include <llvm-c/TargetMachine.h>
+
+// Number of each kind of instruction in the IR of a function
+typedef struct stats_counts {
+    uint32_t blocks;
+    uint32_t instructions;
+    uint32_t allocas;
+    uint32_t loads;
+    uint32_t stores;
+    uint32_t calls;
+    uint32_t casts;
+} stats_counts_t;
+
+// Store the statistics of each function, in the order functions were first seen
+// Code outside of functions, like global initializers, is counted under an empty name
+typedef struct stats_list {
+    struct stats_list *next;
+    struct stats_list *bucket_next;     // Functions are also looked up by name in a hash table
+    char* name;
+    uint32_t casts;             // Instructions built by cast()
+    uint32_t folded_casts;      // Casts of constants, which fold into another constant
+    uint32_t dead_statements;   // Statements after the block ended, which generate nothing
+    bool has_before;
+    bool has_after;             // Only set if -O ran, and the function wasn't removed
+    stats_counts_t before;
+    stats_counts_t after;
+    uint64_t code_size;
+} stats_list_t;
+
+// Start/finish collecting statistics of a module, which are written to a JSON file
+// Stats functions do nothing unless stats_initialize() was called
+void stats_initialize(LLVMModuleRef module, LLVMBuilderRef builder, char* output_file);
+void stats_finalize(LLVMTargetMachineRef machine);
+
+// Count what the frontend generates in the function the builder is positioned in
+void stats_cast(LLVMValueRef value);
+void stats_statement();
+
+// Count the instructions of every function, before or after optimization
+void stats_count(bool optimized);
+
+#endif
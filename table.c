@@ -14,7 +14,6 @@ void destroy_table(table_t *current){
     while(current->entrylist){
         entry_t* temp = current->entrylist;
         current->entrylist = current->entrylist->nextentry;
-        free(temp->name);
         free(temp);
     }
     free(current);
@@ -86,12 +85,69 @@ value_t get_value(table_t* table, char* name)
     return def;
 }
 
+uint32_t hash_name(char* name)
+{
+    return hash_name_length(name, strlen(name));
+}
+
+uint32_t hash_name_length(const char* name, size_t length)
+{
+    //FNV-1a hash
+    uint32_t hash = 2166136261u;
+    for(size_t i = 0; i < length; i++)
+    {
+        hash ^= (unsigned char)name[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+void initialize_index_map(index_map_t* map, uint32_t length)
+{
+    //keep the load factor at or below 1/2 so probes stay short
+    map->capacity = 1;
+    while(map->capacity < length * 2)
+        map->capacity *= 2;
+    map->keys = calloc(map->capacity, sizeof(char*));
+    map->indices = calloc(map->capacity, sizeof(uint32_t));
+}
+
+void insert_index_map(index_map_t* map, char* name, uint32_t index)
+{
+    //linear probing until an empty slot or the same name is found
+    uint32_t slot = hash_name(name) & (map->capacity - 1);
+    while(map->keys[slot] && strcmp(map->keys[slot], name) != 0)
+        slot = (slot + 1) & (map->capacity - 1);
+    if(map->keys[slot])
+    {
+        printf("identifier already defined!\n");
+        exit(0);
+    }
+    map->keys[slot] = name;
+    map->indices[slot] = index;
+}
+
+bool get_index_map(index_map_t* map, char* name, uint32_t* index)
+{
+    uint32_t slot = hash_name(name) & (map->capacity - 1);
+    while(map->keys[slot])
+    {
+        if(strcmp(map->keys[slot], name) == 0)
+        {
+            *index = map->indices[slot];
+            return true;
+        }
+        slot = (slot + 1) & (map->capacity - 1);
+    }
+    return false;
+}
+
 //make function that takes a char* and length, and replaces \n with a newline, \t with a tab, \\ with \, \' with ', and \" with "
 //all followups to \ that arent one of those 5 is invalid, so throw error
 char* translate_special_chars(char* str, int length)
 {
     //create new string that will store the fixed version
-    char* newstr = (char*)malloc(length);
+    char* newstr = (char*)malloc(length + 1);
 
     //to offset misalignment between newstr and str
     int counter=0;
@@ -159,8 +215,9 @@ char* translate_special_chars(char* str, int length)
             newstr[i-counter] = str[i];
         }
     }
-    //resize the string
-    char* retstr =  realloc(newstr, length-counter);
+    //terminate and resize the string
+    newstr[length-counter] = 0;
+    char* retstr =  realloc(newstr, length-counter+1);
 
     //DEBUG: printf("%s", retstr);
 
@@ -3,6 +3,7 @@
 
 #include <llvm-c/Core.h>
 #include <stdbool.h>
+#include <stddef.h>
 
 // A "value" has both the actual value and the optional address of the value
 typedef struct value{
@@ -23,6 +24,13 @@ typedef struct table{
     entry_t* entrylist;
 } table_t;
 
+// An open-addressing hash map from names to indices
+typedef struct index_map{
+    char** keys;
+    uint32_t *indices;
+    uint32_t capacity;
+} index_map_t;
+
 // Initialization/Destructor functions for tables
 table_t *create_table(table_t *prev);
 void destroy_table(table_t *current);
@@ -37,6 +45,18 @@ bool contains_name(table_t* table, char* name);
 // This operation is recursively called on the previous symbol table
 value_t get_value(table_t* table, char* name);
 
+// Hash function for names
+uint32_t hash_name(char* name);
+
+// Hash the first length characters of a name, which doesn't have to end there
+uint32_t hash_name_length(const char* name, size_t length);
+
+// Initialization/Insertion/Lookup functions for index maps
+// The map is sized once for the given number of names
+void initialize_index_map(index_map_t* map, uint32_t length);
+void insert_index_map(index_map_t* map, char* name, uint32_t index);
+bool get_index_map(index_map_t* map, char* name, uint32_t* index);
+
 // String function to correct escape sequences
 char* translate_special_chars(char* str, int length);
 
@@ -0,0 +1,94 @@
+// C side of abi.txt, built with gcc so that both sides follow the x86-64 System V ABI
+#include <stdio.h>
+#include <stdarg.h>
+#include <stdint.h>
+
+// Two INTEGER eightbytes, two SSE eightbytes, and mixed classes
+typedef struct { int32_t a, b; } ii;
+typedef struct { int64_t a, b; } ll;
+typedef struct { double a, b; } dd;
+typedef struct { float a, b, c; } fff;
+typedef struct { int64_t a; double b; } ld;
+typedef struct { float a; int32_t b; } fi;
+typedef struct { int8_t a, b, c; } bbb;
+
+// The second eightbyte is only padding, so it takes no register
+typedef struct __attribute__((aligned(16))) { int64_t a; } al;
+
+// In memory: too large, or with a misaligned field
+typedef struct { int64_t a, b, c, d; } big;
+typedef struct __attribute__((packed)) { int8_t a; int64_t b; } pk;
+
+ii c_ii(ii x){ x.a += 1; x.b *= 2; return x; }
+ll c_ll(ll x){ x.a += 1; x.b *= 2; return x; }
+dd c_dd(dd x){ x.a += 0.5; x.b *= 2; return x; }
+fff c_fff(fff x){ x.a += 1; x.b *= 2; x.c -= 1; return x; }
+ld c_ld(ld x){ x.a += 1; x.b *= 2; return x; }
+fi c_fi(fi x){ x.a += 1; x.b *= 2; return x; }
+bbb c_bbb(bbb x){ x.a += 1; x.c *= 2; return x; }
+al c_al(al x){ x.a *= 2; return x; }
+big c_big(big x){ x.a += 1; x.d *= 2; return x; }
+pk c_pk(pk x){ x.a += 1; x.b *= 2; return x; }
+
+// The fifth ll no longer fits in the six integer registers, so it and the ones after it go on the stack
+int64_t c_many(ll a, ll b, ll c, ll d, ll e, double f, ll g, int64_t h){
+    return a.a + b.b + c.a + d.b + e.a + (int64_t)f + g.a * 1000 + g.b * 100 + h;
+}
+
+// Arguments after one that only has padding left in its second eightbyte
+int64_t c_after_al(al a, int64_t b, int64_t c, int64_t d, int64_t e, int64_t f){
+    return a.a * 100000 + b * 10000 + c * 1000 + d * 100 + e * 10 + f;
+}
+
+// The fifth dd no longer fits in the eight SSE registers
+double c_many_dd(dd a, dd b, dd c, dd d, dd e, double f){
+    return a.a + b.b + c.a + d.b + e.a * 10 + e.b * 100 + f * 1000;
+}
+
+double c_var(int n, ...){
+    va_list ap;
+    va_start(ap, n);
+    double sum = 0;
+    for(int i = 0; i < n; i++){
+        dd x = va_arg(ap, dd);
+        big y = va_arg(ap, big);
+        ld z = va_arg(ap, ld);
+        sum += x.a + x.b + y.a + y.d + z.a + z.b;
+    }
+    va_end(ap);
+    return sum;
+}
+
+// Functions of abi.txt, called from C
+ll l_ll(ll x);
+dd l_dd(dd x);
+ld l_ld(ld x);
+fff l_fff(fff x);
+big l_big(big x);
+al l_al(al x);
+int64_t l_after_al(al a, int64_t b, int64_t c, int64_t d, int64_t e, int64_t f);
+int64_t l_many(ll a, ll b, ll c, ll d, ll e, double f, ll g, int64_t h);
+
+void c_callbacks(void){
+    ll a = l_ll((ll){3, 4});
+    dd b = l_dd((dd){1.5, 2.5});
+    ld c = l_ld((ld){7, 0.5});
+    fff d = l_fff((fff){1, 2, 3});
+    big e = l_big((big){1, 2, 3, 4});
+    printf("cb %ld %ld | %g %g | %ld %g | %g %g %g | %ld %ld %ld %ld\n",
+        a.a, a.b, b.a, b.b, c.a, c.b, d.a, d.b, d.c, e.a, e.b, e.c, e.d);
+    al f = l_al((al){21});
+    printf("cb al %ld %ld\n", f.a, l_after_al((al){1}, 2, 3, 4, 5, 6));
+    printf("cb many %ld\n", l_many((ll){1, 2}, (ll){3, 4}, (ll){5, 6}, (ll){7, 8}, (ll){9, 10}, 11.0, (ll){12, 13}, 14));
+}
+
+// Call function pointers that abi.txt passes, and give it pointers to C functions
+int64_t c_apply(big (*f)(big), ld (*g)(ld)){
+    big x = f((big){1, 2, 3, 4});
+    ld y = g((ld){5, 1.5});
+    return x.a + x.b + x.c + x.d + y.a * 100 + (int64_t)(y.b * 1000);
+}
+
+dd (*c_pointer(void))(dd){
+    return c_dd;
+}
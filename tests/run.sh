@@ -0,0 +1,38 @@
+#!/bin/sh
+# Compile and run each program of tests, and check its output against tests/<name>.expected
+# tests/<name>.c is built with gcc and linked in, so that C calls the program and the program calls C
+# Usage: tests/run.sh [compiler] [tests...]
+# OUT_FLAGS are added to every build with the compiler, e.g. OUT_FLAGS=-O2
+COMPILER=${1:-./out}
+[ $# -gt 0 ] && shift
+DIR=$(dirname $0)
+TESTS=${*:-$(ls $DIR/*.txt | xargs -n 1 basename | sed 's/\.txt$//')}
+TMP=/tmp/tests_$$
+
+FAILED=0
+for name in $TESTS; do
+    # Errors don't set the exit status of the compiler, so a missing object means it failed
+    OBJECTS=$TMP.o
+    rm -f $TMP.o
+    if ! $COMPILER $DIR/$name.txt $OUT_FLAGS -o $TMP.o > $TMP.log 2>&1 || [ ! -f $TMP.o ]; then
+        echo "FAIL $name (doesn't compile)"
+        cat $TMP.log
+        FAILED=$((FAILED + 1))
+        continue
+    fi
+    if [ -f $DIR/$name.c ]; then
+        gcc -O2 -c $DIR/$name.c -o $TMP.c.o
+        OBJECTS="$OBJECTS $TMP.c.o"
+    fi
+    gcc -no-pie $OBJECTS -o $TMP -lm
+    if $TMP | diff $DIR/$name.expected - > $TMP.diff; then
+        echo "ok   $name"
+    else
+        echo "FAIL $name"
+        cat $TMP.diff
+        FAILED=$((FAILED + 1))
+    fi
+    rm -f $TMP $TMP.o $TMP.c.o
+done
+rm -f $TMP.log $TMP.diff
+[ $FAILED -eq 0 ]
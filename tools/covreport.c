@@ -0,0 +1,115 @@
+// Report tool for files written by the -fcoverage runtime
+// Prints the hottest branches and loops, then each source file annotated with counts
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#define TOP_COUNTERS 20
+
+static const char* kind_names[] = {"if", "else", "loop condition", "loop body"};
+
+// One counter from the coverage file
+typedef struct counter {
+    const char* file;
+    uint32_t line;
+    uint32_t column;
+    uint32_t kind;
+    uint64_t count;
+} counter_t;
+
+static void read_exact(void* data, size_t size, FILE* in){
+    if(fread(data, 1, size, in) != size){
+        printf("Truncated coverage file\n");
+        exit(1);
+    }
+}
+
+// Sort by count, highest first
+static int compare_counters(const void* a, const void* b){
+    const counter_t* left = a;
+    const counter_t* right = b;
+    if(left->count == right->count) return 0;
+    return left->count < right->count ? 1 : -1;
+}
+
+// Print a source file with the highest count of each line in the margin
+static void annotate(const char* file, counter_t* counters, uint32_t length){
+    FILE* source = fopen(file, "r");
+    if(!source){
+        printf("Couldn't open %s\n", file);
+        return;
+    }
+    printf("\n==> %s <==\n", file);
+    char line[4096];
+    uint32_t number = 0;
+    while(fgets(line, sizeof(line), source)){
+        number++;
+        int found = 0;
+        uint64_t count = 0;
+        for(uint32_t i = 0; i<length; i++){
+            if(counters[i].file != file || counters[i].line != number) continue;
+            if(!found || counters[i].count > count) count = counters[i].count;
+            found = 1;
+        }
+        if(found) printf("%12lu | %s", count, line);
+        else printf("%12s | %s", "", line);
+    }
+    fclose(source);
+}
+
+int main(int argc, char** argv){
+    FILE* in = fopen(argc > 1 ? argv[1] : "coverage.out", "rb");
+    if(!in){
+        printf("Usage: covreport [coverage.out]\n");
+        return 1;
+    }
+    char magic[8];
+    read_exact(magic, 8, in);
+    if(memcmp(magic, "OUTCOV1", 8) != 0){
+        printf("Not a coverage file\n");
+        return 1;
+    }
+
+    // Read every counter of every module
+    uint32_t module_count, length = 0, capacity = 64;
+    counter_t* counters = malloc(sizeof(counter_t) * capacity);
+    char** files;
+    read_exact(&module_count, sizeof(uint32_t), in);
+    files = malloc(sizeof(char*) * (module_count ? module_count : 1));
+    for(uint32_t m = 0; m<module_count; m++){
+        uint32_t path_length, count;
+        read_exact(&path_length, sizeof(uint32_t), in);
+        files[m] = malloc(path_length + 1);
+        read_exact(files[m], path_length, in);
+        files[m][path_length] = 0;
+        read_exact(&count, sizeof(uint32_t), in);
+        for(uint32_t i = 0; i<count; i++){
+            if(length == capacity){
+                capacity *= 2;
+                counters = realloc(counters, sizeof(counter_t) * capacity);
+            }
+            uint32_t record[3];
+            read_exact(record, sizeof(record), in);
+            counters[length].file = files[m];
+            counters[length].line = record[0];
+            counters[length].column = record[1];
+            counters[length].kind = record[2] < 4 ? record[2] : 0;
+            read_exact(&counters[length].count, sizeof(uint64_t), in);
+            length++;
+        }
+    }
+    fclose(in);
+
+    // Annotate in file order before sorting the counters
+    for(uint32_t m = 0; m<module_count; m++)
+        annotate(files[m], counters, length);
+
+    qsort(counters, length, sizeof(counter_t), compare_counters);
+    printf("\nHottest branches and loops:\n");
+    for(uint32_t i = 0; i<length && i<TOP_COUNTERS; i++){
+        printf("%12lu  %s:%u:%u  %s\n", counters[i].count, counters[i].file,
+            counters[i].line, counters[i].column, kind_names[counters[i].kind]);
+    }
+    return 0;
+}
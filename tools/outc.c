@@ -0,0 +1,14 @@
+// Thin client for a compile server started with out --server <socket>
+// Takes the same arguments as out, but sends them to OUT_SERVER without loading LLVM
+#include <stdio.h>
+#include <stdlib.h>
+#include "../server.h"
+
+int main(int argc, char** argv){
+    char* server = getenv("OUT_SERVER");
+    if(!server){
+        printf("Set OUT_SERVER to the socket of a compile server\n");
+        return 1;
+    }
+    return send_request(server, argc, argv);
+}